@@ -24,6 +24,7 @@
 
 #pragma once
 #include <stdint.h>
+#include "camera.h"
 
 typedef struct display_config_t
 {
@@ -163,12 +164,6 @@ const display_config_t display_config[] = {
     {0x00, 0x93},
 };
 
-typedef struct camera_config_t
-{
-    uint16_t address;
-    uint8_t value;
-} camera_config_t;
-
 // Useful resources for the camera configuration. The table below is based on
 // the Linux driver, along with some tweaks to enable MIPI and set resolution
 // https://github.com/adafruit/Adafruit_CircuitPython_OV5640/blob/main/adafruit_ov5640.py
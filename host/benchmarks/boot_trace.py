@@ -0,0 +1,58 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Prints the boot timing trace, and then times the first import of camera.
+# The camera used to be brought up before the REPL, and is now brought up in
+# the background once the REPL is idle. Fails if it was brought up before the
+# REPL, or if the import still had to wait for it:
+#
+#   build-host/monocle host/benchmarks/boot_trace.py
+
+import _host
+import device
+
+trace = device.boot_trace()
+last = 0
+
+for stage, us in trace:
+    print("{:>12}: {:>8} us (+{} us)".format(stage, us, us - last))
+    last = us
+
+stages = [stage for stage, _ in trace]
+
+if "repl" not in stages:
+    raise AssertionError("the REPL stage is missing from the trace")
+
+if "camera" in stages and stages.index("camera") < stages.index("repl"):
+    raise AssertionError("the camera was brought up before the REPL")
+
+start = _host.ticks_us()
+import camera
+
+elapsed = _host.ticks_us() - start
+
+print("import camera: {} us".format(elapsed))
+
+if elapsed > 20000:
+    raise AssertionError("importing camera waited for it to be brought up")
@@ -0,0 +1,90 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Captures and reads out a frame the way camera.py used to, polling and
+# reading 254 byte chunks through the fpga module, and then with the native
+# capture into a preallocated buffer. Reports virtual time and GC heap
+# allocated for each. Fails if the read out isn't at least 10x faster:
+#
+#   build-host/monocle host/benchmarks/camera_capture.py
+
+import _camera
+import _host
+import camera
+import fpga
+import gc
+import struct
+import time
+
+FRAME = bytearray(65536)
+
+
+def python_capture():
+    _camera.wake()
+    fpga.write(0x1003, b"")
+    while fpga.read(0x1000, 1) == b"2":
+        time.sleep_us(10)
+
+
+def python_read():
+    size = 0
+    while True:
+        avail = struct.unpack(">H", fpga.read(0x1006, 2))[0]
+        if avail == 0:
+            return size
+        size += len(fpga.read(0x1007, min(254, avail)))
+
+
+def native_read():
+    return camera.read_into(FRAME)
+
+
+def measure(name, capture, read):
+    gc.collect()
+    gc.disable()
+    allocated = gc.mem_alloc()
+    start = _host.ticks_us()
+    capture()
+    captured = _host.ticks_us()
+    size = read()
+    done = _host.ticks_us()
+    allocated = gc.mem_alloc() - allocated
+    gc.enable()
+
+    print(
+        "{}: {} bytes, capture {} us, read {} us, {} bytes allocated".format(
+            name, size, captured - start, done - captured, allocated
+        )
+    )
+    return done - captured
+
+
+python = measure("python", python_capture, python_read)
+native = measure("native", camera.capture, native_read)
+camera.read_into(FRAME)
+
+print("gain:", python / native)
+
+if native * 10 > python:
+    raise AssertionError("native read out gained less than 10x")
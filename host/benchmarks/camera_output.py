@@ -0,0 +1,74 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Captures and reads out a full size frame, then a quarter size one after
+# camera.output(), and counts the sensor register writes each output() call
+# makes. Fails if the smaller frame isn't read at least 3x faster, or if
+# asking for the current settings again touches the I2C bus:
+#
+#   build-host/monocle host/benchmarks/camera_output.py
+
+import _host
+import camera
+
+FRAME = bytearray(65536)
+
+
+def configure(x, y, factor=1):
+    _host.reset_counters()
+    camera.output(x, y, camera.JPEG)
+    camera.zoom(factor)
+    return _host.counters()["i2c_transfers"]
+
+
+def measure(name, x, y, factor=1):
+    writes = configure(x, y, factor)
+    camera.capture()
+    start = _host.ticks_us()
+    size = camera.read_into(FRAME)
+    elapsed = _host.ticks_us() - start
+    camera.read_into(FRAME)
+
+    print(
+        "{}: {}x{} zoom {}, {} register writes, {} bytes, read {} us".format(
+            name, x, y, factor, writes, size, elapsed
+        )
+    )
+    return elapsed
+
+
+full = measure("full", 640, 400)
+quarter = measure("quarter", 320, 200)
+zoomed = measure("zoomed", 320, 200, 2)
+repeated = configure(320, 200, 2)
+measure("restored", 640, 400)
+
+print("gain:", full / quarter)
+print("register writes when unchanged:", repeated)
+
+if quarter * 3 > full:
+    raise AssertionError("quarter size frame read gained less than 3x")
+
+if repeated != 0:
+    raise AssertionError("unchanged settings were written again")
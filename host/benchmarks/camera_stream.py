@@ -0,0 +1,83 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Sends a captured frame over the data service with a Python loop of
+# camera.read() and bluetooth.send(), and then with camera.stream(). Reports
+# virtual time until every notification went out, and how many times a
+# Python loop got to run meanwhile. Fails if streaming is any slower:
+#
+#   build-host/monocle host/benchmarks/camera_stream.py
+
+import _host
+import bluetooth
+import camera
+import time
+
+bluetooth.link_mode(bluetooth.FAST)
+time.sleep(0.5)
+
+
+def python_send():
+    camera.capture()
+    sent = 0
+    while True:
+        chunk = camera.read(bluetooth.max_length())
+        if chunk is None:
+            return sent
+        while True:
+            try:
+                bluetooth.send(chunk)
+                break
+            except OSError:
+                time.sleep_ms(1)
+        sent += len(chunk)
+
+
+def wait_sent(bytes):
+    while _host.counters()["ble_notification_bytes"] < bytes:
+        time.sleep_ms(1)
+
+
+_host.reset_counters()
+start = _host.ticks_us()
+wait_sent(python_send())
+python = _host.ticks_us() - start
+
+_host.reset_counters()
+start = _host.ticks_us()
+camera.stream()
+spins = 0
+while camera.streaming():
+    spins += 1
+    time.sleep_ms(1)
+wait_sent(_host.counters()["ble_notification_bytes"])
+native = _host.ticks_us() - start
+
+bluetooth.link_mode(bluetooth.AUTO)
+
+print("python loop:", python, "us")
+print("stream:", native, "us, python loop ran", spins, "times meanwhile")
+
+if native > python:
+    raise AssertionError("streaming was slower than the python loop")
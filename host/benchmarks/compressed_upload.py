@@ -0,0 +1,124 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+
+# Replays raw REPL file uploads through the simulator, once as plain source and
+# once as compressed uploads, and reports how long each takes on the simulated
+# link and on the host. Unlike the other benchmarks, this one runs on the host
+# itself, driving build-host/monocle:
+#
+#   python3 host/benchmarks/compressed_upload.py
+#
+# The uploads write each of the frozen Python modules in 4K pieces, the way
+# tools/upload_file.py does. Fails if the files read back differ from the
+# originals.
+
+import glob
+import hashlib
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+MONOCLE = "build-host/monocle"
+CHUNK = 4096
+
+
+def capture_uploads(path):
+    name = os.path.basename(path)
+    with open(path, "rb") as f:
+        data = f.read()
+
+    scripts = []
+    for i in range(0, len(data), CHUNK):
+        scripts.append(
+            f"f = open('{name}', '{'wb' if i == 0 else 'ab'}')\n"
+            f"f.write({data[i:i + CHUNK]!r})\n"
+            "f.close()\n"
+        )
+
+    return name, data, scripts
+
+
+def replay(scripts, options):
+    start = time.monotonic()
+    result = subprocess.run(
+        [MONOCLE, "--stats", *options, *scripts],
+        capture_output=True,
+        text=True,
+    )
+    wall = time.monotonic() - start
+
+    if result.returncode != 0:
+        sys.exit(f"{MONOCLE} failed:\n{result.stderr}")
+
+    virtual = int(re.search(r"virtual_time_us: (\d+)", result.stderr)[1])
+    return virtual, wall, result.stdout
+
+
+def main():
+    files = sorted(glob.glob("modules/*.py"))
+    uploads = [capture_uploads(path) for path in files]
+
+    with tempfile.TemporaryDirectory() as directory:
+        scripts = []
+        for name, _, captured in uploads:
+            for script in captured:
+                scripts.append(os.path.join(directory, f"{len(scripts)}.py"))
+                with open(scripts[-1], "w") as f:
+                    f.write(script)
+
+        check = os.path.join(directory, "check.py")
+        with open(check, "w") as f:
+            f.write("import hashlib, binascii\n")
+            for name, _, _ in uploads:
+                f.write(
+                    f"print('{name}', binascii.hexlify("
+                    f"hashlib.sha256(open('{name}', 'rb').read()).digest())"
+                    ".decode())\n"
+                )
+
+        boot, _, _ = replay([], ["-c", "pass"])
+        total = sum(len(script) for _, _, c in uploads for script in c)
+        print(f"{len(scripts)} uploads, {total} bytes of raw REPL input")
+
+        results = {}
+        for mode, options in (("plain", []), ("compressed", ["--compress"])):
+            virtual, wall, output = replay(scripts + [check], options)
+
+            for name, data, _ in uploads:
+                digest = hashlib.sha256(data).hexdigest()
+                if f"{name} {digest}" not in output:
+                    sys.exit(f"{mode}: {name} differs after the upload")
+
+            results[mode] = virtual - boot
+            print(f"{mode:>10}: {(virtual - boot) / 1e6:.2f} s on the link, "
+                  f"{wall:.2f} s wall time")
+
+        print(f"speedup: {results['plain'] / results['compressed']:.1f}x")
+
+
+if __name__ == "__main__":
+    main()
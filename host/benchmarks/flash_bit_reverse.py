@@ -0,0 +1,96 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Measures the bit reversal that flash traffic goes through, as flash is LSB
+# first on the SPI bus. Compares the driver's table kernel against the original
+# byte at a time version in host CPU time, then reports end to end flash read
+# and write throughput in virtual time. The last blocks of the storage area are
+# used as scratch space, and restored afterwards:
+#
+#   build-host/monocle host/benchmarks/flash_bit_reverse.py
+
+import _host
+import device
+
+SIZE = 64 * 1024
+ROUNDS = 16
+
+
+def kernel(reference):
+    buffer = bytearray(range(256)) * (SIZE // 256)
+
+    start = _host.cpu_us()
+
+    for i in range(ROUNDS):
+        _host.bit_reverse(buffer, reference)
+
+    elapsed = max(_host.cpu_us() - start, 1)
+
+    if buffer != bytearray(range(256)) * (SIZE // 256):
+        raise AssertionError("bit reversal isn't its own inverse")
+
+    return SIZE * ROUNDS / elapsed
+
+
+def flash():
+    storage = device.Storage()
+    blocks = 16
+    first = storage.ioctl(4, 0) - blocks
+
+    saved = bytearray(blocks * 4096)
+    storage.readblocks(first, saved)
+
+    data = bytes(range(256)) * 16
+    start = _host.ticks_us()
+    for i in range(blocks):
+        storage.ioctl(6, first + i)
+        storage.writeblocks(first + i, data)
+    write = blocks * 4096 / (_host.ticks_us() - start)
+
+    check = bytearray(blocks * 4096)
+    start = _host.ticks_us()
+    storage.readblocks(first, check)
+    read = blocks * 4096 / (_host.ticks_us() - start)
+
+    if check != data * blocks:
+        raise AssertionError("flash read back doesn't match")
+
+    for i in range(blocks):
+        storage.ioctl(6, first + i)
+        storage.writeblocks(first + i, saved[i * 4096 : (i + 1) * 4096])
+
+    return read, write
+
+
+original = kernel(True)
+table = kernel(False)
+
+print("bit reversal, original: {:.1f} MB/s".format(original))
+print("bit reversal, table:    {:.1f} MB/s".format(table))
+print("gain:", table / original)
+
+read, write = flash()
+
+print("flash read:  {:.3f} MB/s".format(read))
+print("flash write: {:.3f} MB/s".format(write))
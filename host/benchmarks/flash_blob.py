@@ -0,0 +1,89 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Streams a 32K asset out of a flash blob and out of a file in the same
+# chunks, and reports the GC heap allocated and virtual time taken by each.
+# Blob reads go straight from flash into the caller's buffer, so they should
+# allocate nothing. The blob region is erased before and after:
+#
+#   build-host/monocle host/benchmarks/flash_blob.py
+
+import _host
+import device
+import gc
+import os
+
+SIZE = 32768
+CHUNK = 512
+
+
+def measure(name, read):
+    chunk = bytearray(CHUNK)
+    gc.collect()
+    gc.disable()
+    allocated = gc.mem_alloc()
+    start = _host.ticks_us()
+
+    for offset in range(0, SIZE, CHUNK):
+        read(offset, chunk)
+
+    elapsed = _host.ticks_us() - start
+    allocated = gc.mem_alloc() - allocated
+    gc.enable()
+
+    print("{}: {} us, {} bytes allocated".format(name, elapsed, allocated))
+    return allocated
+
+
+data = bytes(range(256)) * (SIZE // 256)
+
+device.Blob.erase()
+blob = device.Blob.create("asset", SIZE)
+blob.write(0, data)
+
+with open("asset.bin", "wb") as f:
+    f.write(data)
+
+if device.Blob("asset")[:] != data:
+    raise AssertionError("blob read back doesn't match")
+
+blob = device.Blob("asset")
+from_blob = measure("blob", blob.read_into)
+
+f = open("asset.bin", "rb")
+
+
+def read_file(offset, chunk):
+    f.seek(offset)
+    f.readinto(chunk)
+
+
+from_file = measure("file", read_file)
+f.close()
+
+os.remove("asset.bin")
+device.Blob.erase()
+
+if from_blob != 0:
+    raise AssertionError("blob reads allocated on the heap")
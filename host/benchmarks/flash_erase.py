@@ -0,0 +1,69 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Times erasing a full FPGA image slot, which the driver now does with 64K and
+# 32K block erases, against 4K sector erases one at a time. This wipes the FPGA
+# image, so don't point --flash at an image worth keeping. Fails if block erases
+# don't at least halve the time:
+#
+#   build-host/monocle host/benchmarks/flash_erase.py
+
+import _host
+import device
+import update
+
+SLOT_SECTORS = 0x6D
+
+
+def sector_erase_us():
+    storage = device.Storage()
+    block = storage.ioctl(4, 0) - 1
+
+    start = _host.ticks_us()
+    storage.ioctl(6, block)
+    storage.ioctl(3, 0)
+    return _host.ticks_us() - start
+
+
+def slot_erase_us():
+    _host.reset_counters()
+    start = _host.ticks_us()
+
+    # Reading waits for the queued erases to complete
+    update.Fpga.erase()
+    update.Fpga.read(0, 1)
+
+    return _host.ticks_us() - start, _host.counters()["flash_erases"]
+
+
+sector = sector_erase_us()
+slot, erases = slot_erase_us()
+sectors = SLOT_SECTORS * sector
+
+print("4K sector erases:", SLOT_SECTORS, "taking", sectors // 1000, "ms")
+print("block erases:", erases, "taking", slot // 1000, "ms")
+print("gain:", sectors / slot)
+
+if slot * 2 > sectors:
+    raise AssertionError("block erases gained less than 2x")
@@ -0,0 +1,81 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Writes 64K through the storage block device and reports flash write
+# throughput in virtual time, host CPU time, page programs and the GC heap
+# allocated by the writes. Run it on builds before and after a driver change
+# to compare them. The last blocks of the storage area are used as scratch
+# space, and restored afterwards:
+#
+#   build-host/monocle host/benchmarks/flash_write.py
+
+import _host
+import device
+import gc
+
+BLOCKS = 16
+
+
+def measure(data):
+    storage = device.Storage()
+    first = storage.ioctl(4, 0) - BLOCKS
+
+    saved = bytearray(BLOCKS * 4096)
+    storage.readblocks(first, saved)
+
+    gc.collect()
+    gc.disable()
+    _host.reset_counters()
+    allocated = gc.mem_alloc()
+    cpu = _host.cpu_us()
+    start = _host.ticks_us()
+
+    for i in range(BLOCKS):
+        storage.ioctl(6, first + i)
+        storage.writeblocks(first + i, data)
+
+    elapsed = _host.ticks_us() - start
+    cpu = _host.cpu_us() - cpu
+    allocated = gc.mem_alloc() - allocated
+    gc.enable()
+
+    programs = _host.counters()["spi_transfers"]
+
+    check = bytearray(4096)
+    for i in range(BLOCKS):
+        storage.readblocks(first + i, check)
+        if check != data:
+            raise AssertionError("flash read back doesn't match")
+
+    for i in range(BLOCKS):
+        storage.ioctl(6, first + i)
+        storage.writeblocks(first + i, saved[i * 4096 : (i + 1) * 4096])
+
+    print("flash write: {:.3f} MB/s".format(BLOCKS * 4096 / elapsed))
+    print("host cpu:", cpu, "us")
+    print("spi transfers:", programs)
+    print("heap allocated:", allocated, "bytes")
+
+
+measure(bytes(range(256)) * 16)
@@ -0,0 +1,45 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Reports the I2C traffic of booting up to the first script: transfers, bytes,
+# bus clock cycles and the time spent on the bus. Writing the camera table one
+# register per transfer at 100kHz used to take over 100ms, or 10000 bus clock
+# cycles, on its own. Fails if the whole of boot now takes more than a third of
+# that many cycles, whichever clock the buses run at:
+#
+#   build-host/monocle host/benchmarks/i2c_boot.py
+
+import _host
+
+counters = _host.counters()
+boot = _host.ticks_us()
+
+print("boot: {} us".format(boot))
+print("i2c transfers:", counters["i2c_transfers"])
+print("i2c bytes:", counters["i2c_bytes"])
+print("i2c clock cycles:", counters["i2c_clock_cycles"])
+print("i2c bus time: {} us".format(counters["i2c_bus_us"]))
+
+if counters["i2c_clock_cycles"] * 3 > 10000:
+    raise AssertionError("boot spent more than 3333 clock cycles on the I2C buses")
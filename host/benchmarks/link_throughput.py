@@ -0,0 +1,70 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+
+# Compares data service throughput with the link relaxed and tuned for bulk
+# transfers. With --passive the central leaves PHY and data length updates to
+# the firmware, as many phones do. Fails if tuning doesn't at least double the
+# throughput, which is how CI runs it:
+#
+#   build-host/monocle --passive host/benchmarks/link_throughput.py
+
+import _host
+import bluetooth
+import time
+
+SIZE = 32 * 1024
+
+
+def measure(mode):
+    bluetooth.link_mode(mode)
+
+    # Give the link procedures time to complete
+    time.sleep(0.5)
+
+    chunk = b"\x55" * bluetooth.max_length()
+
+    _host.reset_counters()
+    start = _host.ticks_us()
+
+    for i in range(SIZE // len(chunk)):
+        bluetooth.send(chunk)
+
+    sent = (SIZE // len(chunk)) * len(chunk)
+
+    while _host.counters()["ble_notification_bytes"] < sent:
+        time.sleep_ms(1)
+
+    throughput = sent * 1000000 // (_host.ticks_us() - start)
+    print(mode, throughput, "bytes/s", _host.link())
+    return throughput
+
+
+relaxed = measure(bluetooth.RELAXED)
+fast = measure(bluetooth.FAST)
+bluetooth.link_mode(bluetooth.AUTO)
+
+print("gain:", fast / relaxed)
+
+if fast < 2 * relaxed:
+    raise AssertionError("link tuning gained less than 2x")
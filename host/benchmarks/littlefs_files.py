@@ -0,0 +1,111 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Creates, appends to and reads back 1000 small files on the 460K storage
+# partition, from 0x6D000 up to the log store at 0xE0000, once with the
+# littlefs defaults and once with the geometry that device.Storage advertises. Reports virtual time, flash traffic and read cache
+# hits for each. This reformats the filesystem, so don't point --flash at an
+# image worth keeping:
+#
+#   build-host/monocle host/benchmarks/littlefs_files.py
+
+import _host
+import device
+import os
+
+FILES = 1000
+DIRECTORIES = 10
+
+# The default partition, which ends where the log and blob regions begin
+PARTITION_START = 0x6D000
+PARTITION_LENGTH = 0xE0000 - PARTITION_START
+
+
+def run(name, **geometry):
+    # littlefs programs 32 bytes at a time by default
+    bdev = device.Storage(prog_size=geometry.get("progsize", 32))
+
+    if bdev.ioctl(4, 0) * 4096 != PARTITION_LENGTH:
+        raise AssertionError("the default partition isn't 460K")
+
+    os.umount("/")
+    os.VfsLfs2.mkfs(bdev, **geometry)
+    os.mount(os.VfsLfs2(bdev, **geometry), "/")
+
+    bdev.ioctl(0x102, 0)
+    _host.reset_counters()
+    start = _host.ticks_us()
+
+    for d in range(DIRECTORIES):
+        os.mkdir("/d{}".format(d))
+
+    for i in range(FILES):
+        with open("/d{}/f{}".format(i % DIRECTORIES, i), "w") as f:
+            f.write("file {}\n".format(i))
+
+    created = _host.ticks_us()
+
+    for i in range(FILES):
+        with open("/d{}/f{}".format(i % DIRECTORIES, i), "a") as f:
+            f.write("appended\n")
+
+    appended = _host.ticks_us()
+
+    for i in range(FILES):
+        with open("/d{}/f{}".format(i % DIRECTORIES, i)) as f:
+            if f.read() != "file {}\nappended\n".format(i):
+                raise AssertionError("file contents don't match")
+
+    read = _host.ticks_us()
+    counters = _host.counters()
+
+    print(name)
+    print("  create: ", (created - start) // 1000, "ms")
+    print("  append: ", (appended - created) // 1000, "ms")
+    print("  read:   ", (read - appended) // 1000, "ms")
+    print("  programmed:", counters["flash_program_bytes"], "bytes")
+    print("  read:      ", counters["flash_read_bytes"], "bytes")
+    print("  erases:    ", counters["flash_erases"])
+    print("  cache:     ", bdev.ioctl(0x100, 0), "hits", bdev.ioctl(0x101, 0), "misses")
+
+    # Listings only touch metadata, which the read cache is there for
+    bdev.ioctl(0x102, 0)
+
+    for d in range(DIRECTORIES):
+        os.listdir("/d{}".format(d))
+
+    print("  listing:   ", bdev.ioctl(0x100, 0), "hits", bdev.ioctl(0x101, 0), "misses")
+
+    return read - start
+
+
+defaults = run("defaults")
+tuned = run(
+    "tuned",
+    readsize=device.Storage.READ_SIZE,
+    progsize=device.Storage.PROG_SIZE,
+    lookahead=device.Storage.LOOKAHEAD_SIZE,
+)
+
+print("gain:", defaults / tuned)
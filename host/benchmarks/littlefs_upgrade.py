@@ -0,0 +1,91 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+#
+# Formats the storage the way firmware before the tuned littlefs geometry and
+# the log and blob regions did, then runs the mount done at boot. Checks that
+# the files survive, that the filesystem keeps its old size, and that appending
+# to it still works. Reports the time taken to mount and the flash traffic of
+# the appends. This reformats the filesystem, so don't point --flash at an
+# image worth keeping:
+#
+#   build-host/monocle host/benchmarks/littlefs_upgrade.py
+
+import _host
+import device
+import os
+
+FILES = 20
+APPENDS = 20
+
+# Old firmware gave the filesystem 588K, up to 0x100000. The default partition
+# now stops at the log store, 460K from the same start
+OLD_LENGTH = 0x93000
+NEW_LENGTH = 0xE0000 - 0x6D000
+
+if device.Storage().ioctl(4, 0) * 4096 != NEW_LENGTH:
+    raise AssertionError("the default partition isn't 460K")
+
+os.umount("/")
+
+# Formatted with the littlefs defaults, reading and programming 32 bytes at a
+# time, over what is now the log store and blob regions too
+old = device.Storage(length=OLD_LENGTH, prog_size=32)
+os.VfsLfs2.mkfs(old)
+os.mount(os.VfsLfs2(old), "/")
+
+for i in range(FILES):
+    with open("/f{}".format(i), "w") as f:
+        f.write("file {}\n".format(i))
+
+os.umount("/")
+
+# Imported rather than run frozen as at boot, which mounts it the same way
+start = _host.ticks_us()
+import _mountfs
+
+mounted = _host.ticks_us()
+
+if os.statvfs("/")[2] * 4096 != OLD_LENGTH:
+    raise AssertionError("filesystem wasn't kept at its old size")
+
+_host.reset_counters()
+
+for n in range(APPENDS):
+    for i in range(FILES):
+        with open("/f{}".format(i), "a") as f:
+            f.write("appended\n")
+
+appended = _host.ticks_us()
+counters = _host.counters()
+
+for i in range(FILES):
+    with open("/f{}".format(i)) as f:
+        if f.read() != "file {}\n".format(i) + "appended\n" * APPENDS:
+            raise AssertionError("file contents don't match")
+
+print("mount: ", (mounted - start) // 1000, "ms")
+print("append:", (appended - mounted) // 1000, "ms")
+print("  programmed:", counters["flash_program_bytes"], "bytes")
+print("  erases:    ", counters["flash_erases"])
@@ -0,0 +1,83 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+#
+# Logs 128 byte records at 20 KB/s for two seconds, once appended to a
+# littlefs file and flushed, and once through device.LogStore. Reports the
+# worst and mean latency of a single write in virtual time. Fails if the log
+# store's worst case isn't at least 10x better, and erases the log afterwards:
+#
+#   build-host/monocle host/benchmarks/log_store.py
+
+import _host
+import device
+import os
+import time
+
+RECORD = 128
+RATE = 20 * 1024
+SECONDS = 2
+
+
+def measure(name, write):
+    record = bytes(range(RECORD))
+    interval = RECORD * 1000000 // RATE
+    worst = 0
+    total = 0
+    count = RATE * SECONDS // RECORD
+
+    for i in range(count):
+        start = _host.ticks_us()
+        write(record)
+        elapsed = _host.ticks_us() - start
+
+        worst = max(worst, elapsed)
+        total += elapsed
+
+        if elapsed < interval:
+            time.sleep_us(interval - elapsed)
+
+    print("{}: worst {} us, mean {} us".format(name, worst, total // count))
+    return worst
+
+
+f = open("log.bin", "wb")
+
+
+def write_file(record):
+    f.write(record)
+    f.flush()
+
+
+from_file = measure("littlefs", write_file)
+f.close()
+os.remove("log.bin")
+
+log = device.LogStore()
+log.erase()
+from_log = measure("log store", log.append)
+log.flush()
+log.erase()
+
+if from_log * 10 > from_file:
+    raise AssertionError("log store worst case gained less than 10x")
@@ -0,0 +1,55 @@
+#
+# This file is part of the MicroPython for Monocle project:
+#      https://github.com/brilliantlabsAR/monocle-micropython
+#
+# Authored by: Josuah Demangeon (me@josuah.net)
+#              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+#
+# ISC Licence
+#
+# Copyright © 2023 Brilliant Labs Ltd.
+#
+# Permission to use, copy, modify, and/or distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+# REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+# AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+# INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+# LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+# OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+# PERFORMANCE OF THIS SOFTWARE.
+#
+
+# Measures how fast print() output reaches the central over the simulated
+# link. Run it on the host build, keeping only the summary:
+#
+#   build-host/monocle host/benchmarks/print_throughput.py | tail -n 4
+
+import _host
+import time
+
+LINE = "x" * 79
+COUNT = 1024
+
+total = COUNT * (len(LINE) + 1)
+
+_host.reset_counters()
+start = _host.ticks_us()
+
+for i in range(COUNT):
+    print(LINE)
+
+# Wait for whatever is still in the ring buffer to go out
+while _host.counters()["ble_notification_bytes"] < total:
+    time.sleep_ms(1)
+
+elapsed = _host.ticks_us() - start
+counters = _host.counters()
+
+print("print() throughput:", total * 1000000 // elapsed, "bytes/s")
+print("bytes per notification:", total // counters["ble_notifications"])
+print("notifications per event:",
+      counters["ble_notifications"] / counters["ble_connection_events"])
+print("link:", _host.link())
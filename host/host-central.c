@@ -0,0 +1,857 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief The central on the other end of the simulated BLE link. Scripts are
+ *        run through MicroPython's raw paste mode, the same way mpremote does
+ *        it, falling back to the plain raw REPL if the firmware lacks it.
+ *        Once the firmware grants credit for REPL input, scripts are streamed
+ *        through the plain raw REPL up to the credit instead. With --compress,
+ *        scripts are deflated and sent as compressed uploads, falling back to
+ *        raw paste mode. Without scripts, stdin and stdout are connected to
+ *        the REPL.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "host.h"
+
+#define WRITE_QUEUE_LENGTH 64
+#define MAX_WRITE_LENGTH 512
+#define PROMPT_BUFFER_SIZE 64
+
+// Time to wait for the firmware to go quiet once piped stdin has ended
+#define STDIN_IDLE_EXIT_US 1000000
+
+#define CTRL_A 0x01
+#define CTRL_C 0x03
+#define CTRL_D 0x04
+#define CTRL_E 0x05
+#define NAK 0x15
+#define FS 0x1C
+#define COMPRESSED_ESCAPE 0x10
+#define CTRL_RIGHT_BRACKET 0x1D
+
+typedef struct write_t
+{
+    host_ble_channel_t channel;
+    size_t length;
+    uint8_t data[MAX_WRITE_LENGTH];
+} write_t;
+
+static write_t writes[WRITE_QUEUE_LENGTH];
+
+static size_t write_head = 0;
+
+static size_t write_count = 0;
+
+typedef struct script_t
+{
+    char *code;
+    size_t length;
+} script_t;
+
+static script_t *scripts = NULL;
+
+static size_t script_count = 0;
+
+static enum script_state_t
+{
+    SCRIPT_IDLE,
+    SCRIPT_WAIT_RAW_PROMPT,
+    SCRIPT_WAIT_COMPRESSED_RESPONSE,
+    SCRIPT_COMPRESSED_SENDING,
+    SCRIPT_WAIT_INFLATED,
+    SCRIPT_WAIT_PASTE_RESPONSE,
+    SCRIPT_PASTE_SENDING,
+    SCRIPT_WAIT_PASTE_ACK,
+    SCRIPT_RAW_SENDING,
+    SCRIPT_WAIT_OK,
+    SCRIPT_STDOUT,
+    SCRIPT_STDERR,
+    SCRIPT_WAIT_PROMPT,
+} script_state = SCRIPT_IDLE;
+
+static struct script_run_t
+{
+    size_t index;
+    const uint8_t *data;
+    size_t length;
+    size_t sent;
+    uint8_t *compressed;
+    size_t window_size;
+    size_t window_left;
+    uint8_t response[4];
+    size_t response_length;
+    char prompt[PROMPT_BUFFER_SIZE];
+    size_t prompt_length;
+    bool stderr_output;
+    int status;
+} run;
+
+static bool interactive = false;
+
+static bool stdin_is_tty = false;
+
+static bool stdin_ended = false;
+
+static uint64_t last_activity_us = 0;
+
+static struct termios saved_termios;
+
+static int saved_stdin_flags;
+
+static uint8_t *data_in = NULL;
+
+static size_t data_in_length = 0;
+
+static size_t data_in_sent = 0;
+
+static FILE *data_out = NULL;
+
+static bool connected = false;
+
+static bool repl_credit_known = false;
+
+static uint32_t repl_credit = 0;
+
+static uint32_t repl_sent = 0;
+
+static size_t chunk_size(void)
+{
+    return host_softdevice_link().att_mtu - 3;
+}
+
+static bool queue_write(host_ble_channel_t channel,
+                        const uint8_t *data,
+                        size_t length)
+{
+    if (write_count == WRITE_QUEUE_LENGTH || length > MAX_WRITE_LENGTH)
+    {
+        return false;
+    }
+
+    write_t *write = &writes[(write_head + write_count) % WRITE_QUEUE_LENGTH];
+    write->channel = channel;
+    write->length = length;
+    memcpy(write->data, data, length);
+    write_count++;
+
+    if (channel == HOST_BLE_REPL)
+    {
+        repl_sent += length;
+    }
+
+    return true;
+}
+
+static size_t repl_credit_left(void)
+{
+    int32_t left = (int32_t)(repl_credit - repl_sent);
+
+    return left > 0 ? (size_t)left : 0;
+}
+
+static void queue_repl_string(const char *string)
+{
+    queue_write(HOST_BLE_REPL, (const uint8_t *)string, strlen(string));
+}
+
+static size_t queued_writes(host_ble_channel_t channel)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < write_count; i++)
+    {
+        if (writes[(write_head + i) % WRITE_QUEUE_LENGTH].channel == channel)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+bool host_central_peek_write(host_ble_channel_t *channel,
+                             const uint8_t **data,
+                             size_t *length)
+{
+    if (write_count == 0)
+    {
+        return false;
+    }
+
+    write_t *write = &writes[write_head];
+    *channel = write->channel;
+    *data = write->data;
+    *length = write->length;
+
+    return true;
+}
+
+void host_central_pop_write(void)
+{
+    if (write_count > 0)
+    {
+        write_head = (write_head + 1) % WRITE_QUEUE_LENGTH;
+        write_count--;
+    }
+}
+
+static char *load_script(const char *path, size_t *length)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "host: cannot read %s\n", path);
+        exit(2);
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *code = malloc(size + 1);
+    *length = fread(code, 1, size, file);
+    code[*length] = '\0';
+    fclose(file);
+
+    return code;
+}
+
+static void send_script_data(void);
+
+static void start_script(void)
+{
+    if (run.index == script_count)
+    {
+        host_exit(run.status);
+    }
+
+    run.data = (const uint8_t *)scripts[run.index].code;
+    run.length = scripts[run.index].length;
+    run.sent = 0;
+    run.response_length = 0;
+    run.stderr_output = false;
+
+    if (host_options.compress)
+    {
+        const char compressed_request[] = {CTRL_E, 'Z', CTRL_A, '\0'};
+        queue_repl_string(compressed_request);
+        script_state = SCRIPT_WAIT_COMPRESSED_RESPONSE;
+        return;
+    }
+
+    // Credit makes the round trips of raw paste mode unnecessary
+    if (repl_credit_known)
+    {
+        script_state = SCRIPT_RAW_SENDING;
+        send_script_data();
+        return;
+    }
+
+    // Ask for raw paste mode, which comes with flow control
+    const char raw_paste_request[] = {CTRL_E, 'A', CTRL_A, '\0'};
+    queue_repl_string(raw_paste_request);
+    script_state = SCRIPT_WAIT_PASTE_RESPONSE;
+}
+
+static void compress_script(void)
+{
+    script_t *script = &scripts[run.index];
+    uint8_t *deflated = malloc(host_deflate_bound(script->length));
+    size_t deflated_length = host_deflate((const uint8_t *)script->code,
+                                          script->length,
+                                          deflated);
+
+    // Lengths, then the stream with the bytes the REPL service intercepts
+    // escaped, which at worst doubles its size
+    free(run.compressed);
+    run.compressed = malloc(8 + 2 * deflated_length);
+    size_t length = 0;
+
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        run.compressed[length++] = (deflated_length >> shift) & 0xFF;
+    }
+
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        run.compressed[length++] = (script->length >> shift) & 0xFF;
+    }
+
+    for (size_t i = 0; i < deflated_length; i++)
+    {
+        uint8_t byte = deflated[i];
+
+        if (byte == CTRL_C || byte == FS || byte == COMPRESSED_ESCAPE)
+        {
+            run.compressed[length++] = COMPRESSED_ESCAPE;
+            byte ^= 0x40;
+        }
+
+        run.compressed[length++] = byte;
+    }
+
+    free(deflated);
+
+    run.data = run.compressed;
+    run.length = length;
+}
+
+static void send_script_data(void)
+{
+    bool windowed = script_state == SCRIPT_PASTE_SENDING ||
+                    script_state == SCRIPT_COMPRESSED_SENDING;
+
+    while (run.sent < run.length)
+    {
+        size_t length = run.length - run.sent;
+
+        if (length > chunk_size())
+        {
+            length = chunk_size();
+        }
+
+        if (repl_credit_known)
+        {
+            if (repl_credit_left() == 0)
+            {
+                return;
+            }
+
+            if (length > repl_credit_left())
+            {
+                length = repl_credit_left();
+            }
+        }
+
+        if (windowed)
+        {
+            if (run.window_left == 0)
+            {
+                return;
+            }
+
+            if (length > run.window_left)
+            {
+                length = run.window_left;
+            }
+        }
+        else if (!repl_credit_known && queued_writes(HOST_BLE_REPL) > 0)
+        {
+            // Without flow control, only send one write per connection event
+            return;
+        }
+
+        if (!queue_write(HOST_BLE_REPL, &run.data[run.sent], length))
+        {
+            return;
+        }
+
+        run.sent += length;
+
+        if (windowed)
+        {
+            run.window_left -= length;
+        }
+    }
+
+    const char end[] = {CTRL_D, '\0'};
+
+    if (script_state == SCRIPT_PASTE_SENDING)
+    {
+        queue_repl_string(end);
+        script_state = SCRIPT_WAIT_PASTE_ACK;
+    }
+    else if (script_state == SCRIPT_COMPRESSED_SENDING)
+    {
+        // Executing doesn't need to wait for the inflate to be acknowledged
+        queue_repl_string(end);
+        script_state = SCRIPT_WAIT_INFLATED;
+    }
+    else if (repl_credit_known || queued_writes(HOST_BLE_REPL) == 0)
+    {
+        queue_repl_string(end);
+        script_state = SCRIPT_WAIT_OK;
+    }
+}
+
+static void prompt_received(const uint8_t *data, size_t length)
+{
+    static const char raw_prompt[] = "raw REPL; CTRL-B to exit\r\n>";
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (run.prompt_length == sizeof(run.prompt))
+        {
+            memmove(run.prompt, &run.prompt[1], sizeof(run.prompt) - 1);
+            run.prompt_length--;
+        }
+
+        run.prompt[run.prompt_length++] = (char)data[i];
+    }
+
+    size_t prompt_length = sizeof(raw_prompt) - 1;
+
+    if (run.prompt_length >= prompt_length &&
+        memcmp(&run.prompt[run.prompt_length - prompt_length],
+               raw_prompt,
+               prompt_length) == 0)
+    {
+        run.prompt_length = 0;
+        start_script();
+    }
+}
+
+static void script_byte_received(uint8_t byte)
+{
+    switch (script_state)
+    {
+    case SCRIPT_WAIT_COMPRESSED_RESPONSE:
+    {
+        run.response[run.response_length++] = byte;
+
+        if (run.response_length == 2 && run.response[0] == 'R' &&
+            run.response[1] == 0x00)
+        {
+            // Not supported, so fall back to raw paste mode
+            const char raw_paste_request[] = {CTRL_E, 'A', CTRL_A, '\0'};
+            queue_repl_string(raw_paste_request);
+            script_state = SCRIPT_WAIT_PASTE_RESPONSE;
+            run.response_length = 0;
+        }
+        else if (run.response_length == 4 && run.response[0] == 'Z')
+        {
+            run.window_size = run.response[2] | run.response[3] << 8;
+            run.window_left = run.window_size;
+            script_state = SCRIPT_COMPRESSED_SENDING;
+            run.response_length = 0;
+            compress_script();
+            send_script_data();
+        }
+        else if (run.response_length == 2 && run.response[0] != 'R' &&
+                 run.response[0] != 'Z')
+        {
+            fprintf(stderr, "host: unexpected compressed upload response\n");
+            host_exit(2);
+        }
+        break;
+    }
+
+    case SCRIPT_COMPRESSED_SENDING:
+        if (byte == CTRL_A)
+        {
+            run.window_left += run.window_size;
+            send_script_data();
+        }
+        else if (byte == NAK)
+        {
+            fprintf(stderr, "host: compressed upload was rejected\n");
+            host_exit(2);
+        }
+        break;
+
+    case SCRIPT_WAIT_INFLATED:
+        if (byte == CTRL_D)
+        {
+            script_state = SCRIPT_WAIT_OK;
+        }
+        else if (byte == NAK)
+        {
+            fprintf(stderr, "host: compressed upload was rejected\n");
+            host_exit(2);
+        }
+        break;
+
+    case SCRIPT_WAIT_PASTE_RESPONSE:
+    {
+        run.response[run.response_length++] = byte;
+
+        if (run.response_length == 2 && run.response[0] == 'R' &&
+            run.response[1] == 0x00)
+        {
+            script_state = SCRIPT_RAW_SENDING;
+            run.response_length = 0;
+            send_script_data();
+        }
+        else if (run.response_length == 4 && run.response[0] == 'R')
+        {
+            run.window_size = run.response[2] | run.response[3] << 8;
+            run.window_left = run.window_size;
+            script_state = SCRIPT_PASTE_SENDING;
+            run.response_length = 0;
+            send_script_data();
+        }
+        else if (run.response_length == 2 && run.response[0] != 'R')
+        {
+            fprintf(stderr, "host: unexpected raw paste response\n");
+            host_exit(2);
+        }
+        break;
+    }
+
+    case SCRIPT_PASTE_SENDING:
+    case SCRIPT_WAIT_PASTE_ACK:
+        if (byte == CTRL_A)
+        {
+            run.window_left += run.window_size;
+            if (script_state == SCRIPT_PASTE_SENDING)
+            {
+                send_script_data();
+            }
+        }
+        else if (byte == CTRL_D)
+        {
+            // Either the ack of our end of data, or the firmware aborting
+            if (script_state == SCRIPT_PASTE_SENDING)
+            {
+                const char end[] = {CTRL_D, '\0'};
+                queue_repl_string(end);
+            }
+            script_state = SCRIPT_STDOUT;
+        }
+        break;
+
+    case SCRIPT_WAIT_OK:
+        run.response[run.response_length++] = byte;
+
+        if (run.response_length == 2)
+        {
+            if (run.response[0] != 'O' || run.response[1] != 'K')
+            {
+                fprintf(stderr, "host: unexpected raw REPL response\n");
+                host_exit(2);
+            }
+            run.response_length = 0;
+            script_state = SCRIPT_STDOUT;
+        }
+        break;
+
+    case SCRIPT_STDOUT:
+        if (byte == CTRL_D)
+        {
+            fflush(stdout);
+            script_state = SCRIPT_STDERR;
+        }
+        else
+        {
+            fputc(byte, stdout);
+        }
+        break;
+
+    case SCRIPT_STDERR:
+        if (byte == CTRL_D)
+        {
+            fflush(stderr);
+            script_state = SCRIPT_WAIT_PROMPT;
+
+            if (run.stderr_output)
+            {
+                run.status = 1;
+            }
+        }
+        else
+        {
+            run.stderr_output = true;
+            fputc(byte, stderr);
+        }
+        break;
+
+    case SCRIPT_WAIT_PROMPT:
+        if (byte == '>')
+        {
+            run.index++;
+            start_script();
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void host_central_notification(host_ble_channel_t channel,
+                               const uint8_t *data,
+                               size_t length)
+{
+    last_activity_us = host_time_us();
+
+    if (channel == HOST_BLE_REPL_CREDIT)
+    {
+        if (length == 4)
+        {
+            repl_credit = data[0] | data[1] << 8 | data[2] << 16 |
+                          (uint32_t)data[3] << 24;
+            repl_credit_known = true;
+        }
+
+        if (script_state == SCRIPT_RAW_SENDING ||
+            script_state == SCRIPT_PASTE_SENDING ||
+            script_state == SCRIPT_COMPRESSED_SENDING)
+        {
+            send_script_data();
+        }
+        return;
+    }
+
+    if (channel == HOST_BLE_DATA)
+    {
+        if (data_out != NULL)
+        {
+            fwrite(data, 1, length, data_out);
+        }
+        return;
+    }
+
+    if (interactive)
+    {
+        fwrite(data, 1, length, stdout);
+        fflush(stdout);
+        return;
+    }
+
+    if (script_state == SCRIPT_WAIT_RAW_PROMPT)
+    {
+        prompt_received(data, length);
+        return;
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        script_byte_received(data[i]);
+    }
+}
+
+static void poll_stdin(void)
+{
+    if (stdin_ended || queued_writes(HOST_BLE_REPL) > 0)
+    {
+        return;
+    }
+
+    uint8_t buffer[MAX_WRITE_LENGTH];
+    size_t size = chunk_size() < sizeof(buffer) ? chunk_size() : sizeof(buffer);
+
+    if (repl_credit_known && size > repl_credit_left())
+    {
+        size = repl_credit_left();
+    }
+
+    if (size == 0)
+    {
+        return;
+    }
+    ssize_t length = read(STDIN_FILENO, buffer, size);
+
+    if (length == 0)
+    {
+        stdin_ended = true;
+        return;
+    }
+
+    if (length < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            stdin_ended = true;
+        }
+        return;
+    }
+
+    if (stdin_is_tty && memchr(buffer, CTRL_RIGHT_BRACKET, length) != NULL)
+    {
+        host_exit(0);
+    }
+
+    last_activity_us = host_time_us();
+    queue_write(HOST_BLE_REPL, buffer, length);
+}
+
+static void send_data_in(void)
+{
+    if (data_in_sent == data_in_length || queued_writes(HOST_BLE_DATA) > 0)
+    {
+        return;
+    }
+
+    size_t length = data_in_length - data_in_sent;
+
+    if (length > chunk_size())
+    {
+        length = chunk_size();
+    }
+
+    if (queue_write(HOST_BLE_DATA, &data_in[data_in_sent], length))
+    {
+        data_in_sent += length;
+    }
+}
+
+void host_central_connection_event(void)
+{
+    if (!connected)
+    {
+        return;
+    }
+
+    send_data_in();
+
+    if (interactive)
+    {
+        poll_stdin();
+
+        if (stdin_ended && write_count == 0 &&
+            host_time_us() - last_activity_us > STDIN_IDLE_EXIT_US)
+        {
+            host_exit(0);
+        }
+        return;
+    }
+
+    if (script_state == SCRIPT_RAW_SENDING)
+    {
+        send_script_data();
+    }
+}
+
+void host_central_connected(void)
+{
+    connected = true;
+    last_activity_us = host_time_us();
+
+    if (interactive)
+    {
+        return;
+    }
+
+    // Interrupt whatever is running, and enter the raw REPL like mpremote
+    const char interrupt[] = {'\r', 0x03, 0x03, '\0'};
+    const char enter_raw_repl[] = {'\r', CTRL_A, '\0'};
+    queue_repl_string(interrupt);
+    queue_repl_string(enter_raw_repl);
+
+    run.prompt_length = 0;
+    script_state = SCRIPT_WAIT_RAW_PROMPT;
+}
+
+void host_central_disconnected(void)
+{
+    connected = false;
+    write_head = 0;
+    write_count = 0;
+    repl_credit_known = false;
+    repl_credit = 0;
+    repl_sent = 0;
+
+    if (!interactive)
+    {
+        fprintf(stderr, "host: disconnected while running scripts\n");
+        host_exit(2);
+    }
+}
+
+void host_central_init(void)
+{
+    script_count = host_options.script_count +
+                   (host_options.command != NULL ? 1 : 0);
+    interactive = script_count == 0;
+
+    if (!interactive)
+    {
+        scripts = calloc(script_count, sizeof(script_t));
+        size_t index = 0;
+
+        if (host_options.command != NULL)
+        {
+            scripts[index].code = strdup(host_options.command);
+            scripts[index].length = strlen(host_options.command);
+            index++;
+        }
+
+        for (size_t i = 0; i < host_options.script_count; i++, index++)
+        {
+            scripts[index].code = load_script(host_options.scripts[i],
+                                              &scripts[index].length);
+        }
+    }
+    else
+    {
+        stdin_is_tty = isatty(STDIN_FILENO);
+
+        if (stdin_is_tty)
+        {
+            struct termios raw;
+            tcgetattr(STDIN_FILENO, &saved_termios);
+            raw = saved_termios;
+            cfmakeraw(&raw);
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+            fprintf(stderr, "host: press Ctrl-] to exit\r\n");
+        }
+
+        saved_stdin_flags = fcntl(STDIN_FILENO, F_GETFL);
+        fcntl(STDIN_FILENO, F_SETFL, saved_stdin_flags | O_NONBLOCK);
+    }
+
+    if (host_options.data_in != NULL)
+    {
+        data_in = (uint8_t *)load_script(host_options.data_in, &data_in_length);
+    }
+
+    if (host_options.data_out != NULL)
+    {
+        data_out = fopen(host_options.data_out, "wb");
+
+        if (data_out == NULL)
+        {
+            fprintf(stderr, "host: cannot write %s\n", host_options.data_out);
+            exit(2);
+        }
+    }
+}
+
+void host_central_deinit(void)
+{
+    if (interactive)
+    {
+        fcntl(STDIN_FILENO, F_SETFL, saved_stdin_flags);
+
+        if (stdin_is_tty)
+        {
+            tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+        }
+    }
+
+    if (data_out != NULL)
+    {
+        fclose(data_out);
+        data_out = NULL;
+    }
+}
@@ -0,0 +1,241 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief A small zlib compressor for the central's compressed uploads, so that
+ *        the simulator doesn't need a 32-bit build of zlib. It emits a single
+ *        fixed Huffman block, with matches found through hash chains. Scripts
+ *        compress nearly as well this way as with dynamic Huffman trees.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+
+#define WINDOW_SIZE 1024
+#define HASH_SIZE 4096
+#define MAX_CHAIN 128
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+
+static const uint16_t length_base[] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+
+static const uint8_t length_extra[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+    2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+static const uint16_t distance_base[] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193,
+    12289, 16385, 24577};
+
+static const uint8_t distance_extra[] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+typedef struct bit_writer_t
+{
+    uint8_t *out;
+    size_t length;
+    uint32_t bits;
+    uint8_t count;
+} bit_writer_t;
+
+static void put_bits(bit_writer_t *writer, uint32_t value, uint8_t count)
+{
+    writer->bits |= value << writer->count;
+    writer->count += count;
+
+    while (writer->count >= 8)
+    {
+        writer->out[writer->length++] = writer->bits & 0xFF;
+        writer->bits >>= 8;
+        writer->count -= 8;
+    }
+}
+
+// Huffman codes are sent most significant bit first
+static void put_code(bit_writer_t *writer, uint32_t code, uint8_t count)
+{
+    uint32_t reversed = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        reversed = reversed << 1 | ((code >> i) & 1);
+    }
+
+    put_bits(writer, reversed, count);
+}
+
+static void put_symbol(bit_writer_t *writer, uint16_t symbol)
+{
+    if (symbol < 144)
+    {
+        put_code(writer, 0x30 + symbol, 8);
+    }
+    else if (symbol < 256)
+    {
+        put_code(writer, 0x190 + symbol - 144, 9);
+    }
+    else if (symbol < 280)
+    {
+        put_code(writer, symbol - 256, 7);
+    }
+    else
+    {
+        put_code(writer, 0xC0 + symbol - 280, 8);
+    }
+}
+
+static void put_match(bit_writer_t *writer, size_t length, size_t distance)
+{
+    uint8_t code = sizeof(length_base) / sizeof(length_base[0]) - 1;
+
+    while (length_base[code] > length)
+    {
+        code--;
+    }
+
+    put_symbol(writer, 257 + code);
+    put_bits(writer, length - length_base[code], length_extra[code]);
+
+    code = sizeof(distance_base) / sizeof(distance_base[0]) - 1;
+
+    while (distance_base[code] > distance)
+    {
+        code--;
+    }
+
+    put_code(writer, code, 5);
+    put_bits(writer, distance - distance_base[code], distance_extra[code]);
+}
+
+static uint32_t hash(const uint8_t *bytes)
+{
+    return ((bytes[0] << 8) ^ (bytes[1] << 4) ^ bytes[2]) % HASH_SIZE;
+}
+
+size_t host_deflate_bound(size_t length)
+{
+    return length + length / 8 + 16;
+}
+
+size_t host_deflate(const uint8_t *in, size_t length, uint8_t *out)
+{
+    bit_writer_t writer = {.out = out};
+
+    // zlib header for a 1K window, then a final fixed Huffman block
+    out[writer.length++] = 0x28;
+    out[writer.length++] = 0x91;
+    put_bits(&writer, 1, 1);
+    put_bits(&writer, 1, 2);
+
+    // Positions are stored off by one, so that zero means no entry
+    size_t *head = calloc(HASH_SIZE, sizeof(size_t));
+    size_t *previous = calloc(length + 1, sizeof(size_t));
+
+    size_t position = 0;
+
+    while (position < length)
+    {
+        size_t best_length = 0;
+        size_t best_distance = 0;
+
+        if (length - position >= MIN_MATCH)
+        {
+            uint32_t key = hash(&in[position]);
+            size_t candidate = head[key];
+
+            for (int chain = 0;
+                 candidate != 0 && chain < MAX_CHAIN &&
+                 position - (candidate - 1) <= WINDOW_SIZE;
+                 chain++, candidate = previous[candidate - 1])
+            {
+                const uint8_t *match = &in[candidate - 1];
+                size_t limit = length - position < MAX_MATCH ? length - position
+                                                             : MAX_MATCH;
+                size_t matched = 0;
+
+                while (matched < limit && match[matched] == in[position + matched])
+                {
+                    matched++;
+                }
+
+                if (matched > best_length)
+                {
+                    best_length = matched;
+                    best_distance = position - (candidate - 1);
+                }
+            }
+        }
+
+        size_t advance = best_length >= MIN_MATCH ? best_length : 1;
+
+        if (advance > 1)
+        {
+            put_match(&writer, best_length, best_distance);
+        }
+        else
+        {
+            put_symbol(&writer, in[position]);
+        }
+
+        for (size_t i = 0; i < advance; i++, position++)
+        {
+            if (length - position >= MIN_MATCH)
+            {
+                uint32_t key = hash(&in[position]);
+                previous[position] = head[key];
+                head[key] = position + 1;
+            }
+        }
+    }
+
+    free(head);
+    free(previous);
+
+    // End of block, then the Adler-32 of the input, big endian
+    put_symbol(&writer, 256);
+    put_bits(&writer, 0, 7);
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        a = (a + in[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    uint32_t adler = b << 16 | a;
+
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        out[writer.length++] = (adler >> shift) & 0xFF;
+    }
+
+    return writer.length;
+}
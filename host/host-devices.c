@@ -0,0 +1,820 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Simulated peripherals of the Monocle PCB: the FPGA with its camera
+ *        and microphone interfaces, the display, the SPI flash, the PMIC, the
+ *        touch IC and the camera sensor. Only the behaviour which the firmware
+ *        relies on is modeled, with datasheet timings where it matters.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "monocle.h"
+
+#define FLASH_SIZE 0x100000
+#define FLASH_PAGE_SIZE 256
+#define FLASH_SECTOR_SIZE 0x1000
+
+// GD25Q80C typical program and erase times
+#define FLASH_PAGE_PROGRAM_US 600
+#define FLASH_SECTOR_ERASE_US 50000
+#define FLASH_BLOCK_32K_ERASE_US 160000
+#define FLASH_BLOCK_64K_ERASE_US 250000
+#define FLASH_CHIP_ERASE_US 3000000
+
+#define CAMERA_CAPTURE_US 60000
+#define CAMERA_SYNTHETIC_IMAGE_SIZE 16384
+#define CAMERA_DEFAULT_PIXELS (640 * 400)
+#define CAMERA_MAX_RGB_SIZE (CAMERA_DEFAULT_PIXELS * 2)
+
+#define MICROPHONE_FIFO_WORDS 16384
+#define MICROPHONE_BLOCK_SAMPLES 320
+
+static struct flash_t
+{
+    uint8_t *memory;
+    uint32_t sector_erases[FLASH_SIZE / FLASH_SECTOR_SIZE];
+    bool powered_down;
+    bool write_enabled;
+    uint64_t busy_until_us;
+    uint8_t command;
+    size_t index;
+    uint32_t address;
+    uint8_t page[FLASH_PAGE_SIZE];
+    size_t page_length;
+} flash;
+
+static struct fpga_t
+{
+    bool running;
+    size_t index;
+    uint16_t address;
+    uint8_t data[2];
+} fpga = {
+    .running = true,
+};
+
+static struct camera_t
+{
+    uint8_t registers[0x10000];
+    uint8_t *image;
+    size_t image_size;
+    bool synthetic;
+    bool capturing;
+    uint64_t capture_done_us;
+    size_t image_read;
+    size_t image_available;
+} camera;
+
+static struct microphone_t
+{
+    bool low_sample_rate;
+    uint16_t blocks;
+    bool recording;
+    uint64_t start_us;
+    uint64_t total_samples;
+    uint64_t read_samples;
+    uint8_t partial_sample;
+    bool partial;
+} microphone;
+
+static uint8_t pmic_registers[0x100];
+
+static uint8_t touch_registers[0x100];
+
+static struct display_t
+{
+    size_t index;
+} display;
+
+static bool flash_busy(void)
+{
+    return host_time_us() < flash.busy_until_us;
+}
+
+static void flash_select(void)
+{
+    flash.command = 0;
+    flash.index = 0;
+    flash.address = 0;
+    flash.page_length = 0;
+}
+
+static uint8_t flash_exchange(uint8_t mosi)
+{
+    size_t index = flash.index++;
+
+    if (index == 0)
+    {
+        flash.command = mosi;
+
+        if (flash.command == 0x05 || flash.command == 0x35)
+        {
+            host_counters.flash_status_reads++;
+        }
+
+        return 0xFF;
+    }
+
+    // Only the release and status commands work in deep power down or busy
+    if (flash.powered_down && flash.command != 0xAB)
+    {
+        return 0xFF;
+    }
+
+    if (flash_busy() && flash.command != 0x05 && flash.command != 0x35)
+    {
+        return 0xFF;
+    }
+
+    switch (flash.command)
+    {
+    case 0x05:
+        return (flash_busy() ? 0x01 : 0x00) | (flash.write_enabled ? 0x02 : 0x00);
+
+    case 0x35:
+        return 0x00;
+
+    case 0x9F:
+    {
+        const uint8_t jedec_id[] = {0xC8, 0x40, 0x14};
+        return index <= sizeof(jedec_id) ? jedec_id[index - 1] : 0xFF;
+    }
+
+    case 0xAB:
+        return index >= 4 ? 0x13 : 0xFF;
+
+    case 0x03:
+    case 0x0B:
+    case 0x02:
+    case 0x20:
+    case 0x52:
+    case 0xD8:
+    {
+        if (index <= 3)
+        {
+            flash.address = (flash.address << 8 | mosi) & (FLASH_SIZE - 1);
+            return 0xFF;
+        }
+
+        if (flash.command == 0x03 || (flash.command == 0x0B && index > 4))
+        {
+            host_counters.flash_read_bytes++;
+            uint8_t value = flash.memory[flash.address];
+            flash.address = (flash.address + 1) & (FLASH_SIZE - 1);
+            return value;
+        }
+
+        if (flash.command == 0x02)
+        {
+            // Data beyond the end of the page wraps to its start
+            if (flash.page_length < FLASH_PAGE_SIZE)
+            {
+                flash.page_length++;
+            }
+
+            size_t offset = (flash.address + index - 4) % FLASH_PAGE_SIZE;
+            flash.page[offset] = mosi;
+        }
+
+        return 0xFF;
+    }
+
+    default:
+        return 0xFF;
+    }
+}
+
+static void flash_erase(uint32_t address, uint32_t size, uint64_t duration_us)
+{
+    address &= ~(size - 1);
+
+    memset(&flash.memory[address], 0xFF, size);
+
+    for (uint32_t sector = address / FLASH_SECTOR_SIZE;
+         sector < (address + size) / FLASH_SECTOR_SIZE;
+         sector++)
+    {
+        flash.sector_erases[sector]++;
+    }
+
+    host_counters.flash_erases++;
+    flash.busy_until_us = host_time_us() + duration_us;
+}
+
+static void flash_deselect(void)
+{
+    size_t length = flash.index;
+
+    if (length == 0 || flash_busy())
+    {
+        return;
+    }
+
+    if (flash.powered_down)
+    {
+        if (flash.command == 0xAB)
+        {
+            flash.powered_down = false;
+        }
+        return;
+    }
+
+    switch (flash.command)
+    {
+    case 0xB9:
+        flash.powered_down = true;
+        break;
+
+    case 0x06:
+        flash.write_enabled = true;
+        break;
+
+    case 0x04:
+        flash.write_enabled = false;
+        break;
+
+    case 0x02:
+    {
+        if (!flash.write_enabled || length < 5)
+        {
+            break;
+        }
+
+        // Programming can only clear bits, and wraps within the page
+        uint32_t page_start = flash.address & ~(FLASH_PAGE_SIZE - 1);
+        size_t start = flash.address % FLASH_PAGE_SIZE;
+
+        for (size_t i = 0; i < flash.page_length; i++)
+        {
+            size_t offset = (start + i) % FLASH_PAGE_SIZE;
+            flash.memory[page_start + offset] &= flash.page[offset];
+        }
+
+        host_counters.flash_program_bytes += flash.page_length;
+        flash.busy_until_us = host_time_us() + FLASH_PAGE_PROGRAM_US;
+        flash.write_enabled = false;
+        break;
+    }
+
+    case 0x20:
+    case 0x52:
+    case 0xD8:
+    {
+        if (!flash.write_enabled || length != 4)
+        {
+            break;
+        }
+
+        if (flash.command == 0x20)
+        {
+            flash_erase(flash.address, 0x1000, FLASH_SECTOR_ERASE_US);
+        }
+        else if (flash.command == 0x52)
+        {
+            flash_erase(flash.address, 0x8000, FLASH_BLOCK_32K_ERASE_US);
+        }
+        else
+        {
+            flash_erase(flash.address, 0x10000, FLASH_BLOCK_64K_ERASE_US);
+        }
+
+        flash.write_enabled = false;
+        break;
+    }
+
+    case 0x60:
+    case 0xC7:
+    {
+        if (!flash.write_enabled || length != 1)
+        {
+            break;
+        }
+
+        flash_erase(0, FLASH_SIZE, FLASH_CHIP_ERASE_US);
+        flash.write_enabled = false;
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+// A synthetic frame follows the output size and format programmed into the
+// sensor. JPEG frames scale with the pixel count, and RGB565 is uncompressed
+static size_t camera_frame_size(void)
+{
+    size_t width = camera.registers[0x3808] << 8 | camera.registers[0x3809];
+    size_t height = camera.registers[0x380a] << 8 | camera.registers[0x380b];
+
+    if (!camera.synthetic || width == 0 || height == 0)
+    {
+        return camera.image_size;
+    }
+
+    if ((camera.registers[0x3821] & 0x20) == 0)
+    {
+        size_t size = width * height * 2;
+        return size < camera.image_size ? size : camera.image_size;
+    }
+
+    size_t size = CAMERA_SYNTHETIC_IMAGE_SIZE * width * height /
+                  CAMERA_DEFAULT_PIXELS;
+    size = size < 64 ? 64 : size;
+
+    camera.image[0] = 0xFF;
+    camera.image[1] = 0xD8;
+    camera.image[size - 2] = 0xFF;
+    camera.image[size - 1] = 0xD9;
+
+    return size;
+}
+
+static void camera_update(void)
+{
+    if (camera.capturing && host_time_us() >= camera.capture_done_us)
+    {
+        camera.capturing = false;
+        camera.image_read = 0;
+        camera.image_available = camera_frame_size();
+    }
+}
+
+static bool camera_powered(void)
+{
+    return host_gpio_level(CAMERA_RESET_PIN) &&
+           !host_gpio_level(CAMERA_SLEEP_PIN);
+}
+
+static uint64_t microphone_produced_samples(void)
+{
+    if (!microphone.recording)
+    {
+        return microphone.read_samples;
+    }
+
+    uint64_t rate = microphone.low_sample_rate ? 8000 : 16000;
+    uint64_t produced = (host_time_us() - microphone.start_us) * rate / 1000000;
+
+    if (produced > microphone.total_samples)
+    {
+        produced = microphone.total_samples;
+    }
+
+    // Samples which don't fit in the FIFO are lost
+    if (produced - microphone.read_samples > MICROPHONE_FIFO_WORDS)
+    {
+        microphone.read_samples = produced - MICROPHONE_FIFO_WORDS;
+    }
+
+    return produced;
+}
+
+static uint8_t microphone_next_byte(void)
+{
+    if (microphone.partial)
+    {
+        microphone.partial = false;
+        return microphone.partial_sample;
+    }
+
+    if (microphone_produced_samples() == microphone.read_samples)
+    {
+        return 0x00;
+    }
+
+    // A 1kHz tone, sent big endian
+    uint64_t rate = microphone.low_sample_rate ? 8000 : 16000;
+    double phase = 2.0 * M_PI * 1000.0 * (double)microphone.read_samples /
+                   (double)rate;
+    int16_t sample = (int16_t)(8192.0 * sin(phase));
+
+    microphone.read_samples++;
+    microphone.partial = true;
+    microphone.partial_sample = (uint8_t)sample;
+    return (uint8_t)((uint16_t)sample >> 8);
+}
+
+static uint8_t fpga_read(uint16_t address, size_t index)
+{
+    switch (address)
+    {
+    case 0x0001:
+        return index < 4 ? "Mncl"[index] : 0x00;
+
+    case 0x1000:
+        camera_update();
+        return camera.capturing ? 0x32 : 0x10;
+
+    case 0x1006:
+    {
+        camera_update();
+        uint16_t available = camera.image_available - camera.image_read > 0xFFFF
+                                 ? 0xFFFF
+                                 : camera.image_available - camera.image_read;
+        return index == 0 ? available >> 8 : index == 1 ? available & 0xFF : 0;
+    }
+
+    case 0x1007:
+        camera_update();
+        if (camera.image_read < camera.image_available)
+        {
+            return camera.image[camera.image_read++];
+        }
+        return 0x00;
+
+    case 0x5800:
+        return 0x10;
+
+    case 0x5801:
+    {
+        uint64_t available = microphone_produced_samples() -
+                             microphone.read_samples;
+        if (available > 0xFFFF)
+        {
+            available = 0xFFFF;
+        }
+        return index == 0 ? available >> 8 : index == 1 ? available & 0xFF : 0;
+    }
+
+    case 0x5807:
+        return microphone_next_byte();
+
+    case 0x0800:
+        return microphone.low_sample_rate ? 0x04 : 0x00;
+
+    default:
+        return 0x00;
+    }
+}
+
+static void fpga_command(uint16_t address, size_t data_length)
+{
+    switch (address)
+    {
+    case 0x1003:
+        camera_update();
+        camera.capturing = true;
+        camera.capture_done_us = host_time_us() + CAMERA_CAPTURE_US;
+        camera.image_read = 0;
+        camera.image_available = 0;
+        break;
+
+    case 0x0802:
+        if (data_length == 2)
+        {
+            microphone.blocks = fpga.data[0] << 8 | fpga.data[1];
+        }
+        break;
+
+    case 0x0803:
+        microphone.recording = true;
+        microphone.start_us = host_time_us();
+        microphone.total_samples = (uint64_t)microphone.blocks *
+                                   MICROPHONE_BLOCK_SAMPLES;
+        microphone.read_samples = 0;
+        microphone.partial = false;
+        break;
+
+    case 0x0808:
+        microphone.low_sample_rate = !microphone.low_sample_rate;
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void fpga_select(void)
+{
+    fpga.index = 0;
+    fpga.address = 0;
+}
+
+static uint8_t fpga_exchange(uint8_t mosi)
+{
+    if (!fpga.running)
+    {
+        return 0xFF;
+    }
+
+    host_counters.fpga_bytes++;
+
+    size_t index = fpga.index++;
+
+    if (index < 2)
+    {
+        fpga.address = fpga.address << 8 | mosi;
+        return 0x00;
+    }
+
+    if ((fpga.address >> 8) == 0x44 || (fpga.address >> 8) == 0x45)
+    {
+        host_counters.display_bytes++;
+    }
+
+    if (index - 2 < sizeof(fpga.data))
+    {
+        fpga.data[index - 2] = mosi;
+    }
+
+    return fpga_read(fpga.address, index - 2);
+}
+
+static void fpga_deselect(void)
+{
+    if (fpga.running && fpga.index >= 2)
+    {
+        fpga_command(fpga.address, fpga.index - 2);
+    }
+}
+
+static void display_select(void)
+{
+    display.index = 0;
+}
+
+static uint8_t display_exchange(uint8_t mosi)
+{
+    (void)mosi;
+    display.index++;
+    host_counters.display_bytes++;
+    return 0xFF;
+}
+
+static void display_deselect(void)
+{
+}
+
+static const host_spi_device_t spi_devices[] = {
+    {
+        .name = "flash",
+        .cs_pin = FLASH_CS_PIN,
+        .msb_first = true,
+        .select = flash_select,
+        .exchange = flash_exchange,
+        .deselect = flash_deselect,
+    },
+    {
+        .name = "fpga",
+        .cs_pin = FPGA_CS_MODE_PIN,
+        .msb_first = false,
+        .select = fpga_select,
+        .exchange = fpga_exchange,
+        .deselect = fpga_deselect,
+    },
+    {
+        .name = "display",
+        .cs_pin = DISPLAY_CS_PIN,
+        .msb_first = false,
+        .select = display_select,
+        .exchange = display_exchange,
+        .deselect = display_deselect,
+    },
+};
+
+const host_spi_device_t *host_spi_device_on_pin(uint8_t pin)
+{
+    for (size_t i = 0; i < sizeof(spi_devices) / sizeof(spi_devices[0]); i++)
+    {
+        if (spi_devices[i].cs_pin == pin)
+        {
+            return &spi_devices[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint8_t pmic_read(uint16_t reg)
+{
+    return pmic_registers[reg & 0xFF];
+}
+
+static void pmic_write(uint16_t reg, uint8_t value)
+{
+    pmic_registers[reg & 0xFF] = value;
+}
+
+static uint8_t touch_read(uint16_t reg)
+{
+    return touch_registers[reg & 0xFF];
+}
+
+static void touch_write(uint16_t reg, uint8_t value)
+{
+    // Event flags are read only, and nobody ever touches the simulator
+    if ((reg & 0xFF) != 0x12)
+    {
+        touch_registers[reg & 0xFF] = value;
+    }
+}
+
+static uint8_t camera_read(uint16_t reg)
+{
+    return camera.registers[reg];
+}
+
+static void camera_write(uint16_t reg, uint8_t value)
+{
+    // The chip ID registers are read only
+    if (reg != 0x300A && reg != 0x300B)
+    {
+        camera.registers[reg] = value;
+    }
+}
+
+static const host_i2c_device_t i2c_devices[] = {
+    {
+        .name = "pmic",
+        .bus = 0,
+        .address = PMIC_I2C_ADDRESS,
+        .wide_register = false,
+        .powered = NULL,
+        .read = pmic_read,
+        .write = pmic_write,
+    },
+    {
+        .name = "touch",
+        .bus = 0,
+        .address = TOUCH_I2C_ADDRESS,
+        .wide_register = false,
+        .powered = NULL,
+        .read = touch_read,
+        .write = touch_write,
+    },
+    {
+        .name = "camera",
+        .bus = 1,
+        .address = CAMERA_I2C_ADDRESS,
+        .wide_register = true,
+        .powered = camera_powered,
+        .read = camera_read,
+        .write = camera_write,
+    },
+};
+
+const host_i2c_device_t *host_i2c_device_at(uint8_t bus, uint8_t address)
+{
+    for (size_t i = 0; i < sizeof(i2c_devices) / sizeof(i2c_devices[0]); i++)
+    {
+        if (i2c_devices[i].bus == bus && i2c_devices[i].address == address)
+        {
+            return &i2c_devices[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint8_t *load_file(const char *path, size_t *size, size_t max_size)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    uint8_t *data = malloc(max_size);
+    *size = fread(data, 1, max_size, file);
+    fclose(file);
+
+    return data;
+}
+
+static void synthesize_image(void)
+{
+    // A JPEG shaped stream of noise, which is enough for transfer tests. It's
+    // large enough for an uncompressed frame, and cut to size when captured
+    camera.image_size = CAMERA_MAX_RGB_SIZE;
+    camera.image = malloc(camera.image_size);
+    camera.synthetic = true;
+
+    uint32_t seed = 0x4D6E636C;
+    for (size_t i = 0; i < camera.image_size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        camera.image[i] = seed >> 16;
+    }
+
+}
+
+void host_devices_init(void)
+{
+    flash.memory = malloc(FLASH_SIZE);
+    memset(flash.memory, 0xFF, FLASH_SIZE);
+
+    if (host_options.flash_image != NULL)
+    {
+        size_t size;
+        uint8_t *image = load_file(host_options.flash_image, &size, FLASH_SIZE);
+
+        if (image != NULL)
+        {
+            memcpy(flash.memory, image, size);
+            free(image);
+        }
+    }
+
+    if (host_options.camera_image != NULL)
+    {
+        camera.image = load_file(host_options.camera_image,
+                                 &camera.image_size,
+                                 0x10000);
+
+        if (camera.image == NULL)
+        {
+            fprintf(stderr, "host: cannot read %s\n", host_options.camera_image);
+            exit(2);
+        }
+    }
+    else
+    {
+        synthesize_image();
+    }
+
+    camera.registers[0x300A] = 0x56;
+    camera.registers[0x300B] = 0x40;
+
+    pmic_registers[0x14] = 0x02;
+    touch_registers[0x00] = 0x41;
+}
+
+void host_devices_deinit(void)
+{
+    if (host_options.flash_image == NULL || flash.memory == NULL)
+    {
+        return;
+    }
+
+    FILE *file = fopen(host_options.flash_image, "wb");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "host: cannot write %s\n", host_options.flash_image);
+        return;
+    }
+
+    fwrite(flash.memory, 1, FLASH_SIZE, file);
+    fclose(file);
+}
+
+void host_devices_pin_changed(uint8_t pin, bool level)
+{
+    // The FPGA loses its state while held in reset
+    if (pin == FPGA_RESET_INT_PIN)
+    {
+        fpga.running = level;
+
+        if (!level)
+        {
+            camera.capturing = false;
+            camera.image_available = 0;
+            microphone.recording = false;
+            microphone.low_sample_rate = false;
+        }
+    }
+}
+
+uint16_t host_devices_battery_adc(void)
+{
+    // Around 3.9V through the divider, at 10-bit resolution
+    return 924;
+}
+
+uint32_t host_flash_sector_erases(size_t sector)
+{
+    if (sector >= FLASH_SIZE / FLASH_SECTOR_SIZE)
+    {
+        return 0;
+    }
+
+    return flash.sector_erases[sector];
+}
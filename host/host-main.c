@@ -0,0 +1,572 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "host.h"
+#include "nrf.h"
+#include "nrfx.h"
+
+/**
+ * @brief Memory regions which the linker script provides on the nRF. The stack
+ *        is larger than the 8K used on the device because host libc calls run
+ *        on it too. _ram_start is absolute, as the SoftDevice model checks it.
+ */
+
+__asm__(".pushsection .bss\n"
+        ".balign 16\n"
+        ".globl _stack_bot\n"
+        "_stack_bot:\n"
+        ".space 0x10000\n"
+        ".globl _stack_top\n"
+        "_stack_top:\n"
+        ".balign 16\n"
+        ".globl _heap_start\n"
+        "_heap_start:\n"
+        ".space 0x9000\n"
+        ".globl _heap_end\n"
+        "_heap_end:\n"
+        ".popsection\n"
+        ".globl _ram_start\n"
+        ".set _ram_start, 0x2000421C\n");
+
+extern uint32_t _stack_bot;
+extern uint32_t _stack_top;
+
+// Rough cost of entering the SoftDevice through an SVC and returning
+#define SVC_CALL_US 2
+
+extern char __executable_start[];
+extern char __data_start[];
+
+int firmware_main(void);
+
+host_options_t host_options = {
+    .central_mtu = 517,
+    .central_data_length = 251,
+    .central_interval_us = 30000,
+    .central_min_interval_us = 7500,
+};
+
+host_counters_t host_counters;
+
+#define COUNTER(field) {#field, offsetof(host_counters_t, field)}
+
+const host_counter_name_t host_counter_names[] = {
+    COUNTER(svc_calls),
+    COUNTER(spi_transfers),
+    COUNTER(spi_bytes),
+    COUNTER(i2c_transfers),
+    COUNTER(i2c_bytes),
+    COUNTER(i2c_clock_cycles),
+    COUNTER(i2c_bus_us),
+    COUNTER(fpga_bytes),
+    COUNTER(display_bytes),
+    COUNTER(flash_read_bytes),
+    COUNTER(flash_program_bytes),
+    COUNTER(flash_erases),
+    COUNTER(flash_status_reads),
+    COUNTER(ble_connection_events),
+    COUNTER(ble_notifications),
+    COUNTER(ble_notification_bytes),
+    COUNTER(ble_notification_retries),
+    COUNTER(ble_writes),
+    COUNTER(ble_write_bytes),
+};
+
+const size_t host_counter_name_count = sizeof(host_counter_names) /
+                                       sizeof(host_counter_names[0]);
+
+NRF_POWER_Type host_power_peripheral;
+
+CoreDebug_Type host_core_debug;
+
+static uint64_t now_us = 0;
+
+static host_timer_t *timers = NULL;
+
+static host_irq_t *irqs[16];
+
+static size_t irq_count = 0;
+
+static uint32_t irq_wakeups = 0;
+
+static bool in_irq = false;
+
+static int in_timer = 0;
+
+static bool irq_masked = false;
+
+static struct timespec realtime_start;
+
+void host_log(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+bool nrfx_is_in_ram(void const *p_object)
+{
+    const char *p = p_object;
+    return !(p >= __executable_start && p < __data_start);
+}
+
+void NVIC_SystemReset(void)
+{
+    host_log("host: system reset at %llu us\r\n", (unsigned long long)now_us);
+    host_exit(3);
+}
+
+uint64_t host_time_us(void)
+{
+    return now_us;
+}
+
+void host_timer_stop(host_timer_t *timer)
+{
+    for (host_timer_t **p = &timers; *p != NULL; p = &(*p)->next)
+    {
+        if (*p == timer)
+        {
+            *p = timer->next;
+            break;
+        }
+    }
+
+    timer->armed = false;
+    timer->next = NULL;
+}
+
+void host_timer_start(host_timer_t *timer, uint64_t deadline_us)
+{
+    host_timer_stop(timer);
+
+    // Keep the list sorted, with timers at the same deadline in FIFO order
+    host_timer_t **p = &timers;
+    while (*p != NULL && (*p)->deadline_us <= deadline_us)
+    {
+        p = &(*p)->next;
+    }
+
+    timer->deadline_us = deadline_us;
+    timer->armed = true;
+    timer->next = *p;
+    *p = timer;
+}
+
+static void dispatch_irqs(void);
+
+static void run_timers_until(uint64_t until_us)
+{
+    while (timers != NULL && timers->deadline_us <= until_us)
+    {
+        host_timer_t *timer = timers;
+        timers = timer->next;
+        timer->next = NULL;
+        timer->armed = false;
+
+        if (timer->deadline_us > now_us)
+        {
+            now_us = timer->deadline_us;
+        }
+
+        in_timer++;
+        timer->handler();
+        in_timer--;
+
+        dispatch_irqs();
+    }
+}
+
+void host_advance_us(uint64_t us)
+{
+    uint64_t target = now_us + us;
+
+    run_timers_until(target);
+
+    if (target > now_us)
+    {
+        now_us = target;
+    }
+}
+
+void host_svc_call(void)
+{
+    host_counters.svc_calls++;
+    host_advance_us(SVC_CALL_US);
+}
+
+static void sleep_until_realtime(uint64_t deadline_us)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int64_t elapsed_us = (now.tv_sec - realtime_start.tv_sec) * 1000000LL +
+                         (now.tv_nsec - realtime_start.tv_nsec) / 1000;
+
+    if ((int64_t)deadline_us > elapsed_us)
+    {
+        usleep((useconds_t)((int64_t)deadline_us - elapsed_us));
+    }
+}
+
+void host_wait_for_event(void)
+{
+    uint32_t wakeups = irq_wakeups;
+
+    // Like WFE, return straight away if something happened since last time
+    for (size_t i = 0; i < irq_count; i++)
+    {
+        if (irqs[i]->pending && irqs[i]->enabled)
+        {
+            return;
+        }
+    }
+
+    while (wakeups == irq_wakeups)
+    {
+        if (timers == NULL)
+        {
+            host_log("host: deadlock, nothing left to wake up the CPU\r\n");
+            host_exit(4);
+        }
+
+        if (host_options.realtime)
+        {
+            sleep_until_realtime(timers->deadline_us);
+        }
+
+        run_timers_until(timers->deadline_us);
+    }
+}
+
+static void dispatch_irqs(void)
+{
+    if (in_irq || in_timer || irq_masked)
+    {
+        return;
+    }
+
+    in_irq = true;
+
+    bool serviced;
+    do
+    {
+        serviced = false;
+
+        for (size_t i = 0; i < irq_count; i++)
+        {
+            if (irqs[i]->pending && irqs[i]->enabled)
+            {
+                irqs[i]->pending = false;
+                irqs[i]->handler();
+                serviced = true;
+            }
+        }
+    } while (serviced);
+
+    in_irq = false;
+}
+
+static void register_irq(host_irq_t *irq)
+{
+    for (size_t i = 0; i < irq_count; i++)
+    {
+        if (irqs[i] == irq)
+        {
+            return;
+        }
+    }
+
+    if (irq_count == sizeof(irqs) / sizeof(irqs[0]))
+    {
+        host_log("host: too many interrupt sources\r\n");
+        host_exit(4);
+    }
+
+    irqs[irq_count++] = irq;
+}
+
+void host_irq_trigger(host_irq_t *irq)
+{
+    register_irq(irq);
+
+    irq->pending = true;
+
+    if (irq->enabled)
+    {
+        irq_wakeups++;
+        dispatch_irqs();
+    }
+}
+
+void host_irq_enable(host_irq_t *irq, bool enable)
+{
+    register_irq(irq);
+
+    irq->enabled = enable;
+
+    if (enable && irq->pending)
+    {
+        irq_wakeups++;
+        dispatch_irqs();
+    }
+}
+
+void host_irq_mask(bool masked)
+{
+    irq_masked = masked;
+
+    if (!masked)
+    {
+        dispatch_irqs();
+    }
+}
+
+bool host_in_irq(void)
+{
+    return in_irq;
+}
+
+void host_data_barrier(void)
+{
+    __sync_synchronize();
+
+    if (host_power_peripheral.SYSTEMOFF)
+    {
+        host_log("host: system off at %llu us\r\n",
+                 (unsigned long long)now_us);
+        host_exit(0);
+    }
+}
+
+void host_exit(int status)
+{
+    host_central_deinit();
+    host_devices_deinit();
+
+    if (host_options.stats)
+    {
+        fprintf(stderr, "virtual_time_us: %llu\n", (unsigned long long)now_us);
+
+        for (size_t i = 0; i < host_counter_name_count; i++)
+        {
+            const uint64_t *value =
+                (const uint64_t *)((const char *)&host_counters +
+                                   host_counter_names[i].offset);
+
+            fprintf(stderr, "%s: %llu\n",
+                    host_counter_names[i].name,
+                    (unsigned long long)*value);
+        }
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    exit(status);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options] [script.py ...]\n"
+            "\n"
+            "Runs the Monocle firmware against simulated hardware. Scripts are\n"
+            "executed in order through the raw REPL over the simulated BLE\n"
+            "link. Without scripts, stdin and stdout are connected to the REPL.\n"
+            "\n"
+            "  -c CODE             execute CODE through the raw REPL\n"
+            "  --flash FILE        SPI flash image, created if missing\n"
+            "  --camera FILE       JPEG returned by the simulated camera\n"
+            "  --data-in FILE      bytes written to the data service\n"
+            "  --data-out FILE     file receiving data service notifications\n"
+            "  --mtu N             ATT MTU requested by the central (%u)\n"
+            "  --data-length N     LL data length requested by the central (%u)\n"
+            "  --interval US       initial connection interval (%u)\n"
+            "  --min-interval US   shortest interval the central grants (%u)\n"
+            "  --passive           central never starts PHY or data length\n"
+            "                      updates, leaving them to the peripheral\n"
+            "  --packets N         packets per connection event, 0 for no limit\n"
+            "  --compress          send scripts as compressed uploads\n"
+            "  --realtime          pace virtual time to the wall clock\n"
+            "  --stats             print counters on exit\n",
+            name,
+            host_options.central_mtu,
+            host_options.central_data_length,
+            (unsigned)host_options.central_interval_us,
+            (unsigned)host_options.central_min_interval_us);
+}
+
+static void parse_options(int argc, char **argv)
+{
+    enum
+    {
+        OPT_FLASH = 256,
+        OPT_CAMERA,
+        OPT_DATA_IN,
+        OPT_DATA_OUT,
+        OPT_MTU,
+        OPT_DATA_LENGTH,
+        OPT_INTERVAL,
+        OPT_MIN_INTERVAL,
+        OPT_PASSIVE,
+        OPT_PACKETS,
+        OPT_COMPRESS,
+        OPT_REALTIME,
+        OPT_STATS,
+    };
+
+    static const struct option long_options[] = {
+        {"flash", required_argument, NULL, OPT_FLASH},
+        {"camera", required_argument, NULL, OPT_CAMERA},
+        {"data-in", required_argument, NULL, OPT_DATA_IN},
+        {"data-out", required_argument, NULL, OPT_DATA_OUT},
+        {"mtu", required_argument, NULL, OPT_MTU},
+        {"data-length", required_argument, NULL, OPT_DATA_LENGTH},
+        {"interval", required_argument, NULL, OPT_INTERVAL},
+        {"min-interval", required_argument, NULL, OPT_MIN_INTERVAL},
+        {"passive", no_argument, NULL, OPT_PASSIVE},
+        {"packets", required_argument, NULL, OPT_PACKETS},
+        {"compress", no_argument, NULL, OPT_COMPRESS},
+        {"realtime", no_argument, NULL, OPT_REALTIME},
+        {"stats", no_argument, NULL, OPT_STATS},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "c:h", long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 'c':
+            host_options.command = optarg;
+            break;
+        case OPT_FLASH:
+            host_options.flash_image = optarg;
+            break;
+        case OPT_CAMERA:
+            host_options.camera_image = optarg;
+            break;
+        case OPT_DATA_IN:
+            host_options.data_in = optarg;
+            break;
+        case OPT_DATA_OUT:
+            host_options.data_out = optarg;
+            break;
+        case OPT_MTU:
+            host_options.central_mtu = (uint16_t)atoi(optarg);
+            break;
+        case OPT_DATA_LENGTH:
+            host_options.central_data_length = (uint16_t)atoi(optarg);
+            break;
+        case OPT_INTERVAL:
+            host_options.central_interval_us = (uint32_t)atoi(optarg);
+            break;
+        case OPT_MIN_INTERVAL:
+            host_options.central_min_interval_us = (uint32_t)atoi(optarg);
+            break;
+        case OPT_PASSIVE:
+            host_options.central_passive = true;
+            break;
+        case OPT_PACKETS:
+            host_options.packets_per_event = (uint16_t)atoi(optarg);
+            break;
+        case OPT_COMPRESS:
+            host_options.compress = true;
+            break;
+        case OPT_REALTIME:
+            host_options.realtime = true;
+            break;
+        case OPT_STATS:
+            host_options.stats = true;
+            break;
+        default:
+            usage(argv[0]);
+            exit(option == 'h' ? 0 : 1);
+        }
+    }
+
+    host_options.scripts = (const char *const *)&argv[optind];
+    host_options.script_count = argc - optind;
+
+    // Interactive sessions run at wall clock speed, scripted ones flat out
+    if (host_options.command == NULL &&
+        host_options.script_count == 0 &&
+        isatty(STDIN_FILENO))
+    {
+        host_options.realtime = true;
+    }
+
+    if (host_options.central_mtu < 23 ||
+        host_options.central_data_length < 27 ||
+        host_options.central_data_length > 251 ||
+        host_options.central_interval_us < 7500 ||
+        host_options.central_min_interval_us < 7500)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+}
+
+static ucontext_t host_context;
+static ucontext_t firmware_context;
+
+static void firmware_entry(void)
+{
+    firmware_main();
+    host_exit(0);
+}
+
+int main(int argc, char **argv)
+{
+    parse_options(argc, argv);
+
+    clock_gettime(CLOCK_MONOTONIC, &realtime_start);
+
+    host_devices_init();
+    host_central_init();
+
+    // Run the firmware on its own stack so that the GC and stack checker see
+    // the same layout as on the nRF
+    getcontext(&firmware_context);
+    firmware_context.uc_stack.ss_sp = &_stack_bot;
+    firmware_context.uc_stack.ss_size = (char *)&_stack_top -
+                                        (char *)&_stack_bot;
+    firmware_context.uc_link = &host_context;
+    makecontext(&firmware_context, firmware_entry, 0);
+
+    swapcontext(&host_context, &firmware_context);
+
+    host_exit(0);
+}
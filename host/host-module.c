@@ -0,0 +1,165 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief The _host module, only built into the host target. It exposes the
+ *        simulator's virtual clock and counters so that tests and benchmarks
+ *        can measure the firmware without touching its code.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "host.h"
+#include "monocle.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+
+STATIC mp_obj_t host_ticks_us(void)
+{
+    return mp_obj_new_int_from_ull(host_time_us());
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(host_ticks_us_obj, host_ticks_us);
+
+STATIC mp_obj_t host_cpu_us(void)
+{
+    // Real CPU time of the simulator, for micro-benchmarks of firmware code
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return mp_obj_new_int_from_ull((uint64_t)now.tv_sec * 1000000 +
+                                   (uint64_t)now.tv_nsec / 1000);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(host_cpu_us_obj, host_cpu_us);
+
+STATIC mp_obj_t host_counters_get(void)
+{
+    mp_obj_t dict = mp_obj_new_dict(host_counter_name_count);
+
+    for (size_t i = 0; i < host_counter_name_count; i++)
+    {
+        const uint64_t *value =
+            (const uint64_t *)((const char *)&host_counters +
+                               host_counter_names[i].offset);
+
+        mp_obj_dict_store(dict,
+                          mp_obj_new_str(host_counter_names[i].name,
+                                         strlen(host_counter_names[i].name)),
+                          mp_obj_new_int_from_ull(*value));
+    }
+
+    return dict;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(host_counters_obj, host_counters_get);
+
+STATIC mp_obj_t host_reset_counters(void)
+{
+    memset(&host_counters, 0, sizeof(host_counters));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(host_reset_counters_obj, host_reset_counters);
+
+STATIC mp_obj_t host_flash_erase_counts(void)
+{
+    // One entry per 4K sector
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+
+    for (size_t sector = 0; sector < 256; sector++)
+    {
+        mp_obj_list_append(list,
+                           MP_OBJ_NEW_SMALL_INT(host_flash_sector_erases(sector)));
+    }
+
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(host_flash_erase_counts_obj,
+                                 host_flash_erase_counts);
+
+STATIC mp_obj_t host_bit_reverse(mp_obj_t buffer_in, mp_obj_t reference_in)
+{
+    mp_buffer_info_t buffer;
+    mp_get_buffer_raise(buffer_in, &buffer, MP_BUFFER_RW);
+
+    uint8_t *data = buffer.buf;
+
+    if (!mp_obj_is_true(reference_in))
+    {
+        monocle_bit_reverse(data, data, buffer.len);
+        return mp_const_none;
+    }
+
+    // The original byte at a time version, as a baseline for benchmarks
+    for (size_t i = 0; i < buffer.len; i++)
+    {
+        uint8_t byte = data[i];
+        byte = (byte & 0xF0) >> 4 | (byte & 0x0F) << 4;
+        byte = (byte & 0xCC) >> 2 | (byte & 0x33) << 2;
+        byte = (byte & 0xAA) >> 1 | (byte & 0x55) << 1;
+        data[i] = byte;
+    }
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(host_bit_reverse_obj, host_bit_reverse);
+
+STATIC mp_obj_t host_link(void)
+{
+    host_ble_link_t link = host_softdevice_link();
+
+    mp_obj_t dict = mp_obj_new_dict(5);
+    mp_obj_dict_store(dict,
+                      MP_OBJ_NEW_QSTR(MP_QSTR_connected),
+                      mp_obj_new_bool(link.connected));
+    mp_obj_dict_store(dict,
+                      MP_OBJ_NEW_QSTR(MP_QSTR_mtu),
+                      MP_OBJ_NEW_SMALL_INT(link.att_mtu));
+    mp_obj_dict_store(dict,
+                      MP_OBJ_NEW_QSTR(MP_QSTR_data_length),
+                      MP_OBJ_NEW_SMALL_INT(link.data_length));
+    mp_obj_dict_store(dict,
+                      MP_OBJ_NEW_QSTR(MP_QSTR_phy),
+                      MP_OBJ_NEW_SMALL_INT(link.phy));
+    mp_obj_dict_store(dict,
+                      MP_OBJ_NEW_QSTR(MP_QSTR_interval_us),
+                      mp_obj_new_int(link.interval_us));
+
+    return dict;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(host_link_obj, host_link);
+
+STATIC const mp_rom_map_elem_t host_module_globals_table[] = {
+
+    {MP_ROM_QSTR(MP_QSTR_ticks_us), MP_ROM_PTR(&host_ticks_us_obj)},
+    {MP_ROM_QSTR(MP_QSTR_cpu_us), MP_ROM_PTR(&host_cpu_us_obj)},
+    {MP_ROM_QSTR(MP_QSTR_counters), MP_ROM_PTR(&host_counters_obj)},
+    {MP_ROM_QSTR(MP_QSTR_reset_counters), MP_ROM_PTR(&host_reset_counters_obj)},
+    {MP_ROM_QSTR(MP_QSTR_flash_erase_counts), MP_ROM_PTR(&host_flash_erase_counts_obj)},
+    {MP_ROM_QSTR(MP_QSTR_link), MP_ROM_PTR(&host_link_obj)},
+    {MP_ROM_QSTR(MP_QSTR_bit_reverse), MP_ROM_PTR(&host_bit_reverse_obj)},
+};
+STATIC MP_DEFINE_CONST_DICT(host_module_globals, host_module_globals_table);
+
+const mp_obj_module_t host_module = {
+    .base = {&mp_type_module},
+    .globals = (mp_obj_dict_t *)&host_module_globals,
+};
+MP_REGISTER_MODULE(MP_QSTR__host, host_module);
@@ -0,0 +1,1016 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host versions of the nrfx drivers and GPIO HAL used by the firmware.
+ *        Transfers are handed to the simulated devices byte by byte, and take
+ *        as much virtual time as they would on the bus.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+#include "nrf_gpio.h"
+#include "nrfx_gpiote.h"
+#include "nrfx_rtc.h"
+#include "nrfx_saadc.h"
+#include "nrfx_spim.h"
+#include "nrfx_systick.h"
+#include "nrfx_timer.h"
+#include "nrfx_twim.h"
+
+// Setup time of an EasyDMA transfer, including the driver overhead
+#define DMA_SETUP_US 3
+
+// Every pin idles high, either through a pull up, or by being driven high
+static uint32_t gpio_levels = 0xFFFFFFFF;
+
+static uint32_t gpio_outputs = 0;
+
+static struct gpiote_pin_t
+{
+    bool initialised;
+    bool enabled;
+    nrf_gpiote_polarity_t polarity;
+    nrfx_gpiote_evt_handler_t handler;
+    bool triggered;
+} gpiote_pins[NUMBER_OF_PINS];
+
+static void gpiote_irq_handler(void);
+
+static host_irq_t gpiote_irq = {.handler = gpiote_irq_handler};
+
+static void gpio_set_level(uint8_t pin, bool level)
+{
+    bool old_level = (gpio_levels >> pin) & 1;
+
+    if (old_level == level)
+    {
+        return;
+    }
+
+    if (level)
+    {
+        gpio_levels |= 1UL << pin;
+    }
+    else
+    {
+        gpio_levels &= ~(1UL << pin);
+    }
+
+    // Chip selects are active low
+    const host_spi_device_t *device = host_spi_device_on_pin(pin);
+
+    if (device != NULL)
+    {
+        if (level)
+        {
+            device->deselect();
+        }
+        else
+        {
+            device->select();
+        }
+    }
+
+    host_devices_pin_changed(pin, level);
+
+    struct gpiote_pin_t *gpiote = &gpiote_pins[pin];
+
+    if (gpiote->initialised && gpiote->enabled)
+    {
+        if (gpiote->polarity == NRF_GPIOTE_POLARITY_TOGGLE ||
+            (gpiote->polarity == NRF_GPIOTE_POLARITY_HITOLO && !level) ||
+            (gpiote->polarity == NRF_GPIOTE_POLARITY_LOTOHI && level))
+        {
+            gpiote->triggered = true;
+            host_irq_trigger(&gpiote_irq);
+        }
+    }
+}
+
+bool host_gpio_level(uint8_t pin)
+{
+    return (gpio_levels >> pin) & 1;
+}
+
+void host_gpio_drive_input(uint8_t pin, bool level)
+{
+    // Open drain pins can still be pulled low by a device
+    if ((gpio_outputs >> pin) & 1)
+    {
+        return;
+    }
+
+    gpio_set_level(pin, level);
+}
+
+void nrf_gpio_cfg(uint32_t pin_number,
+                  nrf_gpio_pin_dir_t dir,
+                  nrf_gpio_pin_input_t input,
+                  nrf_gpio_pin_pull_t pull,
+                  nrf_gpio_pin_drive_t drive,
+                  nrf_gpio_pin_sense_t sense)
+{
+    (void)input;
+    (void)drive;
+    (void)sense;
+
+    if (dir == NRF_GPIO_PIN_DIR_OUTPUT)
+    {
+        gpio_outputs |= 1UL << pin_number;
+        return;
+    }
+
+    gpio_outputs &= ~(1UL << pin_number);
+
+    if (pull == NRF_GPIO_PIN_PULLUP)
+    {
+        gpio_set_level(pin_number, true);
+    }
+}
+
+void nrf_gpio_cfg_output(uint32_t pin_number)
+{
+    nrf_gpio_cfg(pin_number,
+                 NRF_GPIO_PIN_DIR_OUTPUT,
+                 NRF_GPIO_PIN_INPUT_DISCONNECT,
+                 NRF_GPIO_PIN_NOPULL,
+                 NRF_GPIO_PIN_S0S1,
+                 NRF_GPIO_PIN_NOSENSE);
+}
+
+void nrf_gpio_cfg_default(uint32_t pin_number)
+{
+    nrf_gpio_cfg(pin_number,
+                 NRF_GPIO_PIN_DIR_INPUT,
+                 NRF_GPIO_PIN_INPUT_DISCONNECT,
+                 NRF_GPIO_PIN_NOPULL,
+                 NRF_GPIO_PIN_S0S1,
+                 NRF_GPIO_PIN_NOSENSE);
+}
+
+void nrf_gpio_cfg_sense_input(uint32_t pin_number,
+                              nrf_gpio_pin_pull_t pull_config,
+                              nrf_gpio_pin_sense_t sense_config)
+{
+    nrf_gpio_cfg(pin_number,
+                 NRF_GPIO_PIN_DIR_INPUT,
+                 NRF_GPIO_PIN_INPUT_CONNECT,
+                 pull_config,
+                 NRF_GPIO_PIN_S0S1,
+                 sense_config);
+}
+
+void nrf_gpio_pin_write(uint32_t pin_number, uint32_t value)
+{
+    gpio_set_level(pin_number, value != 0);
+}
+
+uint32_t nrf_gpio_pin_read(uint32_t pin_number)
+{
+    return host_gpio_level(pin_number);
+}
+
+static void gpiote_irq_handler(void)
+{
+    for (uint8_t pin = 0; pin < NUMBER_OF_PINS; pin++)
+    {
+        struct gpiote_pin_t *gpiote = &gpiote_pins[pin];
+
+        if (gpiote->triggered)
+        {
+            gpiote->triggered = false;
+            gpiote->handler(pin, gpiote->polarity);
+        }
+    }
+}
+
+nrfx_err_t nrfx_gpiote_init(uint8_t interrupt_priority)
+{
+    (void)interrupt_priority;
+
+    host_irq_enable(&gpiote_irq, true);
+
+    return NRFX_SUCCESS;
+}
+
+nrfx_err_t nrfx_gpiote_in_init(nrfx_gpiote_pin_t pin,
+                               nrfx_gpiote_in_config_t const *p_config,
+                               nrfx_gpiote_evt_handler_t evt_handler)
+{
+    if (gpiote_pins[pin].initialised)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    gpiote_pins[pin].initialised = true;
+    gpiote_pins[pin].polarity = p_config->sense;
+    gpiote_pins[pin].handler = evt_handler;
+
+    if (!p_config->skip_gpio_setup)
+    {
+        nrf_gpio_cfg_sense_input(pin, p_config->pull, NRF_GPIO_PIN_NOSENSE);
+    }
+
+    return NRFX_SUCCESS;
+}
+
+void nrfx_gpiote_in_event_enable(nrfx_gpiote_pin_t pin, bool int_enable)
+{
+    gpiote_pins[pin].enabled = int_enable;
+}
+
+void nrfx_gpiote_in_event_disable(nrfx_gpiote_pin_t pin)
+{
+    gpiote_pins[pin].enabled = false;
+}
+
+NRF_SPIM_Type host_spim_registers[3];
+
+static struct spim_instance_t
+{
+    bool initialised;
+    bool busy;
+    nrfx_spim_config_t config;
+    nrfx_spim_evt_handler_t handler;
+    void *context;
+    nrfx_spim_xfer_desc_t xfer_desc;
+    host_timer_t end_timer;
+    host_irq_t irq;
+} spim_instances[3];
+
+static void spim_end(struct spim_instance_t *spim)
+{
+    host_irq_trigger(&spim->irq);
+}
+
+static void spim_irq(struct spim_instance_t *spim)
+{
+    spim->busy = false;
+
+    nrfx_spim_evt_t event = {
+        .type = NRFX_SPIM_EVENT_DONE,
+        .xfer_desc = spim->xfer_desc,
+    };
+
+    spim->handler(&event, spim->context);
+}
+
+#define SPIM_CALLBACKS(n)             \
+    static void spim##n##_end(void)   \
+    {                                 \
+        spim_end(&spim_instances[n]); \
+    }                                 \
+    static void spim##n##_irq(void)   \
+    {                                 \
+        spim_irq(&spim_instances[n]); \
+    }
+
+SPIM_CALLBACKS(0)
+SPIM_CALLBACKS(1)
+SPIM_CALLBACKS(2)
+
+nrfx_err_t nrfx_spim_init(nrfx_spim_t const *p_instance,
+                          nrfx_spim_config_t const *p_config,
+                          nrfx_spim_evt_handler_t handler,
+                          void *p_context)
+{
+    static void (*const ends[])(void) = {spim0_end, spim1_end, spim2_end};
+    static void (*const irqs[])(void) = {spim0_irq, spim1_irq, spim2_irq};
+
+    struct spim_instance_t *spim = &spim_instances[p_instance->instance_id];
+
+    if (spim->initialised)
+    {
+        return NRFX_ERROR_ALREADY_INITIALIZED;
+    }
+
+    spim->initialised = true;
+    spim->busy = false;
+    spim->config = *p_config;
+    host_spim_registers[p_instance->instance_id].FREQUENCY = p_config->frequency;
+
+    // With a handler, transfers complete in the background and raise DONE
+    spim->handler = handler;
+    spim->context = p_context;
+    spim->end_timer.handler = ends[p_instance->instance_id];
+    spim->irq.handler = irqs[p_instance->instance_id];
+    spim->irq.pending = false;
+
+    host_irq_enable(&spim->irq, handler != NULL);
+
+    return NRFX_SUCCESS;
+}
+
+void nrfx_spim_uninit(nrfx_spim_t const *p_instance)
+{
+    struct spim_instance_t *spim = &spim_instances[p_instance->instance_id];
+
+    host_timer_stop(&spim->end_timer);
+    host_irq_enable(&spim->irq, false);
+
+    spim->initialised = false;
+}
+
+static uint8_t bit_reverse(uint8_t byte)
+{
+    byte = (byte & 0xF0) >> 4 | (byte & 0x0F) << 4;
+    byte = (byte & 0xCC) >> 2 | (byte & 0x33) << 2;
+    byte = (byte & 0xAA) >> 1 | (byte & 0x55) << 1;
+    return byte;
+}
+
+static uint32_t spim_frequency_hz(nrf_spim_frequency_t frequency)
+{
+    return (uint32_t)(((uint64_t)frequency * 125000) / NRF_SPIM_FREQ_125K);
+}
+
+nrfx_err_t nrfx_spim_xfer(nrfx_spim_t const *p_instance,
+                          nrfx_spim_xfer_desc_t const *p_xfer_desc,
+                          uint32_t flags)
+{
+    struct spim_instance_t *spim = &spim_instances[p_instance->instance_id];
+
+    if (!spim->initialised)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    if (spim->busy)
+    {
+        return NRFX_ERROR_BUSY;
+    }
+
+    if (flags & ~NRFX_SPIM_FLAG_NO_XFER_EVT_HANDLER)
+    {
+        return NRFX_ERROR_NOT_SUPPORTED;
+    }
+
+    // EasyDMA MAXCNT is 8 bits on the nRF52832
+    if (p_xfer_desc->tx_length > 255 || p_xfer_desc->rx_length > 255)
+    {
+        return NRFX_ERROR_INVALID_LENGTH;
+    }
+
+    // EasyDMA can't read from flash
+    if (p_xfer_desc->tx_length > 0 &&
+        !nrfx_is_in_ram(p_xfer_desc->p_tx_buffer))
+    {
+        return NRFX_ERROR_INVALID_ADDR;
+    }
+
+    // Find whichever device is selected. Unselected devices leave MISO high
+    const host_spi_device_t *device = NULL;
+
+    for (uint8_t pin = 0; pin < NUMBER_OF_PINS; pin++)
+    {
+        const host_spi_device_t *candidate = host_spi_device_on_pin(pin);
+
+        if (candidate != NULL && !host_gpio_level(pin))
+        {
+            device = candidate;
+            break;
+        }
+    }
+
+    bool lsb_first = spim->config.bit_order == NRF_SPIM_BIT_ORDER_LSB_FIRST;
+
+    size_t length = NRFX_MAX(p_xfer_desc->tx_length, p_xfer_desc->rx_length);
+
+    spim->busy = true;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t mosi = i < p_xfer_desc->tx_length
+                           ? p_xfer_desc->p_tx_buffer[i]
+                           : spim->config.orc;
+        uint8_t miso = 0xFF;
+
+        if (device != NULL)
+        {
+            bool reverse = lsb_first == device->msb_first;
+            miso = device->exchange(reverse ? bit_reverse(mosi) : mosi);
+            miso = reverse ? bit_reverse(miso) : miso;
+        }
+
+        if (i < p_xfer_desc->rx_length)
+        {
+            p_xfer_desc->p_rx_buffer[i] = miso;
+        }
+    }
+
+    host_counters.spi_transfers++;
+    host_counters.spi_bytes += length;
+
+    uint32_t frequency = spim_frequency_hz(
+        host_spim_registers[p_instance->instance_id].FREQUENCY);
+    uint64_t duration_us = DMA_SETUP_US +
+                           ((uint64_t)length * 8 * 1000000 + frequency - 1) /
+                               frequency;
+
+    // The bytes are exchanged up front, but the CPU only hears about it once
+    // the transfer would have finished on the wire
+    if (spim->handler != NULL &&
+        !(flags & NRFX_SPIM_FLAG_NO_XFER_EVT_HANDLER))
+    {
+        spim->xfer_desc = *p_xfer_desc;
+        host_timer_start(&spim->end_timer, host_time_us() + duration_us);
+        return NRFX_SUCCESS;
+    }
+
+    host_advance_us(duration_us);
+
+    spim->busy = false;
+
+    return NRFX_SUCCESS;
+}
+
+static struct twim_instance_t
+{
+    bool initialised;
+    bool enabled;
+    bool busy;
+    nrfx_twim_config_t config;
+    uint16_t register_pointers[128];
+} twim_instances[2];
+
+nrfx_err_t nrfx_twim_init(nrfx_twim_t const *p_instance,
+                          nrfx_twim_config_t const *p_config,
+                          nrfx_twim_evt_handler_t event_handler,
+                          void *p_context)
+{
+    (void)p_context;
+
+    struct twim_instance_t *twim = &twim_instances[p_instance->instance_id];
+
+    if (twim->initialised)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    // Only blocking mode is simulated
+    if (event_handler != NULL)
+    {
+        return NRFX_ERROR_NOT_SUPPORTED;
+    }
+
+    twim->initialised = true;
+    twim->config = *p_config;
+
+    return NRFX_SUCCESS;
+}
+
+void nrfx_twim_enable(nrfx_twim_t const *p_instance)
+{
+    twim_instances[p_instance->instance_id].enabled = true;
+}
+
+void nrfx_twim_uninit(nrfx_twim_t const *p_instance)
+{
+    twim_instances[p_instance->instance_id].initialised = false;
+    twim_instances[p_instance->instance_id].enabled = false;
+}
+
+static uint32_t twim_frequency_hz(nrf_twim_frequency_t frequency)
+{
+    switch (frequency)
+    {
+    case NRF_TWIM_FREQ_100K:
+        return 100000;
+    case NRF_TWIM_FREQ_250K:
+        return 250000;
+    default:
+        return 400000;
+    }
+}
+
+// Clocks a start condition, the address byte and its acknowledge
+static bool twim_address(struct twim_instance_t *twim,
+                         const host_i2c_device_t *device,
+                         uint64_t *cycles)
+{
+    *cycles += 1 + 9;
+    host_counters.i2c_bytes++;
+
+    return device != NULL && (device->powered == NULL || device->powered());
+}
+
+static void twim_write(struct twim_instance_t *twim,
+                       const host_i2c_device_t *device,
+                       const uint8_t *data,
+                       size_t length,
+                       uint64_t *cycles)
+{
+    uint16_t *pointer = &twim->register_pointers[device->address];
+    size_t pointer_bytes = device->wide_register ? 2 : 1;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (i < pointer_bytes)
+        {
+            *pointer = i == 0 ? data[i] : (uint16_t)(*pointer << 8 | data[i]);
+        }
+        else
+        {
+            device->write((*pointer)++, data[i]);
+        }
+    }
+
+    *cycles += 9 * length;
+    host_counters.i2c_bytes += length;
+}
+
+static void twim_read(struct twim_instance_t *twim,
+                      const host_i2c_device_t *device,
+                      uint8_t *data,
+                      size_t length,
+                      uint64_t *cycles)
+{
+    uint16_t *pointer = &twim->register_pointers[device->address];
+
+    for (size_t i = 0; i < length; i++)
+    {
+        data[i] = device->read((*pointer)++);
+    }
+
+    *cycles += 9 * length;
+    host_counters.i2c_bytes += length;
+}
+
+nrfx_err_t nrfx_twim_xfer(nrfx_twim_t const *p_instance,
+                          nrfx_twim_xfer_desc_t const *p_xfer_desc,
+                          uint32_t flags)
+{
+    struct twim_instance_t *twim = &twim_instances[p_instance->instance_id];
+
+    if (!twim->enabled)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    if (twim->busy)
+    {
+        return NRFX_ERROR_BUSY;
+    }
+
+    if (flags != 0)
+    {
+        return NRFX_ERROR_NOT_SUPPORTED;
+    }
+
+    if (p_xfer_desc->primary_length > 255 ||
+        p_xfer_desc->secondary_length > 255)
+    {
+        return NRFX_ERROR_INVALID_LENGTH;
+    }
+
+    const host_i2c_device_t *device =
+        host_i2c_device_at(p_instance->instance_id, p_xfer_desc->address);
+
+    twim->busy = true;
+
+    nrfx_err_t err = NRFX_SUCCESS;
+    uint64_t cycles = 0;
+
+    if (!twim_address(twim, device, &cycles))
+    {
+        err = NRFX_ERROR_DRV_TWI_ERR_ANACK;
+    }
+    else
+    {
+        switch (p_xfer_desc->type)
+        {
+        case NRFX_TWIM_XFER_TX:
+            twim_write(twim, device, p_xfer_desc->p_primary_buf,
+                       p_xfer_desc->primary_length, &cycles);
+            break;
+
+        case NRFX_TWIM_XFER_RX:
+            twim_read(twim, device, p_xfer_desc->p_primary_buf,
+                      p_xfer_desc->primary_length, &cycles);
+            break;
+
+        case NRFX_TWIM_XFER_TXRX:
+            twim_write(twim, device, p_xfer_desc->p_primary_buf,
+                       p_xfer_desc->primary_length, &cycles);
+            twim_address(twim, device, &cycles);
+            twim_read(twim, device, p_xfer_desc->p_secondary_buf,
+                      p_xfer_desc->secondary_length, &cycles);
+            break;
+
+        case NRFX_TWIM_XFER_TXTX:
+            twim_write(twim, device, p_xfer_desc->p_primary_buf,
+                       p_xfer_desc->primary_length, &cycles);
+            twim_address(twim, device, &cycles);
+            twim_write(twim, device, p_xfer_desc->p_secondary_buf,
+                       p_xfer_desc->secondary_length, &cycles);
+            break;
+        }
+    }
+
+    // Stop condition
+    cycles += 1;
+
+    host_counters.i2c_transfers++;
+    host_counters.i2c_clock_cycles += cycles;
+
+    uint32_t frequency = twim_frequency_hz(twim->config.frequency);
+    uint64_t duration_us = DMA_SETUP_US +
+                           (cycles * 1000000 + frequency - 1) / frequency;
+
+    host_counters.i2c_bus_us += duration_us;
+    host_advance_us(duration_us);
+
+    twim->busy = false;
+
+    return err;
+}
+
+void nrfx_systick_init(void)
+{
+}
+
+void nrfx_systick_delay_us(uint32_t us)
+{
+    host_advance_us(us);
+}
+
+void nrfx_systick_delay_ms(uint32_t ms)
+{
+    host_advance_us((uint64_t)ms * 1000);
+}
+
+static struct rtc_instance_t
+{
+    bool initialised;
+    bool running;
+    uint16_t prescaler;
+    uint64_t start_us;
+    nrfx_rtc_handler_t handler;
+    host_timer_t tick_timer;
+    host_irq_t irq;
+} rtc_instances[3];
+
+// Cost of reading the counter across the peripheral bus
+#define RTC_COUNTER_READ_US 1
+
+static uint64_t rtc_tick_period_us(struct rtc_instance_t *rtc)
+{
+    return ((uint64_t)(rtc->prescaler + 1) * 1000000) / RTC_INPUT_FREQ;
+}
+
+static void rtc_tick(struct rtc_instance_t *rtc)
+{
+    if (!rtc->running)
+    {
+        return;
+    }
+
+    host_irq_trigger(&rtc->irq);
+
+    host_timer_start(&rtc->tick_timer,
+                     rtc->tick_timer.deadline_us + rtc_tick_period_us(rtc));
+}
+
+static void rtc0_tick(void)
+{
+    rtc_tick(&rtc_instances[0]);
+}
+
+static void rtc1_tick(void)
+{
+    rtc_tick(&rtc_instances[1]);
+}
+
+static void rtc2_tick(void)
+{
+    rtc_tick(&rtc_instances[2]);
+}
+
+static void rtc0_irq(void)
+{
+    rtc_instances[0].handler(NRFX_RTC_INT_TICK);
+}
+
+static void rtc1_irq(void)
+{
+    rtc_instances[1].handler(NRFX_RTC_INT_TICK);
+}
+
+static void rtc2_irq(void)
+{
+    rtc_instances[2].handler(NRFX_RTC_INT_TICK);
+}
+
+nrfx_err_t nrfx_rtc_init(nrfx_rtc_t const *p_instance,
+                         nrfx_rtc_config_t const *p_config,
+                         nrfx_rtc_handler_t handler)
+{
+    static void (*const ticks[])(void) = {rtc0_tick, rtc1_tick, rtc2_tick};
+    static void (*const irqs[])(void) = {rtc0_irq, rtc1_irq, rtc2_irq};
+
+    struct rtc_instance_t *rtc = &rtc_instances[p_instance->instance_id];
+
+    if (rtc->initialised)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    rtc->initialised = true;
+    rtc->prescaler = p_config->prescaler;
+    rtc->handler = handler;
+    rtc->tick_timer.handler = ticks[p_instance->instance_id];
+    rtc->irq.handler = irqs[p_instance->instance_id];
+
+    return NRFX_SUCCESS;
+}
+
+void nrfx_rtc_enable(nrfx_rtc_t const *p_instance)
+{
+    struct rtc_instance_t *rtc = &rtc_instances[p_instance->instance_id];
+
+    rtc->running = true;
+    rtc->start_us = host_time_us();
+}
+
+void nrfx_rtc_tick_enable(nrfx_rtc_t const *p_instance, bool enable_irq)
+{
+    struct rtc_instance_t *rtc = &rtc_instances[p_instance->instance_id];
+
+    host_irq_enable(&rtc->irq, enable_irq);
+
+    host_timer_start(&rtc->tick_timer,
+                     host_time_us() + rtc_tick_period_us(rtc));
+}
+
+uint32_t nrfx_rtc_counter_get(nrfx_rtc_t const *p_instance)
+{
+    struct rtc_instance_t *rtc = &rtc_instances[p_instance->instance_id];
+
+    // Busy loops polling the counter must still let time pass
+    host_advance_us(RTC_COUNTER_READ_US);
+
+    if (!rtc->running)
+    {
+        return 0;
+    }
+
+    uint64_t ticks = ((host_time_us() - rtc->start_us) * RTC_INPUT_FREQ) /
+                     ((uint64_t)(rtc->prescaler + 1) * 1000000);
+
+    // The counter is 24 bits wide
+    return (uint32_t)(ticks & 0xFFFFFF);
+}
+
+static struct timer_instance_t
+{
+    bool initialised;
+    bool enabled;
+    uint64_t enabled_us;
+    nrf_timer_frequency_t frequency;
+    uint32_t compare;
+    bool interrupt;
+    nrfx_timer_event_handler_t handler;
+    void *context;
+    host_timer_t compare_timer;
+    host_irq_t irq;
+} timer_instances[5];
+
+static uint64_t timer_period_us(struct timer_instance_t *timer)
+{
+    uint32_t frequency_hz = 16000000 >> timer->frequency;
+    return ((uint64_t)timer->compare * 1000000) / frequency_hz;
+}
+
+static void timer_compare(struct timer_instance_t *timer)
+{
+    if (!timer->enabled)
+    {
+        return;
+    }
+
+    if (timer->interrupt)
+    {
+        host_irq_trigger(&timer->irq);
+    }
+
+    // The compare clears the counter, so the timer is periodic
+    host_timer_start(&timer->compare_timer,
+                     timer->compare_timer.deadline_us + timer_period_us(timer));
+}
+
+#define TIMER_CALLBACKS(n)                                      \
+    static void timer##n##_compare(void)                        \
+    {                                                           \
+        timer_compare(&timer_instances[n]);                     \
+    }                                                           \
+    static void timer##n##_irq(void)                            \
+    {                                                           \
+        timer_instances[n].handler(NRF_TIMER_EVENT_COMPARE0,    \
+                                   timer_instances[n].context); \
+    }
+
+TIMER_CALLBACKS(0)
+TIMER_CALLBACKS(1)
+TIMER_CALLBACKS(2)
+TIMER_CALLBACKS(3)
+TIMER_CALLBACKS(4)
+
+nrfx_err_t nrfx_timer_init(nrfx_timer_t const *p_instance,
+                           nrfx_timer_config_t const *p_config,
+                           nrfx_timer_event_handler_t timer_event_handler)
+{
+    static void (*const compares[])(void) = {
+        timer0_compare, timer1_compare, timer2_compare,
+        timer3_compare, timer4_compare};
+    static void (*const irqs[])(void) = {
+        timer0_irq, timer1_irq, timer2_irq, timer3_irq, timer4_irq};
+
+    struct timer_instance_t *timer = &timer_instances[p_instance->instance_id];
+
+    if (timer->initialised)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    timer->initialised = true;
+    timer->frequency = p_config->frequency;
+    timer->handler = timer_event_handler;
+    timer->context = p_config->p_context;
+    timer->compare_timer.handler = compares[p_instance->instance_id];
+    timer->irq.handler = irqs[p_instance->instance_id];
+
+    host_irq_enable(&timer->irq, true);
+
+    return NRFX_SUCCESS;
+}
+
+void nrfx_timer_extended_compare(nrfx_timer_t const *p_instance,
+                                 nrf_timer_cc_channel_t cc_channel,
+                                 uint32_t cc_value,
+                                 nrf_timer_short_mask_t timer_short_mask,
+                                 bool enable_int)
+{
+    (void)cc_channel;
+    (void)timer_short_mask;
+
+    struct timer_instance_t *timer = &timer_instances[p_instance->instance_id];
+
+    timer->compare = cc_value;
+    timer->interrupt = enable_int;
+}
+
+void nrfx_timer_enable(nrfx_timer_t const *p_instance)
+{
+    struct timer_instance_t *timer = &timer_instances[p_instance->instance_id];
+
+    timer->enabled = true;
+    timer->enabled_us = host_time_us();
+
+    // Without a compare value, the timer only counts
+    if (timer->compare != 0)
+    {
+        host_timer_start(&timer->compare_timer,
+                         host_time_us() + timer_period_us(timer));
+    }
+}
+
+uint32_t nrfx_timer_capture(nrfx_timer_t const *p_instance,
+                            nrf_timer_cc_channel_t cc_channel)
+{
+    (void)cc_channel;
+
+    struct timer_instance_t *timer = &timer_instances[p_instance->instance_id];
+
+    if (!timer->enabled)
+    {
+        return 0;
+    }
+
+    uint32_t frequency_hz = 16000000 >> timer->frequency;
+    uint64_t ticks = ((host_time_us() - timer->enabled_us) * frequency_hz) /
+                     1000000;
+
+    return (uint32_t)ticks;
+}
+
+void nrfx_timer_disable(nrfx_timer_t const *p_instance)
+{
+    struct timer_instance_t *timer = &timer_instances[p_instance->instance_id];
+
+    timer->enabled = false;
+
+    host_timer_stop(&timer->compare_timer);
+}
+
+void nrfx_timer_uninit(nrfx_timer_t const *p_instance)
+{
+    struct timer_instance_t *timer = &timer_instances[p_instance->instance_id];
+
+    nrfx_timer_disable(p_instance);
+    host_irq_enable(&timer->irq, false);
+
+    timer->initialised = false;
+    timer->compare = 0;
+    timer->interrupt = false;
+}
+
+static struct saadc_t
+{
+    bool initialised;
+    bool channel_configured;
+    nrf_saadc_value_t *buffer;
+    uint16_t buffer_size;
+} saadc;
+
+// Acquisition plus conversion time of a single sample
+#define SAADC_CONVERSION_US 43
+
+nrfx_err_t nrfx_saadc_init(uint8_t interrupt_priority)
+{
+    (void)interrupt_priority;
+
+    if (saadc.initialised)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    saadc.initialised = true;
+
+    return NRFX_SUCCESS;
+}
+
+nrfx_err_t nrfx_saadc_channel_config(nrfx_saadc_channel_t const *p_channel)
+{
+    (void)p_channel;
+
+    saadc.channel_configured = true;
+
+    return NRFX_SUCCESS;
+}
+
+nrfx_err_t nrfx_saadc_simple_mode_set(uint32_t channel_mask,
+                                      nrf_saadc_resolution_t resolution,
+                                      nrf_saadc_oversample_t oversampling,
+                                      nrfx_saadc_event_handler_t event_handler)
+{
+    (void)channel_mask;
+    (void)resolution;
+    (void)oversampling;
+
+    // Only blocking mode is simulated
+    if (event_handler != NULL)
+    {
+        return NRFX_ERROR_NOT_SUPPORTED;
+    }
+
+    return saadc.channel_configured ? NRFX_SUCCESS : NRFX_ERROR_INVALID_STATE;
+}
+
+nrfx_err_t nrfx_saadc_buffer_set(nrf_saadc_value_t *p_buffer, uint16_t size)
+{
+    saadc.buffer = p_buffer;
+    saadc.buffer_size = size;
+
+    return NRFX_SUCCESS;
+}
+
+nrfx_err_t nrfx_saadc_mode_trigger(void)
+{
+    if (saadc.buffer == NULL)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    for (uint16_t i = 0; i < saadc.buffer_size; i++)
+    {
+        saadc.buffer[i] = (nrf_saadc_value_t)host_devices_battery_adc();
+        host_advance_us(SAADC_CONVERSION_US);
+    }
+
+    saadc.buffer = NULL;
+
+    return NRFX_SUCCESS;
+}
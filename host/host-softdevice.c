@@ -0,0 +1,1734 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Model of the S132 SoftDevice, with a single central on the other end
+ *        of the link. The link layer is simulated one connection event at a
+ *        time, using the packet timings of the Bluetooth 5 specification, so
+ *        that the throughput seen by the firmware follows the negotiated MTU,
+ *        data length, PHY and connection interval.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "ble.h"
+#include "nrf_nvic.h"
+#include "nrf_sdm.h"
+#include "nrf_soc.h"
+#include "nrfx_log.h"
+
+#define EVENT_QUEUE_LENGTH 32
+#define EVENT_BUFFER_SIZE (sizeof(ble_evt_t) + BLE_GATTS_VAR_ATTR_LEN_MAX)
+
+// Handles taken by the built in GAP and GATT services
+#define FIRST_USER_HANDLE 0x000C
+#define MAX_ATTRIBUTES 64
+#define MAX_CHARACTERISTICS 16
+
+// Attribute table use. Values kept by the stack take their max_len rounded up
+#define ATTR_TAB_BUILTIN_SIZE 248
+#define ATTR_TAB_PER_ATTRIBUTE 12
+
+// Write events which the link layer buffers before it stops acknowledging
+#define RX_BUFFERS 8
+
+// Radio timings from the Bluetooth Core specification, Vol 6, Part B
+#define T_IFS_US 150
+#define DEFAULT_DATA_LENGTH 27
+#define MAX_DATA_LENGTH 251
+#define L2CAP_HEADER_LENGTH 4
+#define ATT_WRITE_HEADER_LENGTH 3
+#define ATT_NOTIFICATION_HEADER_LENGTH 3
+
+// Delays of the connection setup and of the link layer procedure instants
+#define CONNECTION_DELAY_US 30000
+#define INSTANT_EVENTS 6
+#define PROCEDURE_TIMEOUT_EVENTS 100
+
+/**
+ * @brief RAM needed by the SoftDevice, calibrated against S132 7.3.0 which
+ *        needed 0x2D88 bytes with an MTU of 256, two queued notifications and
+ *        a 1460 byte attribute table.
+ */
+
+#define RAM_BASE 0x20000000
+#define RAM_FIXED_SIZE 0x1F9C
+#define RAM_PER_CONNECTION 1024
+#define RAM_PER_VS_UUID 16
+#define RAM_PER_QUEUED_NOTIFICATION_OVERHEAD 12
+
+extern void SWI2_IRQHandler(void);
+
+static host_irq_t sd_evt_irq = {.handler = SWI2_IRQHandler};
+
+static struct config_t
+{
+    uint8_t conn_count;
+    uint16_t event_length;
+    uint16_t att_mtu;
+    uint8_t hvn_tx_queue_size;
+    uint8_t vs_uuid_count;
+    uint32_t attr_tab_size;
+    bool conn_evt_ext;
+} config = {
+    .conn_count = BLE_GAP_CONN_COUNT_DEFAULT,
+    .event_length = BLE_GAP_EVENT_LENGTH_DEFAULT,
+    .att_mtu = BLE_GATT_ATT_MTU_DEFAULT,
+    .hvn_tx_queue_size = BLE_GATTS_HVN_TX_QUEUE_SIZE_DEFAULT,
+    .vs_uuid_count = BLE_UUID_VS_COUNT_DEFAULT,
+    .attr_tab_size = BLE_GATTS_ATTR_TAB_SIZE_DEFAULT,
+    .conn_evt_ext = false,
+};
+
+static bool softdevice_enabled = false;
+
+static bool ble_enabled = false;
+
+static ble_gap_conn_params_t ppcp;
+
+static union event_slot_t
+{
+    ble_evt_t evt;
+    uint8_t bytes[EVENT_BUFFER_SIZE];
+} events[EVENT_QUEUE_LENGTH];
+
+static size_t event_head = 0;
+
+static size_t event_count = 0;
+
+static size_t pending_write_events = 0;
+
+static ble_uuid128_t vs_uuids[BLE_UUID_VS_COUNT_MAX];
+
+static uint8_t vs_uuid_used = 0;
+
+typedef struct attribute_t
+{
+    ble_uuid_t uuid;
+    bool cccd;
+    uint16_t max_len;
+    uint16_t len;
+    uint8_t value[BLE_GATTS_VAR_ATTR_LEN_MAX];
+} attribute_t;
+
+static attribute_t attributes[MAX_ATTRIBUTES];
+
+static uint16_t attribute_count = 0;
+
+static uint32_t attr_tab_used = ATTR_TAB_BUILTIN_SIZE;
+
+typedef struct characteristic_t
+{
+    ble_uuid_t uuid;
+    uint16_t value_handle;
+    uint16_t cccd_handle;
+} characteristic_t;
+
+static characteristic_t characteristics[MAX_CHARACTERISTICS];
+
+static size_t characteristic_count = 0;
+
+typedef enum procedure_t
+{
+    PROCEDURE_EXCHANGE_MTU,
+    PROCEDURE_DATA_LENGTH,
+    PROCEDURE_PHY,
+    PROCEDURE_SUBSCRIBE,
+    PROCEDURE_DONE,
+} procedure_t;
+
+typedef struct notification_t
+{
+    uint16_t handle;
+    uint16_t len;
+    uint8_t data[BLE_GATTS_VAR_ATTR_LEN_MAX];
+} notification_t;
+
+static struct connection_t
+{
+    bool advertising;
+    bool connected;
+    bool sys_attr_set;
+    uint16_t att_mtu;
+    uint16_t data_length;
+    uint8_t phy;
+    uint32_t interval_us;
+    procedure_t procedure;
+    bool procedure_waiting;
+    uint32_t procedure_events;
+    uint32_t pending_interval_us;
+    uint32_t pending_interval_events;
+    uint8_t pending_phy;
+    uint32_t pending_phy_events;
+    notification_t *hvn_queue;
+    size_t hvn_head;
+    size_t hvn_count;
+    size_t hvn_sent;
+    size_t write_received;
+} connection;
+
+static host_timer_t advertising_timer;
+
+static host_timer_t connection_timer;
+
+static uint32_t ram_required(void)
+{
+    uint32_t per_connection = RAM_PER_CONNECTION +
+                              2 * config.att_mtu +
+                              config.hvn_tx_queue_size *
+                                  (config.att_mtu +
+                                   RAM_PER_QUEUED_NOTIFICATION_OVERHEAD);
+
+    return RAM_FIXED_SIZE +
+           config.attr_tab_size +
+           config.vs_uuid_count * RAM_PER_VS_UUID +
+           config.conn_count * per_connection;
+}
+
+static uint32_t air_time_us(uint8_t phy, size_t payload)
+{
+    // Preamble, access address, header and CRC around the payload
+    if (phy == BLE_GAP_PHY_2MBPS)
+    {
+        return (11 + payload) * 4;
+    }
+
+    return (10 + payload) * 8;
+}
+
+static void push_event(const ble_evt_t *evt)
+{
+    if (event_count == EVENT_QUEUE_LENGTH)
+    {
+        host_log("host: SoftDevice event queue overflow, dropping event %u\r\n",
+                 evt->header.evt_id);
+        return;
+    }
+
+    size_t tail = (event_head + event_count) % EVENT_QUEUE_LENGTH;
+    memcpy(events[tail].bytes, evt, evt->header.evt_len);
+    event_count++;
+
+    if (evt->header.evt_id == BLE_GATTS_EVT_WRITE)
+    {
+        pending_write_events++;
+    }
+
+    host_irq_trigger(&sd_evt_irq);
+}
+
+static void push_gap_event(uint16_t evt_id, ble_gap_evt_t *gap_evt)
+{
+    ble_evt_t evt = {
+        .header = {.evt_id = evt_id, .evt_len = sizeof(ble_evt_t)},
+    };
+
+    gap_evt->conn_handle = 0;
+    evt.evt.gap_evt = *gap_evt;
+    push_event(&evt);
+}
+
+static void push_gatts_event(uint16_t evt_id, ble_gatts_evt_t *gatts_evt)
+{
+    ble_evt_t evt = {
+        .header = {.evt_id = evt_id, .evt_len = sizeof(ble_evt_t)},
+    };
+
+    gatts_evt->conn_handle = 0;
+    evt.evt.gatts_evt = *gatts_evt;
+    push_event(&evt);
+}
+
+static attribute_t *attribute(uint16_t handle)
+{
+    if (handle < FIRST_USER_HANDLE ||
+        handle >= FIRST_USER_HANDLE + attribute_count)
+    {
+        return NULL;
+    }
+
+    return &attributes[handle - FIRST_USER_HANDLE];
+}
+
+static uint16_t attribute_add(const ble_uuid_t *uuid,
+                              uint16_t max_len,
+                              uint16_t len,
+                              const uint8_t *value)
+{
+    if (attribute_count == MAX_ATTRIBUTES)
+    {
+        return BLE_GATT_HANDLE_INVALID;
+    }
+
+    attribute_t *attr = &attributes[attribute_count];
+    memset(attr, 0, sizeof(attribute_t));
+    attr->uuid = *uuid;
+    attr->max_len = max_len;
+    attr->len = len;
+
+    if (value != NULL)
+    {
+        memcpy(attr->value, value, len);
+    }
+
+    return FIRST_USER_HANDLE + attribute_count++;
+}
+
+static const characteristic_t *characteristic_of_value(uint16_t value_handle)
+{
+    for (size_t i = 0; i < characteristic_count; i++)
+    {
+        if (characteristics[i].value_handle == value_handle)
+        {
+            return &characteristics[i];
+        }
+    }
+
+    return NULL;
+}
+
+static const characteristic_t *characteristic_for_channel(
+    host_ble_channel_t channel,
+    uint16_t uuid)
+{
+    // The REPL service registers the first vendor UUID, and data the second
+    for (size_t i = 0; i < characteristic_count; i++)
+    {
+        if (characteristics[i].uuid.type ==
+                BLE_UUID_TYPE_VENDOR_BEGIN + channel &&
+            characteristics[i].uuid.uuid == uuid)
+        {
+            return &characteristics[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void clear_cccds(void)
+{
+    for (uint16_t i = 0; i < attribute_count; i++)
+    {
+        if (attributes[i].cccd)
+        {
+            memset(attributes[i].value, 0, attributes[i].len);
+        }
+    }
+}
+
+static void central_write(uint16_t handle, const uint8_t *data, uint16_t len)
+{
+    attribute_t *attr = attribute(handle);
+
+    // Write commands with a bad handle or length are dropped by the server
+    if (attr == NULL || len > attr->max_len)
+    {
+        host_log("host: central write to handle 0x%04X dropped\r\n", handle);
+        return;
+    }
+
+    memcpy(attr->value, data, len);
+    attr->len = len;
+
+    union
+    {
+        ble_evt_t evt;
+        uint8_t bytes[EVENT_BUFFER_SIZE];
+    } buffer;
+
+    memset(&buffer.evt, 0, sizeof(ble_evt_t));
+
+    size_t evt_len = offsetof(ble_evt_t, evt.gatts_evt.params.write.data) + len;
+    if (evt_len < sizeof(ble_evt_t))
+    {
+        evt_len = sizeof(ble_evt_t);
+    }
+
+    buffer.evt.header.evt_id = BLE_GATTS_EVT_WRITE;
+    buffer.evt.header.evt_len = evt_len;
+    buffer.evt.evt.gatts_evt.conn_handle = 0;
+    buffer.evt.evt.gatts_evt.params.write.handle = handle;
+    buffer.evt.evt.gatts_evt.params.write.uuid = attr->uuid;
+    buffer.evt.evt.gatts_evt.params.write.op = attr->cccd
+                                                   ? BLE_GATTS_OP_WRITE_REQ
+                                                   : BLE_GATTS_OP_WRITE_CMD;
+    buffer.evt.evt.gatts_evt.params.write.len = len;
+    memcpy(buffer.evt.evt.gatts_evt.params.write.data, data, len);
+
+    push_event(&buffer.evt);
+}
+
+static void start_procedure(void)
+{
+    switch (connection.procedure)
+    {
+    case PROCEDURE_EXCHANGE_MTU:
+    {
+        ble_gatts_evt_t gatts_evt = {0};
+        gatts_evt.params.exchange_mtu_request.client_rx_mtu =
+            host_options.central_mtu;
+        push_gatts_event(BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST, &gatts_evt);
+        break;
+    }
+
+    case PROCEDURE_DATA_LENGTH:
+    {
+        if (host_options.central_passive)
+        {
+            connection.procedure++;
+            start_procedure();
+            return;
+        }
+
+        uint16_t octets = host_options.central_data_length;
+
+        ble_gap_evt_t gap_evt = {0};
+        gap_evt.params.data_length_update_request.peer_params =
+            (ble_gap_data_length_params_t){
+                .max_tx_octets = octets,
+                .max_rx_octets = octets,
+                .max_tx_time_us = air_time_us(BLE_GAP_PHY_1MBPS, octets),
+                .max_rx_time_us = air_time_us(BLE_GAP_PHY_1MBPS, octets),
+            };
+        push_gap_event(BLE_GAP_EVT_DATA_LENGTH_UPDATE_REQUEST, &gap_evt);
+        break;
+    }
+
+    case PROCEDURE_PHY:
+    {
+        if (host_options.central_passive)
+        {
+            connection.procedure++;
+            start_procedure();
+            return;
+        }
+
+        // Like most phones, the central asks for 2M and accepts either
+        ble_gap_evt_t gap_evt = {0};
+        gap_evt.params.phy_update_request.peer_preferred_phys =
+            (ble_gap_phys_t){
+                .tx_phys = BLE_GAP_PHY_2MBPS | BLE_GAP_PHY_1MBPS,
+                .rx_phys = BLE_GAP_PHY_2MBPS | BLE_GAP_PHY_1MBPS,
+            };
+        push_gap_event(BLE_GAP_EVT_PHY_UPDATE_REQUEST, &gap_evt);
+        break;
+    }
+
+    case PROCEDURE_SUBSCRIBE:
+    {
+        if (!connection.sys_attr_set)
+        {
+            ble_gatts_evt_t gatts_evt = {0};
+            push_gatts_event(BLE_GATTS_EVT_SYS_ATTR_MISSING, &gatts_evt);
+            return;
+        }
+
+        const uint8_t enable_notifications[2] = {0x01, 0x00};
+
+        for (size_t i = 0; i < characteristic_count; i++)
+        {
+            if (characteristics[i].cccd_handle != BLE_GATT_HANDLE_INVALID)
+            {
+                central_write(characteristics[i].cccd_handle,
+                              enable_notifications,
+                              sizeof(enable_notifications));
+            }
+        }
+
+        connection.procedure = PROCEDURE_DONE;
+        host_central_connected();
+        return;
+    }
+
+    case PROCEDURE_DONE:
+        return;
+    }
+
+    connection.procedure_waiting = true;
+    connection.procedure_events = 0;
+}
+
+static void complete_procedure(procedure_t procedure)
+{
+    if (connection.procedure == procedure && connection.procedure_waiting)
+    {
+        connection.procedure_waiting = false;
+        connection.procedure++;
+    }
+}
+
+static void run_procedures(void)
+{
+    if (connection.pending_interval_events > 0 &&
+        --connection.pending_interval_events == 0)
+    {
+        connection.interval_us = connection.pending_interval_us;
+
+        uint16_t interval = connection.interval_us / 1250;
+
+        ble_gap_evt_t gap_evt = {0};
+        gap_evt.params.conn_param_update.conn_params = (ble_gap_conn_params_t){
+            .min_conn_interval = interval,
+            .max_conn_interval = interval,
+            .slave_latency = 0,
+            .conn_sup_timeout = ppcp.conn_sup_timeout,
+        };
+        push_gap_event(BLE_GAP_EVT_CONN_PARAM_UPDATE, &gap_evt);
+    }
+
+    if (connection.pending_phy_events > 0 &&
+        --connection.pending_phy_events == 0)
+    {
+        connection.phy = connection.pending_phy;
+
+        ble_gap_evt_t gap_evt = {0};
+        gap_evt.params.phy_update.status = BLE_HCI_STATUS_CODE_SUCCESS;
+        gap_evt.params.phy_update.tx_phy = connection.phy;
+        gap_evt.params.phy_update.rx_phy = connection.phy;
+        push_gap_event(BLE_GAP_EVT_PHY_UPDATE, &gap_evt);
+    }
+
+    if (connection.procedure_waiting)
+    {
+        // Don't hold up the other procedures if the firmware never replies
+        if (++connection.procedure_events < PROCEDURE_TIMEOUT_EVENTS)
+        {
+            return;
+        }
+
+        host_log("host: no reply to central procedure %u\r\n",
+                 connection.procedure);
+        connection.procedure_waiting = false;
+        connection.procedure++;
+    }
+
+    start_procedure();
+}
+
+static size_t central_pdu_length(void)
+{
+    host_ble_channel_t channel;
+    const uint8_t *data;
+    size_t length;
+
+    if (connection.procedure != PROCEDURE_DONE ||
+        pending_write_events >= RX_BUFFERS ||
+        !host_central_peek_write(&channel, &data, &length))
+    {
+        return 0;
+    }
+
+    return L2CAP_HEADER_LENGTH + ATT_WRITE_HEADER_LENGTH + length;
+}
+
+static void central_pdu_received(void)
+{
+    host_ble_channel_t channel;
+    const uint8_t *data;
+    size_t length;
+
+    host_central_peek_write(&channel, &data, &length);
+
+    const characteristic_t *rx = characteristic_for_channel(channel, 0x0002);
+
+    if (rx != NULL)
+    {
+        central_write(rx->value_handle, data, length);
+        host_counters.ble_writes++;
+        host_counters.ble_write_bytes += length;
+    }
+
+    host_central_pop_write();
+}
+
+static size_t peripheral_pdu_length(void)
+{
+    if (connection.hvn_count == 0)
+    {
+        return 0;
+    }
+
+    return L2CAP_HEADER_LENGTH + ATT_NOTIFICATION_HEADER_LENGTH +
+           connection.hvn_queue[connection.hvn_head].len;
+}
+
+static void peripheral_pdu_sent(void)
+{
+    notification_t *notification = &connection.hvn_queue[connection.hvn_head];
+    const characteristic_t *characteristic =
+        characteristic_of_value(notification->handle);
+
+    host_counters.ble_notifications++;
+    host_counters.ble_notification_bytes += notification->len;
+
+    if (characteristic != NULL &&
+        characteristic->uuid.type >= BLE_UUID_TYPE_VENDOR_BEGIN)
+    {
+        host_ble_channel_t channel =
+            characteristic->uuid.type - BLE_UUID_TYPE_VENDOR_BEGIN;
+
+        // The REPL input credit has a characteristic of its own
+        if (channel == HOST_BLE_REPL && characteristic->uuid.uuid == 0x0004)
+        {
+            channel = HOST_BLE_REPL_CREDIT;
+        }
+
+        host_central_notification(channel,
+                                  notification->data,
+                                  notification->len);
+    }
+
+    connection.hvn_head = (connection.hvn_head + 1) % config.hvn_tx_queue_size;
+    connection.hvn_count--;
+}
+
+static void exchange_packets(void)
+{
+    uint32_t budget_us = connection.interval_us - T_IFS_US;
+
+    if (!config.conn_evt_ext && budget_us > config.event_length * 1250u)
+    {
+        budget_us = config.event_length * 1250u;
+    }
+
+    uint32_t used_us = 0;
+    uint32_t packets = 0;
+    uint8_t completed = 0;
+
+    while (connection.connected)
+    {
+        // Each exchange is one packet from the central and one reply
+        size_t central_total = central_pdu_length();
+        size_t peripheral_total = peripheral_pdu_length();
+
+        size_t central_fragment = central_total - connection.write_received;
+        if (central_total == 0)
+        {
+            central_fragment = 0;
+        }
+        if (central_fragment > connection.data_length)
+        {
+            central_fragment = connection.data_length;
+        }
+
+        size_t peripheral_fragment = peripheral_total - connection.hvn_sent;
+        if (peripheral_total == 0)
+        {
+            peripheral_fragment = 0;
+        }
+        if (peripheral_fragment > connection.data_length)
+        {
+            peripheral_fragment = connection.data_length;
+        }
+
+        // The first exchange of an event happens even when there's no data
+        if (packets > 0 && central_fragment == 0 && peripheral_fragment == 0)
+        {
+            break;
+        }
+
+        uint32_t cost_us = air_time_us(connection.phy, central_fragment) +
+                           T_IFS_US +
+                           air_time_us(connection.phy, peripheral_fragment) +
+                           T_IFS_US;
+
+        if (packets > 0 && used_us + cost_us > budget_us)
+        {
+            break;
+        }
+
+        if (host_options.packets_per_event > 0 &&
+            packets == host_options.packets_per_event)
+        {
+            break;
+        }
+
+        used_us += cost_us;
+        packets++;
+
+        if (central_fragment > 0)
+        {
+            connection.write_received += central_fragment;
+
+            if (connection.write_received == central_total)
+            {
+                connection.write_received = 0;
+                central_pdu_received();
+            }
+        }
+
+        if (peripheral_fragment > 0)
+        {
+            connection.hvn_sent += peripheral_fragment;
+
+            if (connection.hvn_sent == peripheral_total)
+            {
+                connection.hvn_sent = 0;
+                peripheral_pdu_sent();
+
+                if (completed < UINT8_MAX)
+                {
+                    completed++;
+                }
+            }
+        }
+    }
+
+    if (completed > 0)
+    {
+        ble_gatts_evt_t gatts_evt = {0};
+        gatts_evt.params.hvn_tx_complete.count = completed;
+        push_gatts_event(BLE_GATTS_EVT_HVN_TX_COMPLETE, &gatts_evt);
+    }
+}
+
+static void connection_event(void)
+{
+    uint64_t anchor_us = connection_timer.deadline_us;
+
+    host_counters.ble_connection_events++;
+
+    run_procedures();
+
+    if (connection.procedure == PROCEDURE_DONE)
+    {
+        host_central_connection_event();
+    }
+
+    exchange_packets();
+
+    if (connection.connected)
+    {
+        host_timer_start(&connection_timer, anchor_us + connection.interval_us);
+    }
+}
+
+static void connect(void)
+{
+    connection.advertising = false;
+    connection.connected = true;
+    connection.sys_attr_set = false;
+    connection.att_mtu = BLE_GATT_ATT_MTU_DEFAULT;
+    connection.data_length = DEFAULT_DATA_LENGTH;
+    connection.phy = BLE_GAP_PHY_1MBPS;
+    connection.interval_us = host_options.central_interval_us;
+    connection.procedure = PROCEDURE_EXCHANGE_MTU;
+    connection.procedure_waiting = false;
+    connection.pending_interval_events = 0;
+    connection.pending_phy_events = 0;
+    connection.hvn_head = 0;
+    connection.hvn_count = 0;
+    connection.hvn_sent = 0;
+    connection.write_received = 0;
+
+    clear_cccds();
+
+    uint16_t interval = connection.interval_us / 1250;
+
+    ble_gap_evt_t gap_evt = {0};
+    gap_evt.params.connected.role = BLE_GAP_ROLE_PERIPH;
+    gap_evt.params.connected.adv_handle = 0;
+    gap_evt.params.connected.peer_addr.addr_type =
+        BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+    memcpy(gap_evt.params.connected.peer_addr.addr,
+           (const uint8_t[]){0x01, 0x00, 0x00, 0x00, 0x00, 0xC0},
+           BLE_GAP_ADDR_LEN);
+    gap_evt.params.connected.conn_params = (ble_gap_conn_params_t){
+        .min_conn_interval = interval,
+        .max_conn_interval = interval,
+        .slave_latency = 0,
+        .conn_sup_timeout = 400,
+    };
+    push_gap_event(BLE_GAP_EVT_CONNECTED, &gap_evt);
+
+    connection_timer.handler = connection_event;
+    host_timer_start(&connection_timer,
+                     host_time_us() + connection.interval_us);
+}
+
+static void disconnect(uint8_t reason)
+{
+    connection.connected = false;
+    host_timer_stop(&connection_timer);
+
+    ble_gap_evt_t gap_evt = {0};
+    gap_evt.params.disconnected.reason = reason;
+    push_gap_event(BLE_GAP_EVT_DISCONNECTED, &gap_evt);
+
+    host_central_disconnected();
+}
+
+static bool valid_connection(uint16_t conn_handle)
+{
+    return conn_handle == 0 && connection.connected;
+}
+
+host_ble_link_t host_softdevice_link(void)
+{
+    return (host_ble_link_t){
+        .connected = connection.connected,
+        .att_mtu = connection.att_mtu,
+        .data_length = connection.data_length,
+        .phy = connection.phy,
+        .interval_us = connection.interval_us,
+    };
+}
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn)
+{
+    if (IRQn == SD_EVT_IRQn)
+    {
+        host_irq_enable(&sd_evt_irq, true);
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_DisableIRQ(IRQn_Type IRQn)
+{
+    if (IRQn == SD_EVT_IRQn)
+    {
+        host_irq_enable(&sd_evt_irq, false);
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_SetPendingIRQ(IRQn_Type IRQn)
+{
+    if (IRQn == SD_EVT_IRQn)
+    {
+        host_irq_trigger(&sd_evt_irq);
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    if (IRQn == SD_EVT_IRQn)
+    {
+        sd_evt_irq.pending = false;
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    (void)IRQn;
+    (void)priority;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_critical_region_enter(uint8_t *p_is_nested_critical_region)
+{
+    *p_is_nested_critical_region = (uint8_t)nrf_nvic_state.__cr_flag;
+    nrf_nvic_state.__cr_flag = 1;
+    host_irq_mask(true);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region)
+{
+    if (!is_nested_critical_region)
+    {
+        nrf_nvic_state.__cr_flag = 0;
+        host_irq_mask(false);
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_softdevice_enable(nrf_clock_lf_cfg_t const *p_clock_lf_cfg,
+                              nrf_fault_handler_t fault_handler)
+{
+    host_svc_call();
+
+    (void)p_clock_lf_cfg;
+    (void)fault_handler;
+
+    if (softdevice_enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    softdevice_enabled = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_softdevice_disable(void)
+{
+    host_svc_call();
+
+    host_timer_stop(&advertising_timer);
+    host_timer_stop(&connection_timer);
+
+    if (connection.connected)
+    {
+        connection.connected = false;
+        host_central_disconnected();
+    }
+
+    softdevice_enabled = false;
+    ble_enabled = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_app_evt_wait(void)
+{
+    host_svc_call();
+    host_wait_for_event();
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_evt_get(uint32_t *p_evt_id)
+{
+    host_svc_call();
+
+    // No flash operations or other SoC events are modeled
+    (void)p_evt_id;
+    return NRF_ERROR_NOT_FOUND;
+}
+
+uint32_t sd_power_gpregret_set(uint32_t gpregret_id, uint32_t gpregret_msk)
+{
+    host_svc_call();
+
+    if (gpregret_id != 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    NRF_POWER->GPREGRET |= gpregret_msk;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_power_gpregret_clr(uint32_t gpregret_id, uint32_t gpregret_msk)
+{
+    host_svc_call();
+
+    if (gpregret_id != 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    NRF_POWER->GPREGRET &= ~gpregret_msk;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_power_gpregret_get(uint32_t gpregret_id, uint32_t *p_gpregret)
+{
+    host_svc_call();
+
+    if (gpregret_id != 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    *p_gpregret = NRF_POWER->GPREGRET;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_cfg_set(uint32_t cfg_id,
+                        ble_cfg_t const *p_cfg,
+                        uint32_t app_ram_base)
+{
+    host_svc_call();
+
+    if (!softdevice_enabled || ble_enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    struct config_t previous = config;
+
+    switch (cfg_id)
+    {
+    case BLE_CONN_CFG_GAP:
+        config.conn_count = p_cfg->conn_cfg.params.gap_conn_cfg.conn_count;
+        config.event_length = p_cfg->conn_cfg.params.gap_conn_cfg.event_length;
+        break;
+
+    case BLE_CONN_CFG_GATT:
+        if (p_cfg->conn_cfg.params.gatt_conn_cfg.att_mtu <
+            BLE_GATT_ATT_MTU_DEFAULT)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        config.att_mtu = p_cfg->conn_cfg.params.gatt_conn_cfg.att_mtu;
+        break;
+
+    case BLE_CONN_CFG_GATTS:
+        if (p_cfg->conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size == 0)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        config.hvn_tx_queue_size =
+            p_cfg->conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size;
+        break;
+
+    case BLE_COMMON_CFG_VS_UUID:
+        if (p_cfg->common_cfg.vs_uuid_cfg.vs_uuid_count >
+            BLE_UUID_VS_COUNT_MAX)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        config.vs_uuid_count = p_cfg->common_cfg.vs_uuid_cfg.vs_uuid_count;
+        break;
+
+    case BLE_GATTS_CFG_ATTR_TAB_SIZE:
+        if (p_cfg->gatts_cfg.attr_tab_size.attr_tab_size % 4 != 0)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        config.attr_tab_size = p_cfg->gatts_cfg.attr_tab_size.attr_tab_size;
+        break;
+
+    case BLE_GAP_CFG_ROLE_COUNT:
+    case BLE_GATTS_CFG_SERVICE_CHANGED:
+        break;
+
+    default:
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+
+    if (app_ram_base < RAM_BASE + ram_required())
+    {
+        config = previous;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_enable(uint32_t *p_app_ram_base)
+{
+    host_svc_call();
+
+    if (!softdevice_enabled || ble_enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    uint32_t app_ram_base = *p_app_ram_base;
+    *p_app_ram_base = RAM_BASE + ram_required();
+
+    if (app_ram_base < *p_app_ram_base)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    free(connection.hvn_queue);
+    connection.hvn_queue = calloc(config.hvn_tx_queue_size,
+                                  sizeof(notification_t));
+
+    ble_enabled = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_opt_set(uint32_t opt_id, ble_opt_t const *p_opt)
+{
+    host_svc_call();
+
+    if (opt_id != BLE_COMMON_OPT_CONN_EVT_EXT)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+
+    config.conn_evt_ext = p_opt->common_opt.conn_evt_ext.enable;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_evt_get(uint8_t *p_dest, uint16_t *p_len)
+{
+    host_svc_call();
+
+    if (event_count == 0)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    ble_evt_t *evt = &events[event_head].evt;
+
+    if (p_dest == NULL || *p_len < evt->header.evt_len)
+    {
+        *p_len = evt->header.evt_len;
+        return p_dest == NULL ? NRF_SUCCESS : NRF_ERROR_DATA_SIZE;
+    }
+
+    memcpy(p_dest, evt, evt->header.evt_len);
+    *p_len = evt->header.evt_len;
+
+    if (evt->header.evt_id == BLE_GATTS_EVT_WRITE)
+    {
+        pending_write_events--;
+    }
+
+    event_head = (event_head + 1) % EVENT_QUEUE_LENGTH;
+    event_count--;
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const *p_vs_uuid,
+                            uint8_t *p_uuid_type)
+{
+    host_svc_call();
+
+    for (uint8_t i = 0; i < vs_uuid_used; i++)
+    {
+        // Octets 12 and 13 are where the 16-bit UUIDs go, so they don't count
+        if (memcmp(vs_uuids[i].uuid128, p_vs_uuid->uuid128, 12) == 0 &&
+            memcmp(&vs_uuids[i].uuid128[14], &p_vs_uuid->uuid128[14], 2) == 0)
+        {
+            *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + i;
+            return NRF_SUCCESS;
+        }
+    }
+
+    if (vs_uuid_used == config.vs_uuid_count)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    vs_uuids[vs_uuid_used] = *p_vs_uuid;
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + vs_uuid_used++;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_uuid_encode(ble_uuid_t const *p_uuid,
+                            uint8_t *p_uuid_le_len,
+                            uint8_t *p_uuid_le)
+{
+    host_svc_call();
+
+    if (p_uuid->type == BLE_UUID_TYPE_BLE)
+    {
+        *p_uuid_le_len = 2;
+        if (p_uuid_le != NULL)
+        {
+            p_uuid_le[0] = p_uuid->uuid & 0xFF;
+            p_uuid_le[1] = p_uuid->uuid >> 8;
+        }
+        return NRF_SUCCESS;
+    }
+
+    if (p_uuid->type < BLE_UUID_TYPE_VENDOR_BEGIN ||
+        p_uuid->type >= BLE_UUID_TYPE_VENDOR_BEGIN + vs_uuid_used)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    *p_uuid_le_len = 16;
+    if (p_uuid_le != NULL)
+    {
+        memcpy(p_uuid_le,
+               vs_uuids[p_uuid->type - BLE_UUID_TYPE_VENDOR_BEGIN].uuid128,
+               16);
+        p_uuid_le[12] = p_uuid->uuid & 0xFF;
+        p_uuid_le[13] = p_uuid->uuid >> 8;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_addr_get(ble_gap_addr_t *p_addr)
+{
+    host_svc_call();
+
+    p_addr->addr_id_peer = 0;
+    p_addr->addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+    memcpy(p_addr->addr,
+           (const uint8_t[]){0x4D, 0x4E, 0x43, 0x4C, 0x00, 0xC0},
+           BLE_GAP_ADDR_LEN);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const *p_write_perm,
+                                    uint8_t const *p_dev_name,
+                                    uint16_t len)
+{
+    host_svc_call();
+
+    (void)p_write_perm;
+    (void)p_dev_name;
+
+    if (len > BLE_GAP_DEVNAME_DEFAULT_LEN)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const *p_conn_params)
+{
+    host_svc_call();
+
+    ppcp = *p_conn_params;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_ppcp_get(ble_gap_conn_params_t *p_conn_params)
+{
+    host_svc_call();
+
+    *p_conn_params = ppcp;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_set_configure(uint8_t *p_adv_handle,
+                                      ble_gap_adv_data_t const *p_adv_data,
+                                      ble_gap_adv_params_t const *p_adv_params)
+{
+    host_svc_call();
+
+    (void)p_adv_params;
+
+    if (p_adv_data != NULL && p_adv_data->adv_data.len > BLE_GAP_ADV_SET_DATA_SIZE_MAX)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    if (*p_adv_handle == BLE_GAP_ADV_SET_HANDLE_NOT_SET)
+    {
+        *p_adv_handle = 0;
+    }
+    else if (*p_adv_handle != 0)
+    {
+        return BLE_ERROR_INVALID_ADV_HANDLE;
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_start(uint8_t adv_handle, uint8_t conn_cfg_tag)
+{
+    host_svc_call();
+
+    (void)conn_cfg_tag;
+
+    if (adv_handle != 0)
+    {
+        return BLE_ERROR_INVALID_ADV_HANDLE;
+    }
+
+    if (!ble_enabled || connection.advertising || connection.connected)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    // The central is always scanning, and connects to the first advertisement
+    connection.advertising = true;
+    advertising_timer.handler = connect;
+    host_timer_start(&advertising_timer, host_time_us() + CONNECTION_DELAY_US);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle,
+                                      ble_gap_conn_params_t const *p_conn_params)
+{
+    host_svc_call();
+
+    if (!valid_connection(conn_handle))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    if (connection.pending_interval_events > 0)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    if (p_conn_params == NULL)
+    {
+        p_conn_params = &ppcp;
+    }
+
+    if (p_conn_params->min_conn_interval < BLE_GAP_CP_MIN_CONN_INTVL_MIN ||
+        p_conn_params->min_conn_interval > p_conn_params->max_conn_interval ||
+        p_conn_params->max_conn_interval > BLE_GAP_CP_MAX_CONN_INTVL_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    // The central grants the fastest interval that both sides allow
+    uint32_t interval_us = p_conn_params->min_conn_interval * 1250;
+
+    if (interval_us < host_options.central_min_interval_us)
+    {
+        interval_us = host_options.central_min_interval_us;
+    }
+
+    if (interval_us > p_conn_params->max_conn_interval * 1250u)
+    {
+        interval_us = p_conn_params->max_conn_interval * 1250u;
+    }
+
+    connection.pending_interval_us = interval_us;
+    connection.pending_interval_events = INSTANT_EVENTS;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code)
+{
+    host_svc_call();
+
+    if (!valid_connection(conn_handle))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    if (hci_status_code != BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION &&
+        hci_status_code != BLE_HCI_CONN_INTERVAL_UNACCEPTABLE)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    disconnect(BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_phy_update(uint16_t conn_handle,
+                               ble_gap_phys_t const *p_gap_phys)
+{
+    host_svc_call();
+
+    if (!valid_connection(conn_handle))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    if (connection.pending_phy_events > 0)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    // BLE_GAP_PHY_AUTO leaves the choice to the SoftDevice, which takes 2M
+    uint8_t tx_phys = p_gap_phys->tx_phys == BLE_GAP_PHY_AUTO
+                          ? BLE_GAP_PHY_2MBPS | BLE_GAP_PHY_1MBPS
+                          : p_gap_phys->tx_phys;
+    uint8_t rx_phys = p_gap_phys->rx_phys == BLE_GAP_PHY_AUTO
+                          ? BLE_GAP_PHY_2MBPS | BLE_GAP_PHY_1MBPS
+                          : p_gap_phys->rx_phys;
+
+    if (tx_phys & rx_phys & BLE_GAP_PHY_2MBPS)
+    {
+        connection.pending_phy = BLE_GAP_PHY_2MBPS;
+    }
+    else
+    {
+        connection.pending_phy = BLE_GAP_PHY_1MBPS;
+    }
+
+    connection.pending_phy_events = INSTANT_EVENTS;
+    complete_procedure(PROCEDURE_PHY);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_data_length_update(
+    uint16_t conn_handle,
+    ble_gap_data_length_params_t const *p_dl_params,
+    ble_gap_data_length_limitation_t *p_dl_limitation)
+{
+    host_svc_call();
+
+    if (!valid_connection(conn_handle))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    // Longest packets for which an exchange still fits in the event length
+    uint32_t event_us = config.event_length * 1250;
+    uint16_t supported = MAX_DATA_LENGTH;
+    while (supported > DEFAULT_DATA_LENGTH &&
+           2 * (air_time_us(BLE_GAP_PHY_1MBPS, supported) + T_IFS_US) >
+               event_us)
+    {
+        supported--;
+    }
+
+    uint16_t requested = supported;
+
+    if (p_dl_params != NULL && p_dl_params->max_tx_octets != BLE_GAP_DATA_LENGTH_AUTO)
+    {
+        requested = p_dl_params->max_tx_octets;
+
+        if (requested > supported)
+        {
+            if (p_dl_limitation != NULL)
+            {
+                memset(p_dl_limitation, 0, sizeof(*p_dl_limitation));
+                p_dl_limitation->tx_payload_limited_octets =
+                    requested - supported;
+            }
+            return NRF_ERROR_NOT_SUPPORTED;
+        }
+    }
+
+    uint16_t effective = requested;
+    if (effective > host_options.central_data_length)
+    {
+        effective = host_options.central_data_length;
+    }
+
+    connection.data_length = effective;
+
+    ble_gap_evt_t gap_evt = {0};
+    gap_evt.params.data_length_update.effective_params =
+        (ble_gap_data_length_params_t){
+            .max_tx_octets = effective,
+            .max_rx_octets = effective,
+            .max_tx_time_us = air_time_us(BLE_GAP_PHY_1MBPS, effective),
+            .max_rx_time_us = air_time_us(BLE_GAP_PHY_1MBPS, effective),
+        };
+    push_gap_event(BLE_GAP_EVT_DATA_LENGTH_UPDATE, &gap_evt);
+
+    complete_procedure(PROCEDURE_DATA_LENGTH);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_sec_params_reply(uint16_t conn_handle,
+                                     uint8_t sec_status,
+                                     ble_gap_sec_params_t const *p_sec_params,
+                                     ble_gap_sec_keyset_t const *p_sec_keyset)
+{
+    host_svc_call();
+
+    (void)sec_status;
+    (void)p_sec_params;
+    (void)p_sec_keyset;
+
+    if (!valid_connection(conn_handle))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_service_add(uint8_t type,
+                                  ble_uuid_t const *p_uuid,
+                                  uint16_t *p_handle)
+{
+    host_svc_call();
+
+    if (type != BLE_GATTS_SRVC_TYPE_PRIMARY &&
+        type != BLE_GATTS_SRVC_TYPE_SECONDARY)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (attr_tab_used + ATTR_TAB_PER_ATTRIBUTE > config.attr_tab_size)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    *p_handle = attribute_add(p_uuid, 0, 0, NULL);
+
+    if (*p_handle == BLE_GATT_HANDLE_INVALID)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    attr_tab_used += ATTR_TAB_PER_ATTRIBUTE;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_characteristic_add(
+    uint16_t service_handle,
+    ble_gatts_char_md_t const *p_char_md,
+    ble_gatts_attr_t const *p_attr_char_value,
+    ble_gatts_char_handles_t *p_handles)
+{
+    host_svc_call();
+
+    (void)service_handle;
+
+    if (p_attr_char_value->max_len > BLE_GATTS_VAR_ATTR_LEN_MAX ||
+        p_attr_char_value->init_len > p_attr_char_value->max_len)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    bool cccd = p_char_md->char_props.notify || p_char_md->char_props.indicate;
+
+    uint32_t attr_tab_needed = (cccd ? 3 : 2) * ATTR_TAB_PER_ATTRIBUTE +
+                               (cccd ? 4 : 0);
+
+    if (p_attr_char_value->p_attr_md->vloc == BLE_GATTS_VLOC_STACK)
+    {
+        attr_tab_needed += (p_attr_char_value->max_len + 3u) & ~3u;
+    }
+
+    if (characteristic_count == MAX_CHARACTERISTICS ||
+        attribute_count + 3 > MAX_ATTRIBUTES ||
+        attr_tab_used + attr_tab_needed > config.attr_tab_size)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    attr_tab_used += attr_tab_needed;
+
+    const ble_uuid_t declaration_uuid = {
+        .uuid = BLE_UUID_CHARACTERISTIC,
+        .type = BLE_UUID_TYPE_BLE,
+    };
+    attribute_add(&declaration_uuid, 0, 0, NULL);
+
+    memset(p_handles, 0, sizeof(ble_gatts_char_handles_t));
+    p_handles->value_handle = attribute_add(p_attr_char_value->p_uuid,
+                                            p_attr_char_value->max_len,
+                                            p_attr_char_value->init_len,
+                                            p_attr_char_value->p_value);
+
+    if (cccd)
+    {
+        const ble_uuid_t cccd_uuid = {
+            .uuid = BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG,
+            .type = BLE_UUID_TYPE_BLE,
+        };
+        const uint8_t cccd_value[2] = {0x00, 0x00};
+
+        p_handles->cccd_handle = attribute_add(&cccd_uuid, 2, 2, cccd_value);
+        attribute(p_handles->cccd_handle)->cccd = true;
+    }
+
+    characteristics[characteristic_count++] = (characteristic_t){
+        .uuid = *p_attr_char_value->p_uuid,
+        .value_handle = p_handles->value_handle,
+        .cccd_handle = p_handles->cccd_handle,
+    };
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle,
+                                   uint8_t const *p_sys_attr_data,
+                                   uint16_t len,
+                                   uint32_t flags)
+{
+    host_svc_call();
+
+    (void)flags;
+
+    if (!valid_connection(conn_handle))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    // Only the NULL case, which resets the CCCDs to zero, is modeled
+    if (p_sys_attr_data != NULL || len != 0)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+
+    clear_cccds();
+    connection.sys_attr_set = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_value_get(uint16_t conn_handle,
+                                uint16_t handle,
+                                ble_gatts_value_t *p_value)
+{
+    host_svc_call();
+
+    attribute_t *attr = attribute(handle);
+
+    if (attr == NULL)
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+
+    // CCCDs are stored per connection, so need a valid connection to read
+    if (attr->cccd)
+    {
+        if (!valid_connection(conn_handle))
+        {
+            return BLE_ERROR_INVALID_CONN_HANDLE;
+        }
+
+        if (!connection.sys_attr_set)
+        {
+            return BLE_ERROR_GATTS_SYS_ATTR_MISSING;
+        }
+    }
+
+    if (p_value->offset > attr->len)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    uint16_t available = attr->len - p_value->offset;
+
+    if (p_value->p_value != NULL)
+    {
+        if (p_value->len > available)
+        {
+            p_value->len = available;
+        }
+        memcpy(p_value->p_value, &attr->value[p_value->offset], p_value->len);
+    }
+    else
+    {
+        p_value->len = available;
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle,
+                                uint16_t handle,
+                                ble_gatts_value_t *p_value)
+{
+    host_svc_call();
+
+    (void)conn_handle;
+
+    attribute_t *attr = attribute(handle);
+
+    if (attr == NULL)
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+
+    if (p_value->offset > attr->len ||
+        p_value->offset + p_value->len > attr->max_len)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (p_value->p_value != NULL)
+    {
+        memcpy(&attr->value[p_value->offset], p_value->p_value, p_value->len);
+    }
+    attr->len = p_value->offset + p_value->len;
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle,
+                          ble_gatts_hvx_params_t const *p_hvx_params)
+{
+    host_svc_call();
+
+    if (!valid_connection(conn_handle))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    const characteristic_t *characteristic =
+        characteristic_of_value(p_hvx_params->handle);
+
+    if (characteristic == NULL)
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+
+    if (characteristic->cccd_handle == BLE_GATT_HANDLE_INVALID ||
+        p_hvx_params->type != BLE_GATT_HVX_NOTIFICATION)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (!connection.sys_attr_set)
+    {
+        return BLE_ERROR_GATTS_SYS_ATTR_MISSING;
+    }
+
+    if (connection.procedure == PROCEDURE_EXCHANGE_MTU &&
+        connection.procedure_waiting)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    attribute_t *value = attribute(characteristic->value_handle);
+    attribute_t *cccd = attribute(characteristic->cccd_handle);
+
+    if (!(cccd->value[0] & BLE_GATT_HVX_NOTIFICATION))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    uint16_t len = p_hvx_params->p_len != NULL ? *p_hvx_params->p_len
+                                                : value->len;
+
+    if (len > value->max_len || len > connection.att_mtu - 3)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    if (p_hvx_params->p_data != NULL)
+    {
+        memcpy(value->value, p_hvx_params->p_data, len);
+        value->len = len;
+    }
+
+    if (connection.hvn_count == config.hvn_tx_queue_size)
+    {
+        host_counters.ble_notification_retries++;
+        return NRF_ERROR_RESOURCES;
+    }
+
+    size_t tail = (connection.hvn_head + connection.hvn_count) %
+                  config.hvn_tx_queue_size;
+    connection.hvn_queue[tail].handle = p_hvx_params->handle;
+    connection.hvn_queue[tail].len = len;
+    memcpy(connection.hvn_queue[tail].data, value->value, len);
+    connection.hvn_count++;
+
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_exchange_mtu_reply(uint16_t conn_handle,
+                                         uint16_t server_rx_mtu)
+{
+    host_svc_call();
+
+    if (!valid_connection(conn_handle))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    if (connection.procedure != PROCEDURE_EXCHANGE_MTU ||
+        !connection.procedure_waiting)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (server_rx_mtu < BLE_GATT_ATT_MTU_DEFAULT ||
+        server_rx_mtu > config.att_mtu)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    connection.att_mtu = server_rx_mtu < host_options.central_mtu
+                             ? server_rx_mtu
+                             : host_options.central_mtu;
+
+    complete_procedure(PROCEDURE_EXCHANGE_MTU);
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,264 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Internal interfaces of the host simulator. Nothing in here is visible
+ *        to the firmware, which only ever sees the nrfx and SoftDevice APIs.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Command line options.
+ */
+
+typedef struct host_options_t
+{
+    const char *flash_image;
+    const char *camera_image;
+    const char *data_in;
+    const char *data_out;
+    const char *command;
+    const char *const *scripts;
+    size_t script_count;
+    uint16_t central_mtu;
+    uint16_t central_data_length;
+    uint32_t central_interval_us;
+    uint32_t central_min_interval_us;
+    bool central_passive;
+    uint16_t packets_per_event;
+    bool compress;
+    bool realtime;
+    bool stats;
+} host_options_t;
+
+extern host_options_t host_options;
+
+/**
+ * @brief Virtual time. Everything in the simulator runs off this clock rather
+ *        than the wall clock so that results are repeatable.
+ */
+
+uint64_t host_time_us(void);
+
+void host_advance_us(uint64_t us);
+
+void host_wait_for_event(void);
+
+typedef struct host_timer_t
+{
+    uint64_t deadline_us;
+    void (*handler)(void);
+    bool armed;
+    struct host_timer_t *next;
+} host_timer_t;
+
+void host_timer_start(host_timer_t *timer, uint64_t deadline_us);
+
+void host_timer_stop(host_timer_t *timer);
+
+/**
+ * @brief Interrupt emulation. Handlers never nest, as if everything was at the
+ *        same priority, and never preempt a timer handler, so that simulated
+ *        peripherals update their state atomically.
+ */
+
+typedef struct host_irq_t
+{
+    void (*handler)(void);
+    bool pending;
+    bool enabled;
+} host_irq_t;
+
+void host_irq_trigger(host_irq_t *irq);
+
+void host_irq_enable(host_irq_t *irq, bool enable);
+
+void host_irq_mask(bool masked);
+
+bool host_in_irq(void);
+
+/**
+ * @brief Charges the virtual time spent in a SoftDevice call.
+ */
+
+void host_svc_call(void);
+
+/**
+ * @brief GPIO levels. Outputs are driven by the firmware, inputs by the
+ *        simulated devices.
+ */
+
+bool host_gpio_level(uint8_t pin);
+
+void host_gpio_drive_input(uint8_t pin, bool level);
+
+/**
+ * @brief Simulated SPI devices. Bytes are exchanged in the device's own bit
+ *        order, and the chip select edges are forwarded from the GPIO model.
+ */
+
+typedef struct host_spi_device_t
+{
+    const char *name;
+    uint8_t cs_pin;
+    bool msb_first;
+    void (*select)(void);
+    uint8_t (*exchange)(uint8_t mosi);
+    void (*deselect)(void);
+} host_spi_device_t;
+
+const host_spi_device_t *host_spi_device_on_pin(uint8_t pin);
+
+/**
+ * @brief Simulated I2C devices. Register pointers are 8-bit, except for the
+ *        camera which uses 16-bit register addresses. Devices which are
+ *        powered down return false, which the bus reports as an address NACK.
+ */
+
+typedef struct host_i2c_device_t
+{
+    const char *name;
+    uint8_t bus;
+    uint8_t address;
+    bool wide_register;
+    bool (*powered)(void);
+    uint8_t (*read)(uint16_t reg);
+    void (*write)(uint16_t reg, uint8_t value);
+} host_i2c_device_t;
+
+const host_i2c_device_t *host_i2c_device_at(uint8_t bus, uint8_t address);
+
+void host_devices_init(void);
+
+void host_devices_deinit(void);
+
+void host_devices_pin_changed(uint8_t pin, bool level);
+
+uint16_t host_devices_battery_adc(void);
+
+uint32_t host_flash_sector_erases(size_t sector);
+
+/**
+ * @brief BLE link, shared between the simulated SoftDevice and the central.
+ *        The SoftDevice runs the link layer and the central's GATT client
+ *        procedures, and the central only deals in characteristic writes and
+ *        notifications.
+ */
+
+typedef enum host_ble_channel_t
+{
+    HOST_BLE_REPL,
+    HOST_BLE_DATA,
+    HOST_BLE_REPL_CREDIT,
+} host_ble_channel_t;
+
+typedef struct host_ble_link_t
+{
+    bool connected;
+    uint16_t att_mtu;
+    uint16_t data_length;
+    uint8_t phy;
+    uint32_t interval_us;
+} host_ble_link_t;
+
+host_ble_link_t host_softdevice_link(void);
+
+void host_central_init(void);
+
+void host_central_deinit(void);
+
+void host_central_connected(void);
+
+void host_central_disconnected(void);
+
+void host_central_connection_event(void);
+
+bool host_central_peek_write(host_ble_channel_t *channel,
+                             const uint8_t **data,
+                             size_t *length);
+
+void host_central_pop_write(void);
+
+void host_central_notification(host_ble_channel_t channel,
+                               const uint8_t *data,
+                               size_t length);
+
+/**
+ * @brief zlib compression for the central's compressed uploads. The stream
+ *        written to out is at most host_deflate_bound(length) bytes long.
+ */
+
+size_t host_deflate_bound(size_t length);
+
+size_t host_deflate(const uint8_t *in, size_t length, uint8_t *out);
+
+/**
+ * @brief Counters which can be read from the _host module or printed on exit.
+ */
+
+typedef struct host_counters_t
+{
+    uint64_t svc_calls;
+    uint64_t spi_transfers;
+    uint64_t spi_bytes;
+    uint64_t i2c_transfers;
+    uint64_t i2c_bytes;
+    uint64_t i2c_clock_cycles;
+    uint64_t i2c_bus_us;
+    uint64_t fpga_bytes;
+    uint64_t display_bytes;
+    uint64_t flash_read_bytes;
+    uint64_t flash_program_bytes;
+    uint64_t flash_erases;
+    uint64_t flash_status_reads;
+    uint64_t ble_connection_events;
+    uint64_t ble_notifications;
+    uint64_t ble_notification_bytes;
+    uint64_t ble_notification_retries;
+    uint64_t ble_writes;
+    uint64_t ble_write_bytes;
+} host_counters_t;
+
+extern host_counters_t host_counters;
+
+typedef struct host_counter_name_t
+{
+    const char *name;
+    size_t offset;
+} host_counter_name_t;
+
+extern const host_counter_name_t host_counter_names[];
+
+extern const size_t host_counter_name_count;
+
+/**
+ * @brief Ends the simulation, printing the counters if requested.
+ */
+
+__attribute__((noreturn)) void host_exit(int status);
@@ -0,0 +1,135 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host stand-in for the nRF52832 MDK and CMSIS core headers. Only the
+ *        registers and intrinsics which the firmware touches are provided.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define __STATIC_INLINE static inline
+#define __NO_RETURN __attribute__((noreturn))
+
+#define NRF52832_XXAA_HOST 1
+
+#define NUMBER_OF_PINS 32
+
+typedef enum
+{
+    POWER_CLOCK_IRQn = 0,
+    RADIO_IRQn = 1,
+    UARTE0_UART0_IRQn = 2,
+    SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn = 3,
+    SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn = 4,
+    GPIOTE_IRQn = 6,
+    SAADC_IRQn = 7,
+    TIMER0_IRQn = 8,
+    RTC0_IRQn = 11,
+    RTC1_IRQn = 17,
+    SWI0_IRQn = 20,
+    SWI1_IRQn = 21,
+    SWI2_IRQn = 22,
+    SPIM2_SPIS2_SPI2_IRQn = 35,
+    TIMER4_IRQn = 27,
+    FPU_IRQn = 38,
+} IRQn_Type;
+
+/**
+ * @brief Power peripheral. Only the fields used by the firmware are modeled.
+ */
+
+typedef struct
+{
+    volatile uint32_t RESETREAS;
+    volatile uint32_t SYSTEMOFF;
+    volatile uint32_t DCDCEN;
+    volatile uint32_t GPREGRET;
+} NRF_POWER_Type;
+
+extern NRF_POWER_Type host_power_peripheral;
+#define NRF_POWER (&host_power_peripheral)
+
+#define POWER_RESETREAS_RESETPIN_Msk (0x1UL << 0)
+#define POWER_RESETREAS_DOG_Msk (0x1UL << 1)
+#define POWER_RESETREAS_SREQ_Msk (0x1UL << 2)
+#define POWER_RESETREAS_LOCKUP_Msk (0x1UL << 3)
+
+/**
+ * @brief Debug registers used by app_err() to decide whether to break.
+ */
+
+typedef struct
+{
+    volatile uint32_t DHCSR;
+} CoreDebug_Type;
+
+extern CoreDebug_Type host_core_debug;
+#define CoreDebug (&host_core_debug)
+
+#define CoreDebug_DHCSR_C_DEBUGEN_Msk (0x1UL << 0)
+
+/**
+ * @brief CMSIS intrinsics. Most have no meaning on the host, but a DSB is used
+ *        to complete the write to SYSTEMOFF, so that's where power down is
+ *        simulated, and WFE sleeps in virtual time until the next interrupt.
+ */
+
+void host_data_barrier(void);
+
+void host_wait_for_event(void);
+
+#define __BKPT(value) __builtin_trap()
+#define __DSB() host_data_barrier()
+#define __ISB() __sync_synchronize()
+#define __DMB() __sync_synchronize()
+#define __WFE() host_wait_for_event()
+#define __SEV()
+#define __NOP()
+
+__STATIC_INLINE uint32_t __get_FPSCR(void)
+{
+    return 0;
+}
+
+__STATIC_INLINE void __set_FPSCR(uint32_t fpscr)
+{
+    (void)fpscr;
+}
+
+__STATIC_INLINE void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    (void)IRQn;
+}
+
+__STATIC_INLINE uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)
+{
+    (void)IRQn;
+    return 0;
+}
+
+__NO_RETURN void NVIC_SystemReset(void);
@@ -0,0 +1,101 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host version of the GPIO HAL. Pin levels are tracked by the simulator
+ *        so that chip selects can be routed to the simulated SPI devices.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nrf.h"
+
+typedef enum
+{
+    NRF_GPIO_PIN_DIR_INPUT,
+    NRF_GPIO_PIN_DIR_OUTPUT,
+} nrf_gpio_pin_dir_t;
+
+typedef enum
+{
+    NRF_GPIO_PIN_INPUT_CONNECT,
+    NRF_GPIO_PIN_INPUT_DISCONNECT,
+} nrf_gpio_pin_input_t;
+
+typedef enum
+{
+    NRF_GPIO_PIN_NOPULL,
+    NRF_GPIO_PIN_PULLDOWN,
+    NRF_GPIO_PIN_PULLUP = 3,
+} nrf_gpio_pin_pull_t;
+
+typedef enum
+{
+    NRF_GPIO_PIN_S0S1,
+    NRF_GPIO_PIN_H0S1,
+    NRF_GPIO_PIN_S0H1,
+    NRF_GPIO_PIN_H0H1,
+    NRF_GPIO_PIN_D0S1,
+    NRF_GPIO_PIN_D0H1,
+    NRF_GPIO_PIN_S0D1,
+    NRF_GPIO_PIN_H0D1,
+} nrf_gpio_pin_drive_t;
+
+typedef enum
+{
+    NRF_GPIO_PIN_NOSENSE,
+    NRF_GPIO_PIN_SENSE_LOW = 3,
+    NRF_GPIO_PIN_SENSE_HIGH = 2,
+} nrf_gpio_pin_sense_t;
+
+void nrf_gpio_cfg(uint32_t pin_number,
+                  nrf_gpio_pin_dir_t dir,
+                  nrf_gpio_pin_input_t input,
+                  nrf_gpio_pin_pull_t pull,
+                  nrf_gpio_pin_drive_t drive,
+                  nrf_gpio_pin_sense_t sense);
+
+void nrf_gpio_cfg_output(uint32_t pin_number);
+
+void nrf_gpio_cfg_default(uint32_t pin_number);
+
+void nrf_gpio_cfg_sense_input(uint32_t pin_number,
+                              nrf_gpio_pin_pull_t pull_config,
+                              nrf_gpio_pin_sense_t sense_config);
+
+void nrf_gpio_pin_write(uint32_t pin_number, uint32_t value);
+
+uint32_t nrf_gpio_pin_read(uint32_t pin_number);
+
+__STATIC_INLINE void nrf_gpio_pin_set(uint32_t pin_number)
+{
+    nrf_gpio_pin_write(pin_number, 1);
+}
+
+__STATIC_INLINE void nrf_gpio_pin_clear(uint32_t pin_number)
+{
+    nrf_gpio_pin_write(pin_number, 0);
+}
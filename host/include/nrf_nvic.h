@@ -0,0 +1,51 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host version of the SoftDevice NVIC wrappers. These are inline
+ *        register accesses on the nRF, and calls into the simulator here.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nrf_error_soc.h"
+
+typedef struct
+{
+    uint32_t volatile __irq_masks[2];
+    uint32_t volatile __cr_flag;
+} nrf_nvic_state_t;
+
+extern nrf_nvic_state_t nrf_nvic_state;
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_DisableIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_SetPendingIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t sd_nvic_critical_region_enter(uint8_t *p_is_nested_critical_region);
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region);
@@ -0,0 +1,71 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host stand-in for nrfx.h. Provides the common nrfx types, and pulls
+ *        in the glue layer the same way the real header does.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "nrf.h"
+
+#define NRFX_ERROR_BASE_NUM 0x0BAD0000
+#define NRFX_ERROR_DRIVERS_BASE_NUM (NRFX_ERROR_BASE_NUM + 0x10000)
+
+typedef enum
+{
+    NRFX_SUCCESS = (NRFX_ERROR_BASE_NUM + 0),
+    NRFX_ERROR_INTERNAL = (NRFX_ERROR_BASE_NUM + 1),
+    NRFX_ERROR_NO_MEM = (NRFX_ERROR_BASE_NUM + 2),
+    NRFX_ERROR_NOT_SUPPORTED = (NRFX_ERROR_BASE_NUM + 3),
+    NRFX_ERROR_INVALID_PARAM = (NRFX_ERROR_BASE_NUM + 4),
+    NRFX_ERROR_INVALID_STATE = (NRFX_ERROR_BASE_NUM + 5),
+    NRFX_ERROR_INVALID_LENGTH = (NRFX_ERROR_BASE_NUM + 6),
+    NRFX_ERROR_TIMEOUT = (NRFX_ERROR_BASE_NUM + 7),
+    NRFX_ERROR_FORBIDDEN = (NRFX_ERROR_BASE_NUM + 8),
+    NRFX_ERROR_NULL = (NRFX_ERROR_BASE_NUM + 9),
+    NRFX_ERROR_INVALID_ADDR = (NRFX_ERROR_BASE_NUM + 10),
+    NRFX_ERROR_BUSY = (NRFX_ERROR_BASE_NUM + 11),
+    NRFX_ERROR_ALREADY_INITIALIZED = (NRFX_ERROR_BASE_NUM + 12),
+    NRFX_ERROR_DRV_TWI_ERR_OVERRUN = (NRFX_ERROR_DRIVERS_BASE_NUM + 0),
+    NRFX_ERROR_DRV_TWI_ERR_ANACK = (NRFX_ERROR_DRIVERS_BASE_NUM + 1),
+    NRFX_ERROR_DRV_TWI_ERR_DNACK = (NRFX_ERROR_DRIVERS_BASE_NUM + 2),
+} nrfx_err_t;
+
+#define NRFX_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define NRFX_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define NRFX_ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
+/**
+ * @brief EasyDMA can only reach RAM. On the host, anything between the start
+ *        of the executable and the start of .data is treated as flash.
+ */
+
+bool nrfx_is_in_ram(void const *p_object);
+
+#include "nrfx_glue.h"
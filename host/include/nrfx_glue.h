@@ -0,0 +1,57 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host version of the nrfx glue layer. Interrupts are emulated by the
+ *        simulator, so critical sections map onto its interrupt mask.
+ */
+
+#pragma once
+
+#include "monocle.h"
+#include "nrf_nvic.h"
+
+#define NRFX_ASSERT(expression)  \
+    do                           \
+    {                            \
+        if ((expression) == 0)   \
+        {                        \
+            app_err(0xDEAD0A55); \
+        }                        \
+    } while (0)
+
+#define NRFX_STATIC_ASSERT(expression) \
+    _Static_assert(expression, "unspecified message")
+
+#define NRFX_CRITICAL_SECTION_ENTER()       \
+    {                                       \
+        uint8_t _is_nested_critical_region; \
+        sd_nvic_critical_region_enter(&_is_nested_critical_region);
+
+#define NRFX_CRITICAL_SECTION_EXIT()                          \
+    sd_nvic_critical_region_exit(_is_nested_critical_region); \
+    }
+
+#define NRFX_DELAY_US(us_time) \
+    nrfx_systick_delay_us(us_time)
@@ -0,0 +1,47 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host version of the RTT logger. Logs go to stderr instead.
+ */
+
+#pragma once
+
+#define RTT_CTRL_CLEAR ""
+
+void host_log(const char *format, ...);
+
+#define NRFX_LOG(format, ...) \
+    host_log(format "\r\n", ##__VA_ARGS__)
+
+#define NRFX_LOG_ERROR(format, ...)
+#define NRFX_LOG_WARNING(format, ...)
+#define NRFX_LOG_INFO(format, ...)
+#define NRFX_LOG_DEBUG(format, ...)
+
+#define NRFX_LOG_HEXDUMP_ERROR(p_memory, length)
+#define NRFX_LOG_HEXDUMP_WARNING(p_memory, length)
+#define NRFX_LOG_HEXDUMP_INFO(p_memory, length)
+#define NRFX_LOG_HEXDUMP_DEBUG(p_memory, length)
+#define NRFX_LOG_ERROR_STRING_GET(error_code)
@@ -0,0 +1,83 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host version of the nrfx RTC driver API. The counter is derived from
+ *        the simulator's virtual clock.
+ */
+
+#pragma once
+
+#include "nrfx.h"
+
+#define RTC_INPUT_FREQ 32768
+#define RTC_FREQ_TO_PRESCALER(FREQ) (uint16_t)(((RTC_INPUT_FREQ) / (FREQ)) - 1)
+
+typedef struct
+{
+    uint8_t instance_id;
+} nrfx_rtc_t;
+
+#define NRFX_RTC_INSTANCE(id) \
+    {                         \
+        .instance_id = id,    \
+    }
+
+typedef struct
+{
+    uint16_t prescaler;
+    uint8_t interrupt_priority;
+    uint8_t tick_latency;
+    bool reliable;
+} nrfx_rtc_config_t;
+
+#define NRFX_RTC_DEFAULT_CONFIG     \
+    {                               \
+        .prescaler = 0,             \
+        .interrupt_priority = 6,    \
+        .tick_latency = 0,          \
+        .reliable = false,          \
+    }
+
+typedef enum
+{
+    NRFX_RTC_INT_COMPARE0,
+    NRFX_RTC_INT_COMPARE1,
+    NRFX_RTC_INT_COMPARE2,
+    NRFX_RTC_INT_COMPARE3,
+    NRFX_RTC_INT_TICK,
+    NRFX_RTC_INT_OVERFLOW,
+} nrfx_rtc_int_type_t;
+
+typedef void (*nrfx_rtc_handler_t)(nrfx_rtc_int_type_t int_type);
+
+nrfx_err_t nrfx_rtc_init(nrfx_rtc_t const *p_instance,
+                         nrfx_rtc_config_t const *p_config,
+                         nrfx_rtc_handler_t handler);
+
+void nrfx_rtc_enable(nrfx_rtc_t const *p_instance);
+
+void nrfx_rtc_tick_enable(nrfx_rtc_t const *p_instance, bool enable_irq);
+
+uint32_t nrfx_rtc_counter_get(nrfx_rtc_t const *p_instance);
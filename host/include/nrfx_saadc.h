@@ -0,0 +1,114 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host version of the nrfx SAADC driver API. Only simple mode, blocking
+ *        conversions are supported, which is all the battery monitor uses.
+ */
+
+#pragma once
+
+#include "nrfx.h"
+
+#define NRFX_SAADC_DEFAULT_CONFIG_IRQ_PRIORITY 6
+
+typedef int16_t nrf_saadc_value_t;
+
+typedef enum
+{
+    NRF_SAADC_INPUT_DISABLED,
+    NRF_SAADC_INPUT_AIN0,
+    NRF_SAADC_INPUT_AIN1,
+    NRF_SAADC_INPUT_AIN2,
+    NRF_SAADC_INPUT_AIN3,
+} nrf_saadc_input_t;
+
+typedef enum
+{
+    NRF_SAADC_RESOLUTION_8BIT,
+    NRF_SAADC_RESOLUTION_10BIT,
+    NRF_SAADC_RESOLUTION_12BIT,
+    NRF_SAADC_RESOLUTION_14BIT,
+} nrf_saadc_resolution_t;
+
+typedef enum
+{
+    NRF_SAADC_OVERSAMPLE_DISABLED,
+} nrf_saadc_oversample_t;
+
+typedef enum
+{
+    NRF_SAADC_REFERENCE_INTERNAL,
+    NRF_SAADC_REFERENCE_VDD4,
+} nrf_saadc_reference_t;
+
+typedef enum
+{
+    NRF_SAADC_GAIN1_6,
+    NRF_SAADC_GAIN1_5,
+    NRF_SAADC_GAIN1_4,
+    NRF_SAADC_GAIN1_3,
+    NRF_SAADC_GAIN1_2,
+    NRF_SAADC_GAIN1,
+} nrf_saadc_gain_t;
+
+typedef struct
+{
+    nrf_saadc_gain_t gain;
+    nrf_saadc_reference_t reference;
+} nrf_saadc_channel_config_t;
+
+typedef struct
+{
+    nrf_saadc_channel_config_t channel_config;
+    nrf_saadc_input_t pin_p;
+    nrf_saadc_input_t pin_n;
+    uint8_t channel_index;
+} nrfx_saadc_channel_t;
+
+#define NRFX_SAADC_DEFAULT_CHANNEL_SE(_pin_p, _index)   \
+    {                                                   \
+        .channel_config = {                             \
+            .gain = NRF_SAADC_GAIN1_6,                  \
+            .reference = NRF_SAADC_REFERENCE_INTERNAL,  \
+        },                                              \
+        .pin_p = (_pin_p),                              \
+        .pin_n = NRF_SAADC_INPUT_DISABLED,              \
+        .channel_index = (_index),                      \
+    }
+
+typedef void (*nrfx_saadc_event_handler_t)(void const *p_event);
+
+nrfx_err_t nrfx_saadc_init(uint8_t interrupt_priority);
+
+nrfx_err_t nrfx_saadc_channel_config(nrfx_saadc_channel_t const *p_channel);
+
+nrfx_err_t nrfx_saadc_simple_mode_set(uint32_t channel_mask,
+                                      nrf_saadc_resolution_t resolution,
+                                      nrf_saadc_oversample_t oversampling,
+                                      nrfx_saadc_event_handler_t event_handler);
+
+nrfx_err_t nrfx_saadc_buffer_set(nrf_saadc_value_t *p_buffer, uint16_t size);
+
+nrfx_err_t nrfx_saadc_mode_trigger(void);
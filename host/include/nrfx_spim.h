@@ -0,0 +1,169 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host version of the nrfx SPIM driver API. Transfers are clocked into
+ *        whichever simulated device currently has its chip select asserted.
+ */
+
+#pragma once
+
+#include "nrfx.h"
+#include "nrf_gpio.h"
+
+#define NRFX_SPIM_PIN_NOT_USED 0xFF
+
+typedef enum
+{
+    NRF_SPIM_FREQ_125K = 0x02000000,
+    NRF_SPIM_FREQ_250K = 0x04000000,
+    NRF_SPIM_FREQ_500K = 0x08000000,
+    NRF_SPIM_FREQ_1M = 0x10000000,
+    NRF_SPIM_FREQ_2M = 0x20000000,
+    NRF_SPIM_FREQ_4M = 0x40000000,
+    NRF_SPIM_FREQ_8M = 0x80000000,
+} nrf_spim_frequency_t;
+
+typedef enum
+{
+    NRF_SPIM_MODE_0,
+    NRF_SPIM_MODE_1,
+    NRF_SPIM_MODE_2,
+    NRF_SPIM_MODE_3,
+} nrf_spim_mode_t;
+
+typedef enum
+{
+    NRF_SPIM_BIT_ORDER_MSB_FIRST,
+    NRF_SPIM_BIT_ORDER_LSB_FIRST,
+} nrf_spim_bit_order_t;
+
+// Only the registers that may change between transfers are modelled
+typedef struct
+{
+    nrf_spim_frequency_t FREQUENCY;
+} NRF_SPIM_Type;
+
+extern NRF_SPIM_Type host_spim_registers[3];
+
+static inline void nrf_spim_frequency_set(NRF_SPIM_Type *p_reg,
+                                          nrf_spim_frequency_t frequency)
+{
+    p_reg->FREQUENCY = frequency;
+}
+
+typedef struct
+{
+    NRF_SPIM_Type *p_reg;
+    uint8_t instance_id;
+} nrfx_spim_t;
+
+#define NRFX_SPIM_INSTANCE(id)             \
+    {                                      \
+        .p_reg = &host_spim_registers[id], \
+        .instance_id = id,                 \
+    }
+
+typedef struct
+{
+    uint8_t sck_pin;
+    uint8_t mosi_pin;
+    uint8_t miso_pin;
+    uint8_t ss_pin;
+    bool ss_active_high;
+    uint8_t irq_priority;
+    uint8_t orc;
+    nrf_spim_frequency_t frequency;
+    nrf_spim_mode_t mode;
+    nrf_spim_bit_order_t bit_order;
+    nrf_gpio_pin_pull_t miso_pull;
+} nrfx_spim_config_t;
+
+#define NRFX_SPIM_DEFAULT_CONFIG(_pin_sck, _pin_mosi, _pin_miso, _pin_ss) \
+    {                                                                     \
+        .sck_pin = _pin_sck,                                              \
+        .mosi_pin = _pin_mosi,                                            \
+        .miso_pin = _pin_miso,                                            \
+        .ss_pin = _pin_ss,                                                \
+        .ss_active_high = false,                                          \
+        .irq_priority = 6,                                                \
+        .orc = 0xFF,                                                      \
+        .frequency = NRF_SPIM_FREQ_4M,                                    \
+        .mode = NRF_SPIM_MODE_0,                                          \
+        .bit_order = NRF_SPIM_BIT_ORDER_MSB_FIRST,                        \
+        .miso_pull = NRF_GPIO_PIN_NOPULL,                                 \
+    }
+
+typedef struct
+{
+    uint8_t const *p_tx_buffer;
+    size_t tx_length;
+    uint8_t *p_rx_buffer;
+    size_t rx_length;
+} nrfx_spim_xfer_desc_t;
+
+#define NRFX_SPIM_XFER_TRX(p_tx_buf, tx_len, p_rx_buf, rx_len) \
+    {                                                          \
+        .p_tx_buffer = (uint8_t const *)(p_tx_buf),            \
+        .tx_length = (tx_len),                                 \
+        .p_rx_buffer = (p_rx_buf),                             \
+        .rx_length = (rx_len),                                 \
+    }
+
+#define NRFX_SPIM_XFER_TX(p_buf, length) \
+    NRFX_SPIM_XFER_TRX(p_buf, length, NULL, 0)
+
+#define NRFX_SPIM_XFER_RX(p_buf, length) \
+    NRFX_SPIM_XFER_TRX(NULL, 0, p_buf, length)
+
+#define NRFX_SPIM_FLAG_TX_POSTINC (1UL << 0)
+#define NRFX_SPIM_FLAG_RX_POSTINC (1UL << 1)
+#define NRFX_SPIM_FLAG_NO_XFER_EVT_HANDLER (1UL << 2)
+#define NRFX_SPIM_FLAG_HOLD_XFER (1UL << 3)
+#define NRFX_SPIM_FLAG_REPEATED_XFER (1UL << 4)
+
+typedef enum
+{
+    NRFX_SPIM_EVENT_DONE,
+} nrfx_spim_evt_type_t;
+
+typedef struct
+{
+    nrfx_spim_evt_type_t type;
+    nrfx_spim_xfer_desc_t xfer_desc;
+} nrfx_spim_evt_t;
+
+typedef void (*nrfx_spim_evt_handler_t)(nrfx_spim_evt_t const *p_event,
+                                        void *p_context);
+
+nrfx_err_t nrfx_spim_init(nrfx_spim_t const *p_instance,
+                          nrfx_spim_config_t const *p_config,
+                          nrfx_spim_evt_handler_t handler,
+                          void *p_context);
+
+void nrfx_spim_uninit(nrfx_spim_t const *p_instance);
+
+nrfx_err_t nrfx_spim_xfer(nrfx_spim_t const *p_instance,
+                          nrfx_spim_xfer_desc_t const *p_xfer_desc,
+                          uint32_t flags);
@@ -0,0 +1,132 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host version of the nrfx TIMER driver API. Compare events are
+ *        scheduled on the simulator's virtual clock.
+ */
+
+#pragma once
+
+#include "nrfx.h"
+
+typedef enum
+{
+    NRF_TIMER_FREQ_16MHz = 0,
+    NRF_TIMER_FREQ_8MHz,
+    NRF_TIMER_FREQ_4MHz,
+    NRF_TIMER_FREQ_2MHz,
+    NRF_TIMER_FREQ_1MHz,
+    NRF_TIMER_FREQ_500kHz,
+    NRF_TIMER_FREQ_250kHz,
+    NRF_TIMER_FREQ_125kHz,
+    NRF_TIMER_FREQ_62500Hz,
+    NRF_TIMER_FREQ_31250Hz,
+} nrf_timer_frequency_t;
+
+typedef enum
+{
+    NRF_TIMER_MODE_TIMER,
+    NRF_TIMER_MODE_COUNTER,
+} nrf_timer_mode_t;
+
+typedef enum
+{
+    NRF_TIMER_BIT_WIDTH_8,
+    NRF_TIMER_BIT_WIDTH_16,
+    NRF_TIMER_BIT_WIDTH_24,
+    NRF_TIMER_BIT_WIDTH_32,
+} nrf_timer_bit_width_t;
+
+typedef enum
+{
+    NRF_TIMER_CC_CHANNEL0,
+    NRF_TIMER_CC_CHANNEL1,
+    NRF_TIMER_CC_CHANNEL2,
+    NRF_TIMER_CC_CHANNEL3,
+} nrf_timer_cc_channel_t;
+
+typedef enum
+{
+    NRF_TIMER_EVENT_COMPARE0 = 0x140,
+    NRF_TIMER_EVENT_COMPARE1 = 0x144,
+    NRF_TIMER_EVENT_COMPARE2 = 0x148,
+    NRF_TIMER_EVENT_COMPARE3 = 0x14C,
+} nrf_timer_event_t;
+
+typedef enum
+{
+    NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK = (1UL << 0),
+    NRF_TIMER_SHORT_COMPARE0_STOP_MASK = (1UL << 8),
+} nrf_timer_short_mask_t;
+
+typedef struct
+{
+    uint8_t instance_id;
+} nrfx_timer_t;
+
+#define NRFX_TIMER_INSTANCE(id) \
+    {                           \
+        .instance_id = id,      \
+    }
+
+typedef struct
+{
+    nrf_timer_frequency_t frequency;
+    nrf_timer_mode_t mode;
+    nrf_timer_bit_width_t bit_width;
+    uint8_t interrupt_priority;
+    void *p_context;
+} nrfx_timer_config_t;
+
+#define NRFX_TIMER_DEFAULT_CONFIG                  \
+    {                                              \
+        .frequency = NRF_TIMER_FREQ_16MHz,         \
+        .mode = NRF_TIMER_MODE_TIMER,              \
+        .bit_width = NRF_TIMER_BIT_WIDTH_16,       \
+        .interrupt_priority = 6,                   \
+        .p_context = NULL,                         \
+    }
+
+typedef void (*nrfx_timer_event_handler_t)(nrf_timer_event_t event_type,
+                                           void *p_context);
+
+nrfx_err_t nrfx_timer_init(nrfx_timer_t const *p_instance,
+                           nrfx_timer_config_t const *p_config,
+                           nrfx_timer_event_handler_t timer_event_handler);
+
+void nrfx_timer_enable(nrfx_timer_t const *p_instance);
+
+void nrfx_timer_disable(nrfx_timer_t const *p_instance);
+
+void nrfx_timer_uninit(nrfx_timer_t const *p_instance);
+
+uint32_t nrfx_timer_capture(nrfx_timer_t const *p_instance,
+                            nrf_timer_cc_channel_t cc_channel);
+
+void nrfx_timer_extended_compare(nrfx_timer_t const *p_instance,
+                                 nrf_timer_cc_channel_t cc_channel,
+                                 uint32_t cc_value,
+                                 nrf_timer_short_mask_t timer_short_mask,
+                                 bool enable_int);
@@ -0,0 +1,122 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Host version of the nrfx TWIM driver API. Transfers are routed to the
+ *        simulated PMIC, touch and camera register maps by bus and address.
+ */
+
+#pragma once
+
+#include "nrfx.h"
+
+typedef enum
+{
+    NRF_TWIM_FREQ_100K = 0x01980000,
+    NRF_TWIM_FREQ_250K = 0x04000000,
+    NRF_TWIM_FREQ_400K = 0x06400000,
+} nrf_twim_frequency_t;
+
+typedef struct
+{
+    uint8_t instance_id;
+} nrfx_twim_t;
+
+#define NRFX_TWIM_INSTANCE(id) \
+    {                          \
+        .instance_id = id,     \
+    }
+
+typedef struct
+{
+    uint32_t scl;
+    uint32_t sda;
+    nrf_twim_frequency_t frequency;
+    uint8_t interrupt_priority;
+    bool hold_bus_uninit;
+} nrfx_twim_config_t;
+
+#define NRFX_TWIM_DEFAULT_CONFIG(_pin_scl, _pin_sda) \
+    {                                                \
+        .scl = _pin_scl,                             \
+        .sda = _pin_sda,                             \
+        .frequency = NRF_TWIM_FREQ_100K,             \
+        .interrupt_priority = 6,                     \
+        .hold_bus_uninit = false,                    \
+    }
+
+typedef enum
+{
+    NRFX_TWIM_XFER_TX,
+    NRFX_TWIM_XFER_RX,
+    NRFX_TWIM_XFER_TXRX,
+    NRFX_TWIM_XFER_TXTX,
+} nrfx_twim_xfer_type_t;
+
+typedef struct
+{
+    nrfx_twim_xfer_type_t type;
+    uint8_t address;
+    size_t primary_length;
+    size_t secondary_length;
+    uint8_t *p_primary_buf;
+    uint8_t *p_secondary_buf;
+} nrfx_twim_xfer_desc_t;
+
+#define NRFX_TWIM_XFER_DESC(_type, _addr, _p_pri, _pri_len, _p_sec, _sec_len) \
+    {                                                                        \
+        .type = (_type),                                                     \
+        .address = (_addr),                                                  \
+        .primary_length = (_pri_len),                                        \
+        .secondary_length = (_sec_len),                                      \
+        .p_primary_buf = (_p_pri),                                           \
+        .p_secondary_buf = (_p_sec),                                         \
+    }
+
+#define NRFX_TWIM_XFER_DESC_TX(addr, p_data, length) \
+    NRFX_TWIM_XFER_DESC(NRFX_TWIM_XFER_TX, addr, p_data, length, NULL, 0)
+
+#define NRFX_TWIM_XFER_DESC_RX(addr, p_data, length) \
+    NRFX_TWIM_XFER_DESC(NRFX_TWIM_XFER_RX, addr, p_data, length, NULL, 0)
+
+#define NRFX_TWIM_XFER_DESC_TXRX(addr, p_tx, tx_len, p_rx, rx_len) \
+    NRFX_TWIM_XFER_DESC(NRFX_TWIM_XFER_TXRX, addr, p_tx, tx_len, p_rx, rx_len)
+
+#define NRFX_TWIM_XFER_DESC_TXTX(addr, p_tx, tx_len, p_tx2, tx_len2) \
+    NRFX_TWIM_XFER_DESC(NRFX_TWIM_XFER_TXTX, addr, p_tx, tx_len, p_tx2, tx_len2)
+
+typedef void (*nrfx_twim_evt_handler_t)(void const *p_event, void *p_context);
+
+nrfx_err_t nrfx_twim_init(nrfx_twim_t const *p_instance,
+                          nrfx_twim_config_t const *p_config,
+                          nrfx_twim_evt_handler_t event_handler,
+                          void *p_context);
+
+void nrfx_twim_enable(nrfx_twim_t const *p_instance);
+
+void nrfx_twim_uninit(nrfx_twim_t const *p_instance);
+
+nrfx_err_t nrfx_twim_xfer(nrfx_twim_t const *p_instance,
+                          nrfx_twim_xfer_desc_t const *p_xfer_desc,
+                          uint32_t flags);
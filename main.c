@@ -28,6 +28,8 @@
 
 #include "monocle.h"
 #include "bluetooth.h"
+#include "camera.h"
+#include "storage.h"
 #include "touch.h"
 #include "config-tables.h"
 
@@ -44,8 +46,10 @@
 #include "py/stackctrl.h"
 #include "py/stream.h"
 #include "shared/readline/readline.h"
+#include "shared/runtime/gchelper.h"
 #include "shared/runtime/interrupt_char.h"
 #include "shared/runtime/pyexec.h"
+#include "lib/uzlib/tinf.h"
 
 #include "ble_gattc.h"
 #include "ble.h"
@@ -75,6 +79,7 @@ static struct ble_handles_t
     uint8_t advertising;
     ble_gatts_char_handles_t repl_rx_write;
     ble_gatts_char_handles_t repl_tx_notification;
+    ble_gatts_char_handles_t repl_rx_credit_notification;
     ble_gatts_char_handles_t data_rx_write;
     ble_gatts_char_handles_t data_tx_notification;
 } ble_handles = {
@@ -91,23 +96,58 @@ static struct advertising_data_t
     .payload = {0},
 };
 
-#define BLE_PREFERRED_MAX_MTU 256
+#define BLE_MAX_MTU 512
+
+// The settings of the firmware before the larger MTU, which needed far less RAM
+// than sd_ram_end reserves. They're used if the larger MTU doesn't fit. Its
+// queue of two notifications is doubled, which still leaves plenty of room
+#define BLE_FALLBACK_MTU 256
+#define BLE_FALLBACK_HVN_TX_QUEUE_SIZE 4
+// The table of older firmware, and room for the REPL credit characteristic
+#define BLE_FALLBACK_ATTR_TAB_SIZE ((365 + 16) * 4)
+
+static uint16_t ble_configured_mtu = BLE_MAX_MTU;
+static uint16_t ble_preferred_mtu = BLE_MAX_MTU;
 uint16_t ble_negotiated_mtu;
 
-static struct ble_ring_buffer_t
+// Hosts are granted credit up to the bytes received on the connection plus
+// the free space, so that they can write as fast as they like up to it
+static struct ble_repl_rx_buffer_t
 {
-    uint8_t buffer[1024];
+    uint8_t buffer[MICROPY_HW_BLE_REPL_RX_BUFFER_SIZE];
     uint16_t head;
     uint16_t tail;
+    uint32_t received;
+    uint32_t credit_sent;
 } repl_rx = {
     .buffer = "",
     .head = 0,
     .tail = 0,
-},
-  repl_tx = {
-      .buffer = "",
-      .head = 0,
-      .tail = 0,
+    .received = 0,
+    .credit_sent = 0,
+};
+
+static struct ble_ring_buffer_t
+{
+    uint8_t buffer[2 * BLE_MAX_MTU];
+    uint16_t head;
+    uint16_t tail;
+} repl_tx = {
+    .buffer = "",
+    .head = 0,
+    .tail = 0,
+};
+
+// Pieces of at most one MTU, each stored behind a two byte length
+static struct ble_data_tx_buffer_t
+{
+    uint8_t buffer[MICROPY_HW_BLE_DATA_TX_BUFFER_SIZE];
+    uint16_t head;
+    uint16_t tail;
+} data_tx = {
+    .buffer = "",
+    .head = 0,
+    .tail = 0,
 };
 
 bool ble_are_tx_notifications_enabled(ble_tx_channel_t channel)
@@ -141,6 +181,14 @@ bool ble_are_tx_notifications_enabled(ble_tx_channel_t channel)
                                        &value));
         break;
     }
+
+    case REPL_RX_CREDIT:
+    {
+        app_err(sd_ble_gatts_value_get(ble_handles.connection,
+                                       ble_handles.repl_rx_credit_notification.cccd_handle,
+                                       &value));
+        break;
+    }
     }
 
     // Value of 0x0001 means that notifications are enabled
@@ -157,113 +205,365 @@ size_t ble_get_max_payload_size(void)
     return ble_negotiated_mtu;
 }
 
-static bool ble_send_repl_data(void)
+uint16_t ble_get_configured_mtu(void)
 {
-    if (ble_handles.connection == BLE_CONN_HANDLE_INVALID)
+    return ble_configured_mtu;
+}
+
+uint16_t ble_get_preferred_mtu(void)
+{
+    return ble_preferred_mtu;
+}
+
+bool ble_set_preferred_mtu(uint16_t mtu)
+{
+    if (mtu < BLE_GATT_ATT_MTU_DEFAULT || mtu > ble_configured_mtu)
     {
         return true;
     }
 
-    if (!ble_are_tx_notifications_enabled(REPL_TX))
+    // Takes effect when the next client exchanges MTUs
+    ble_preferred_mtu = mtu;
+    return false;
+}
+
+// How long without bulk traffic before the link is relaxed in auto mode
+#define BLE_LINK_IDLE_TIMEOUT_MS 1000
+
+// Longest link layer payload allowed by Data Length Extension
+#define BLE_LINK_MAX_DATA_LENGTH 251
+
+static struct ble_link_t
+{
+    ble_link_mode_t mode;
+    ble_link_mode_t applied;
+    bool busy;
+    uint32_t last_busy_ms;
+} link = {
+    .mode = BLE_LINK_AUTO,
+    .applied = BLE_LINK_AUTO,
+    .busy = false,
+    .last_busy_ms = 0,
+};
+
+ble_link_mode_t ble_get_link_mode(void)
+{
+    return link.mode;
+}
+
+void ble_set_link_mode(ble_link_mode_t mode)
+{
+    link.mode = mode;
+    ble_tune_link();
+}
+
+static void ble_link_busy(void)
+{
+    link.busy = true;
+    link.last_busy_ms = mp_hal_ticks_ms();
+}
+
+void ble_tune_link(void)
+{
+    if (ble_handles.connection == BLE_CONN_HANDLE_INVALID)
     {
-        return true;
+        return;
     }
 
-    if (repl_tx.head == repl_tx.tail)
+    // In auto mode, fast while bulk transfers are going on, otherwise default
+    ble_link_mode_t target = link.mode;
+
+    if (link.mode == BLE_LINK_AUTO && link.busy)
     {
-        return true;
+        if (mp_hal_ticks_ms() - link.last_busy_ms < BLE_LINK_IDLE_TIMEOUT_MS)
+        {
+            target = BLE_LINK_FAST;
+        }
+        else
+        {
+            link.busy = false;
+        }
+    }
+
+    if (target == link.applied)
+    {
+        return;
     }
 
-    uint8_t tx_buffer[BLE_PREFERRED_MAX_MTU] = "";
-    uint16_t tx_length = 0;
+    ble_gap_conn_params_t conn_params;
+    app_err(sd_ble_gap_ppcp_get(&conn_params));
 
-    uint16_t buffered_tail = repl_tx.tail;
+    ble_gap_phys_t phys;
 
-    while (buffered_tail != repl_tx.head)
+    // If a procedure is still running, this is tried again later on
+    bool busy = false;
+
+    switch (target)
+    {
+    case BLE_LINK_FAST:
     {
-        tx_buffer[tx_length++] = repl_tx.buffer[buffered_tail++];
+        // 2M PHY, full length packets, and 15ms, the shortest interval which
+        // Apple's accessory guidelines accept. Both ends are pinned, as a range
+        // would have to be at least 15ms wide
+        ble_gap_data_length_params_t data_length = {
+            .max_tx_octets = BLE_LINK_MAX_DATA_LENGTH,
+            .max_rx_octets = BLE_LINK_MAX_DATA_LENGTH,
+            .max_tx_time_us = BLE_GAP_DATA_LENGTH_AUTO,
+            .max_rx_time_us = BLE_GAP_DATA_LENGTH_AUTO,
+        };
+
+        phys.tx_phys = BLE_GAP_PHY_2MBPS;
+        phys.rx_phys = BLE_GAP_PHY_2MBPS;
+        conn_params.min_conn_interval = (15 * 1000) / 1250;
+        conn_params.max_conn_interval = (15 * 1000) / 1250;
+        conn_params.slave_latency = 0;
+
+        busy |= sd_ble_gap_phy_update(ble_handles.connection, &phys) ==
+                NRF_ERROR_BUSY;
+        busy |= sd_ble_gap_data_length_update(ble_handles.connection,
+                                              &data_length,
+                                              NULL) == NRF_ERROR_BUSY;
+        break;
+    }
 
-        if (buffered_tail == sizeof(repl_tx.buffer))
+    case BLE_LINK_RELAXED:
+    {
+        // 1M PHY has the better range
+        phys.tx_phys = BLE_GAP_PHY_1MBPS;
+        phys.rx_phys = BLE_GAP_PHY_1MBPS;
+        busy |= sd_ble_gap_phy_update(ble_handles.connection, &phys) ==
+                NRF_ERROR_BUSY;
+        break;
+    }
+
+    case BLE_LINK_AUTO:
+        // Only the interval is relaxed. 2M and long packets save power
+        break;
+    }
+
+    busy |= sd_ble_gap_conn_param_update(ble_handles.connection,
+                                         &conn_params) == NRF_ERROR_BUSY;
+
+    if (!busy)
+    {
+        link.applied = target;
+    }
+}
+
+static void ble_send_repl_data(void)
+{
+    if (!ble_are_tx_notifications_enabled(REPL_TX))
+    {
+        return;
+    }
+
+    // Send contiguous runs of the ring in place until the SoftDevice is full
+    while (repl_tx.tail != repl_tx.head)
+    {
+        uint16_t end = repl_tx.head > repl_tx.tail
+                           ? repl_tx.head
+                           : sizeof(repl_tx.buffer);
+
+        uint16_t tx_length = end - repl_tx.tail;
+
+        if (tx_length > ble_negotiated_mtu)
         {
-            buffered_tail = 0;
+            tx_length = ble_negotiated_mtu;
         }
 
-        if (tx_length == ble_negotiated_mtu)
+        // Initialise the handle value parameters
+        ble_gatts_hvx_params_t hvx_params = {0};
+        hvx_params.handle = ble_handles.repl_tx_notification.value_handle;
+        hvx_params.p_data = &repl_tx.buffer[repl_tx.tail];
+        hvx_params.p_len = &tx_length;
+        hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
+
+        if (sd_ble_gatts_hvx(ble_handles.connection, &hvx_params) !=
+            NRF_SUCCESS)
         {
-            break;
+            return;
         }
+
+        repl_tx.tail = (repl_tx.tail + tx_length) % sizeof(repl_tx.buffer);
     }
+}
 
-    // Initialise the handle value parameters
-    ble_gatts_hvx_params_t hvx_params = {0};
-    hvx_params.handle = ble_handles.repl_tx_notification.value_handle;
-    hvx_params.p_data = tx_buffer;
-    hvx_params.p_len = (uint16_t *)&tx_length;
-    hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
+static uint16_t data_tx_used(void)
+{
+    return (data_tx.head - data_tx.tail + sizeof(data_tx.buffer)) %
+           sizeof(data_tx.buffer);
+}
 
-    uint32_t status = sd_ble_gatts_hvx(ble_handles.connection, &hvx_params);
+static void data_tx_copy_in(uint16_t *index, const uint8_t *bytes, size_t len)
+{
+    size_t first = sizeof(data_tx.buffer) - *index;
 
-    if (status == NRF_SUCCESS)
+    if (first > len)
     {
-        repl_tx.tail = buffered_tail;
+        first = len;
     }
 
-    return false;
+    memcpy(&data_tx.buffer[*index], bytes, first);
+    memcpy(data_tx.buffer, bytes + first, len - first);
+
+    *index = (*index + len) % sizeof(data_tx.buffer);
 }
 
-bool ble_send_raw_data(const uint8_t *bytes, size_t len)
+static void ble_send_queued_data(void)
 {
-    if (ble_handles.connection == BLE_CONN_HANDLE_INVALID)
+    // Only a piece which wraps around the end of the buffer is copied
+    static uint8_t wrapped_piece[BLE_MAX_MTU];
+
+    while (data_tx.tail != data_tx.head)
     {
-        return true;
+        uint16_t start = (data_tx.tail + 2) % sizeof(data_tx.buffer);
+        uint16_t length =
+            data_tx.buffer[data_tx.tail] |
+            data_tx.buffer[(data_tx.tail + 1) % sizeof(data_tx.buffer)] << 8;
+
+        const uint8_t *piece = &data_tx.buffer[start];
+
+        if (start + length > sizeof(data_tx.buffer))
+        {
+            size_t first = sizeof(data_tx.buffer) - start;
+            memcpy(wrapped_piece, &data_tx.buffer[start], first);
+            memcpy(wrapped_piece + first, data_tx.buffer, length - first);
+            piece = wrapped_piece;
+        }
+
+        ble_gatts_hvx_params_t hvx_params = {0};
+        hvx_params.handle = ble_handles.data_tx_notification.value_handle;
+        hvx_params.p_data = piece;
+        hvx_params.p_len = &length;
+        hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
+
+        // Stop once the SoftDevice queue is full. HVN_TX_COMPLETE resumes it
+        if (sd_ble_gatts_hvx(ble_handles.connection, &hvx_params) !=
+            NRF_SUCCESS)
+        {
+            return;
+        }
+
+        data_tx.tail = (start + length) % sizeof(data_tx.buffer);
     }
+}
 
-    if (!ble_are_tx_notifications_enabled(DATA_TX))
+bool ble_send_raw_data(const uint8_t *bytes, size_t len)
+{
+    // An empty notification would tell the central nothing, so none is queued
+    if (len == 0)
     {
-        return true;
+        return false;
     }
 
-    // Send all REPL data before sending raw data
-    while (ble_send_repl_data() == false)
+    size_t max_piece = ble_negotiated_mtu;
+
+    do
     {
-    }
+        size_t piece = len < max_piece ? len : max_piece;
 
-    // Initialise the handle value parameters
-    ble_gatts_hvx_params_t hvx_params = {0};
-    hvx_params.handle = ble_handles.data_tx_notification.value_handle;
-    hvx_params.p_data = bytes;
-    hvx_params.p_len = (uint16_t *)&len;
-    hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
+        // Wait for room, one byte is kept free to tell full from empty
+        while (data_tx_used() + 2 + piece >= sizeof(data_tx.buffer))
+        {
+            if (!ble_are_tx_notifications_enabled(DATA_TX))
+            {
+                return true;
+            }
 
-    uint32_t status = sd_ble_gatts_hvx(ble_handles.connection, &hvx_params);
+            MICROPY_EVENT_POLL_HOOK;
+        }
 
-    if (status == NRF_SUCCESS)
+        if (!ble_are_tx_notifications_enabled(DATA_TX))
+        {
+            return true;
+        }
+
+        uint8_t header[2] = {piece & 0xFF, piece >> 8};
+        uint16_t head = data_tx.head;
+        data_tx_copy_in(&head, header, sizeof(header));
+        data_tx_copy_in(&head, bytes, piece);
+        data_tx.head = head;
+
+        bytes += piece;
+        len -= piece;
+
+        // Start draining now if nothing is in flight to trigger HVN_TX_COMPLETE
+        app_err(sd_nvic_SetPendingIRQ((IRQn_Type)SD_EVT_IRQn));
+
+    } while (len > 0);
+
+    ble_link_busy();
+    ble_tune_link();
+
+    return false;
+}
+
+// Returns true on error like ble_send_raw_data(), but never waits. A piece
+// which doesn't fit in the queue right now isn't sent
+bool ble_send_raw_data_now(const uint8_t *bytes, size_t len)
+{
+    if (len == 0)
     {
         return false;
     }
 
-    return true;
+    // A single piece, queued only if there is room for it right now
+    if (len > ble_negotiated_mtu ||
+        data_tx_used() + 2 + len >= sizeof(data_tx.buffer) ||
+        !ble_are_tx_notifications_enabled(DATA_TX))
+    {
+        return true;
+    }
+
+    uint8_t header[2] = {len & 0xFF, len >> 8};
+    uint16_t head = data_tx.head;
+    data_tx_copy_in(&head, header, sizeof(header));
+    data_tx_copy_in(&head, bytes, len);
+    data_tx.head = head;
+
+    app_err(sd_nvic_SetPendingIRQ((IRQn_Type)SD_EVT_IRQn));
+
+    ble_link_busy();
+
+    return false;
 }
 
 void mp_hal_stdout_tx_strn(const char *str, mp_uint_t len)
 {
-    for (uint16_t position = 0; position < len; position++)
+    for (mp_uint_t position = 0; position < len; position++)
     {
-        while (repl_tx.head == repl_tx.tail - 1)
+        uint16_t next = (repl_tx.head + 1) % sizeof(repl_tx.buffer);
+
+        while (next == repl_tx.tail)
         {
+            ble_link_busy();
+
+            // Make sure the event handler is draining before waiting on it
+            app_err(sd_nvic_SetPendingIRQ((IRQn_Type)SD_EVT_IRQn));
             MICROPY_EVENT_POLL_HOOK;
         }
 
-        repl_tx.buffer[repl_tx.head++] = str[position];
-
-        if (repl_tx.head == sizeof(repl_tx.buffer))
-        {
-            repl_tx.head = 0;
-        }
+        repl_tx.buffer[repl_tx.head] = str[position];
+        repl_tx.head = next;
     }
+
+    // Start sending if nothing is in flight to trigger HVN_TX_COMPLETE
+    app_err(sd_nvic_SetPendingIRQ((IRQn_Type)SD_EVT_IRQn));
 }
 
-int mp_hal_stdin_rx_chr(void)
+static size_t repl_rx_used(void)
+{
+    return (repl_rx.head + sizeof(repl_rx.buffer) - repl_rx.tail) %
+           sizeof(repl_rx.buffer);
+}
+
+static uint32_t repl_rx_credit(void)
+{
+    // One byte is kept free to tell full from empty
+    return repl_rx.received + sizeof(repl_rx.buffer) - 1 - repl_rx_used();
+}
+
+static int repl_rx_pop(void)
 {
     while (repl_rx.head == repl_rx.tail)
     {
@@ -281,12 +581,371 @@ int mp_hal_stdin_rx_chr(void)
 
     repl_rx.tail = next;
 
+    // Have the event handler grant more credit once enough is freed
+    if (repl_rx_credit() - repl_rx.credit_sent >= sizeof(repl_rx.buffer) / 4 ||
+        repl_rx.head == repl_rx.tail)
+    {
+        app_err(sd_nvic_SetPendingIRQ((IRQn_Type)SD_EVT_IRQn));
+    }
+
+    return character;
+}
+
+static uint8_t repl_rx_peek(size_t offset)
+{
+    return repl_rx.buffer[(repl_rx.tail + offset) % sizeof(repl_rx.buffer)];
+}
+
+// Compressed uploads are zlib streams, with the bytes the REPL service
+// intercepts (Ctrl-C, safe mode) sent as an escape byte and the byte ^ 0x40
+#define REPL_COMPRESSED_ESCAPE 0x10
+#define REPL_COMPRESSED_WINDOW (sizeof(repl_rx.buffer) / 2)
+
+// Uploads are inflated as the raw REPL reads them, pulling the stream from the
+// ring, so that only the lexer ever holds the source. Back references reach no
+// further than the zlib window, or the whole source if that's shorter, which
+// is all that's kept of the output
+typedef struct repl_inflate_t
+{
+    TINF_DATA decompressor;
+    uint8_t zlib_header[2];
+    size_t compressed_left;
+    size_t inflated_left;
+    size_t received;
+    bool cancelled;
+    uint8_t dictionary[];
+} repl_inflate_t;
+
+MP_REGISTER_ROOT_POINTER(void *repl_inflate);
+
+static int repl_compressed_rx(size_t *received)
+{
+    bool escaped = false;
+
+    for (;;)
+    {
+        int character = repl_rx_pop();
+
+        // Like raw paste mode, give the host credit for another window
+        if (++*received % REPL_COMPRESSED_WINDOW == 0)
+        {
+            mp_hal_stdout_tx_strn("\x01", 1);
+        }
+
+        // Never part of the stream, so the host gave up
+        if (character == CHAR_CTRL_C)
+        {
+            return -1;
+        }
+
+        if (escaped)
+        {
+            return character ^ 0x40;
+        }
+
+        if (character != REPL_COMPRESSED_ESCAPE)
+        {
+            return character;
+        }
+
+        escaped = true;
+    }
+}
+
+static int repl_inflate_source(TINF_DATA *decompressor)
+{
+    repl_inflate_t *inflate = (repl_inflate_t *)decompressor;
+
+    if (inflate->compressed_left == 0)
+    {
+        return -1;
+    }
+
+    int character = repl_compressed_rx(&inflate->received);
+
+    if (character < 0)
+    {
+        inflate->cancelled = true;
+        inflate->compressed_left = 0;
+        return -1;
+    }
+
+    inflate->compressed_left--;
+    return character;
+}
+
+/**
+ * @brief Reports why an upload can't be inflated as soon as that's known, so
+ *        that the host can cancel the rest of the stream with Ctrl-C. Anything
+ *        it sends anyway is read out, which keeps the REPL in sync.
+ */
+
+static void repl_compressed_fail(const char *reason,
+                                 size_t compressed_left,
+                                 size_t *received)
+{
+    mp_hal_stdout_tx_strn("\x15", 1);
+    mp_hal_stdout_tx_str(reason);
+    mp_hal_stdout_tx_strn("\x04", 1);
+
+    while (compressed_left-- > 0 && repl_compressed_rx(received) >= 0)
+    {
+    }
+}
+
+/**
+ * @brief Receives a compressed upload, requested with Ctrl-E, Z, Ctrl-A in the
+ *        raw REPL. The reply is "Z\x01" and the window size, after which the
+ *        host sends the compressed and inflated lengths as 32-bit little endian
+ *        values followed by the escaped zlib stream. The stream is inflated as
+ *        the raw REPL reads it, as if the source had been typed, and "\x04" is
+ *        sent back at its end. If it can't be inflated, "\x15", the reason and
+ *        "\x04" are sent back, and the raw REPL gets a Ctrl-C instead.
+ * @returns False if the host cancelled the upload with Ctrl-C.
+ */
+
+static bool repl_receive_compressed(void)
+{
+    const char reply[] = {'Z',
+                          0x01,
+                          REPL_COMPRESSED_WINDOW & 0xFF,
+                          REPL_COMPRESSED_WINDOW >> 8};
+    mp_hal_stdout_tx_strn(reply, sizeof(reply));
+
+    size_t received = 0;
+    uint8_t header[10];
+
+    // The lengths, followed by the zlib header giving the window size
+    for (size_t i = 0; i < sizeof(header); i++)
+    {
+        int character = repl_compressed_rx(&received);
+
+        if (character < 0)
+        {
+            return false;
+        }
+
+        header[i] = character;
+    }
+
+    size_t compressed_length = header[0] | header[1] << 8 |
+                               header[2] << 16 | (uint32_t)header[3] << 24;
+    size_t inflated_length = header[4] | header[5] << 8 |
+                             header[6] << 16 | (uint32_t)header[7] << 24;
+
+    if (compressed_length < 2 || (header[8] & 0x0F) != 8 ||
+        (header[8] << 8 | header[9]) % 31 != 0)
+    {
+        repl_compressed_fail("not a zlib stream", 0, &received);
+        return true;
+    }
+
+    size_t compressed_left = compressed_length - 2;
+    size_t window = (size_t)1 << ((header[8] >> 4) + 8);
+    size_t dictionary = MAX(MIN(window, inflated_length), 1);
+
+    // The lexer takes as much again as the source, so both have to fit
+    gc_info_t info;
+    gc_info(&info);
+
+    if (inflated_length > info.free ||
+        sizeof(repl_inflate_t) + dictionary > info.free - inflated_length)
+    {
+        repl_compressed_fail("not enough memory", compressed_left, &received);
+        return true;
+    }
+
+    repl_inflate_t *inflate = m_malloc_maybe(sizeof(repl_inflate_t) +
+                                             dictionary);
+
+    if (inflate == NULL)
+    {
+        repl_compressed_fail("not enough memory", compressed_left, &received);
+        return true;
+    }
+
+    memset(inflate, 0, sizeof(repl_inflate_t));
+    inflate->compressed_left = compressed_left;
+    inflate->inflated_left = inflated_length;
+    inflate->received = received;
+
+    // The header is parsed again by uzlib, before it reads from the ring
+    memcpy(inflate->zlib_header, &header[8], sizeof(inflate->zlib_header));
+    inflate->decompressor.source = inflate->zlib_header;
+    inflate->decompressor.source_limit = inflate->zlib_header +
+                                         sizeof(inflate->zlib_header);
+    inflate->decompressor.source_read_cb = repl_inflate_source;
+    uzlib_uncompress_init(&inflate->decompressor,
+                          inflate->dictionary,
+                          dictionary);
+    uzlib_zlib_parse_header(&inflate->decompressor);
+
+    MP_STATE_PORT(repl_inflate) = inflate;
+    return true;
+}
+
+#define REPL_INFLATE_DONE -1
+#define REPL_INFLATE_FAILED -2
+
+/**
+ * @brief Inflates the next byte of an upload.
+ * @returns The byte, or one of REPL_INFLATE_DONE or REPL_INFLATE_FAILED once
+ *          the upload is over.
+ */
+
+static int repl_inflate_next(void)
+{
+    repl_inflate_t *inflate = MP_STATE_PORT(repl_inflate);
+    uint8_t character;
+
+    inflate->decompressor.dest = &character;
+    inflate->decompressor.dest_limit = &character + 1;
+
+    int status = uzlib_uncompress_chksum(&inflate->decompressor);
+
+    if (status == TINF_OK && inflate->inflated_left > 0 &&
+        !inflate->cancelled)
+    {
+        inflate->inflated_left--;
+        return character;
+    }
+
+    MP_STATE_PORT(repl_inflate) = NULL;
+    size_t compressed_left = inflate->compressed_left;
+    size_t received = inflate->received;
+    bool cancelled = inflate->cancelled;
+    bool inflated = status == TINF_DONE && inflate->inflated_left == 0;
+    m_free(inflate);
+
+    if (cancelled)
+    {
+        return REPL_INFLATE_FAILED;
+    }
+
+    if (!inflated)
+    {
+        repl_compressed_fail("the stream could not be inflated",
+                             compressed_left, &received);
+        return REPL_INFLATE_FAILED;
+    }
+
+    // Anything past the end of the stream is ignored
+    while (compressed_left-- > 0 && repl_compressed_rx(&received) >= 0)
+    {
+    }
+
+    mp_hal_stdout_tx_strn("\x04", 1);
+    return REPL_INFLATE_DONE;
+}
+
+// How long the rest of a compressed upload request may take to arrive
+#define REPL_HANDSHAKE_TIMEOUT_MS 500
+
+int mp_hal_stdin_rx_chr(void)
+{
+    // Whatever is left of a compressed upload comes first
+    if (MP_STATE_PORT(repl_inflate) != NULL)
+    {
+        int character = repl_inflate_next();
+
+        if (character >= 0)
+        {
+            return character;
+        }
+
+        // What the raw REPL has of a failed upload is thrown away
+        if (character == REPL_INFLATE_FAILED)
+        {
+            return CHAR_CTRL_C;
+        }
+    }
+
+    int character = repl_rx_pop();
+
+    // Compressed uploads are negotiated the same way as raw paste mode, at
+    // the raw REPL prompt only. While code runs, the interrupt character is
+    // set, and input() or stdin reads get whatever bytes were sent
+    if (character == CHAR_CTRL_E &&
+        pyexec_mode_kind == PYEXEC_MODE_RAW_REPL &&
+        mp_interrupt_char == -1)
+    {
+        uint32_t start = mp_hal_ticks_ms();
+
+        while (repl_rx_used() < 2 &&
+               mp_hal_ticks_ms() - start < REPL_HANDSHAKE_TIMEOUT_MS)
+        {
+            MICROPY_EVENT_POLL_HOOK;
+        }
+
+        if (repl_rx_used() >= 2 &&
+            repl_rx_peek(0) == 'Z' && repl_rx_peek(1) == CHAR_CTRL_A)
+        {
+            repl_rx_pop();
+            repl_rx_pop();
+
+            if (!repl_receive_compressed())
+            {
+                return CHAR_CTRL_C;
+            }
+
+            return mp_hal_stdin_rx_chr();
+        }
+    }
+
     return character;
 }
 
 uintptr_t mp_hal_stdio_poll(uintptr_t poll_flags)
 {
-    return (repl_rx.head == repl_rx.tail) ? poll_flags & MP_STREAM_POLL_RD : 0;
+    bool readable = repl_rx.head != repl_rx.tail ||
+                    MP_STATE_PORT(repl_inflate) != NULL;
+
+    return readable ? poll_flags & MP_STREAM_POLL_RD : 0;
+}
+
+/**
+ * @brief Sends the credit for REPL input as a 32-bit little endian count of
+ *        the bytes the host may have written since it connected. It's sent
+ *        in steps of a quarter of the ring, or once all input is consumed.
+ */
+
+static void ble_send_repl_rx_credit(void)
+{
+    uint32_t credit = repl_rx_credit();
+    uint32_t step = credit - repl_rx.credit_sent;
+
+    if (step == 0 ||
+        (step < sizeof(repl_rx.buffer) / 4 && repl_rx.head != repl_rx.tail) ||
+        !ble_are_tx_notifications_enabled(REPL_RX_CREDIT))
+    {
+        return;
+    }
+
+    uint8_t value[4] = {credit & 0xFF,
+                        (credit >> 8) & 0xFF,
+                        (credit >> 16) & 0xFF,
+                        credit >> 24};
+    uint16_t length = sizeof(value);
+
+    ble_gatts_hvx_params_t hvx_params = {0};
+    hvx_params.handle = ble_handles.repl_rx_credit_notification.value_handle;
+    hvx_params.p_data = value;
+    hvx_params.p_len = &length;
+    hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
+
+    if (sd_ble_gatts_hvx(ble_handles.connection, &hvx_params) == NRF_SUCCESS)
+    {
+        repl_rx.credit_sent = credit;
+    }
+}
+
+static void fpga_interrupt_handler(nrfx_gpiote_pin_t pin,
+                                   nrf_gpiote_polarity_t polarity)
+{
+    (void)pin;
+    (void)polarity;
+
+    // Waking up is enough. Whatever waits on the FPGA reads its status again
 }
 
 static void touch_interrupt_handler(nrfx_gpiote_pin_t pin,
@@ -355,7 +1014,7 @@ static void softdevice_assert_handler(uint32_t id, uint32_t pc, uint32_t info)
 void SD_EVT_IRQHandler(void)
 {
     uint32_t evt_id;
-    uint8_t ble_evt_buffer[sizeof(ble_evt_t) + BLE_PREFERRED_MAX_MTU];
+    uint8_t ble_evt_buffer[BLE_EVT_LEN_MAX(BLE_MAX_MTU)];
 
     // While any softdevice events are pending, service flash operations
     while (sd_evt_get(&evt_id) != NRF_ERROR_NOT_FOUND)
@@ -401,6 +1060,19 @@ void SD_EVT_IRQHandler(void)
         {
             ble_handles.connection = ble_evt->evt.gap_evt.conn_handle;
 
+            // Default MTU until the client exchanges a larger one. Any data
+            // still queued was meant for the previous connection
+            ble_negotiated_mtu = BLE_GATT_ATT_MTU_DEFAULT - 3;
+            data_tx.tail = data_tx.head;
+
+            // Credit counts from the start of each connection
+            repl_rx.received = 0;
+            repl_rx.credit_sent = 0;
+
+            // The connection starts out with the default parameters
+            link.applied = BLE_LINK_AUTO;
+            link.busy = false;
+
             ble_gap_conn_params_t conn_params;
 
             app_err(sd_ble_gap_ppcp_get(&conn_params));
@@ -416,15 +1088,19 @@ void SD_EVT_IRQHandler(void)
         case BLE_GAP_EVT_DISCONNECTED:
         {
             ble_handles.connection = BLE_CONN_HANDLE_INVALID;
+            data_tx.tail = data_tx.head;
             app_err(sd_ble_gap_adv_start(ble_handles.advertising, 1));
             break;
         }
 
         case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
         {
+            // Let the SoftDevice pick 2M unless the link is kept relaxed
+            uint8_t phy = link.mode == BLE_LINK_RELAXED ? BLE_GAP_PHY_1MBPS
+                                                        : BLE_GAP_PHY_AUTO;
             ble_gap_phys_t const phys = {
-                .rx_phys = BLE_GAP_PHY_1MBPS,
-                .tx_phys = BLE_GAP_PHY_1MBPS,
+                .rx_phys = phy,
+                .tx_phys = phy,
             };
             app_err(sd_ble_gap_phy_update(ble_evt->evt.gap_evt.conn_handle,
                                           &phys));
@@ -437,14 +1113,14 @@ void SD_EVT_IRQHandler(void)
             uint16_t client_mtu =
                 ble_evt->evt.gatts_evt.params.exchange_mtu_request.client_rx_mtu;
 
-            // Respond with our max MTU size
+            // Respond with our preferred MTU size
             sd_ble_gatts_exchange_mtu_reply(ble_handles.connection,
-                                            BLE_PREFERRED_MAX_MTU);
+                                            ble_preferred_mtu);
 
             // Choose the smaller MTU as the final length we'll use
             // -3 bytes to accommodate for Op-code and attribute service
-            ble_negotiated_mtu = BLE_PREFERRED_MAX_MTU < client_mtu
-                                     ? BLE_PREFERRED_MAX_MTU - 3
+            ble_negotiated_mtu = ble_preferred_mtu < client_mtu
+                                     ? ble_preferred_mtu - 3
                                      : client_mtu - 3;
             break;
         }
@@ -459,46 +1135,48 @@ void SD_EVT_IRQHandler(void)
                      i < ble_evt->evt.gatts_evt.params.write.len;
                      i++)
                 {
-                    uint16_t next = repl_rx.head + 1;
-
-                    if (next == sizeof(repl_rx.buffer))
-                    {
-                        next = 0;
-                    }
-
-                    if (next == repl_rx.tail)
-                    {
-                        break;
-                    }
+                    uint8_t character =
+                        ble_evt->evt.gatts_evt.params.write.data[i];
 
                     // Catch the safe mode signal
-                    if (ble_evt->evt.gatts_evt.params.write.data[i] == 0x1C)
+                    if (character == 0x1C)
                     {
                         monocle_enter_safe_mode();
+                        continue;
                     }
 
                     // Catch keyboard interrupts
-                    else if (ble_evt->evt.gatts_evt.params.write.data[i] ==
-                             mp_interrupt_char)
+                    if (character == mp_interrupt_char)
                     {
                         mp_sched_keyboard_interrupt();
+                        continue;
+                    }
+
+                    uint16_t next = repl_rx.head + 1;
+
+                    if (next == sizeof(repl_rx.buffer))
+                    {
+                        next = 0;
                     }
 
-                    // Otherwise add the character to the ring buffer
-                    else
+                    // Only hosts ignoring the credit can overflow the ring
+                    if (next == repl_rx.tail)
                     {
-                        repl_rx.buffer[repl_rx.head] =
-                            ble_evt->evt.gatts_evt.params.write.data[i];
+                        break;
                     }
 
+                    repl_rx.buffer[repl_rx.head] = character;
                     repl_rx.head = next;
                 }
+
+                repl_rx.received += ble_evt->evt.gatts_evt.params.write.len;
             }
 
             // If data service
             if (ble_evt->evt.gatts_evt.params.write.handle ==
                 ble_handles.data_rx_write.value_handle)
             {
+                ble_link_busy();
                 bluetooth_receive_callback_handler(
                     ble_evt->evt.gatts_evt.params.write.data,
                     ble_evt->evt.gatts_evt.params.write.len);
@@ -543,10 +1221,17 @@ void SD_EVT_IRQHandler(void)
             break;
         }
 
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+        {
+            // Space was freed in the SoftDevice queue. Refilled below, by
+            // the time that anything streaming gets to run again
+            bluetooth_data_sent_handler();
+            break;
+        }
+
         case BLE_GAP_EVT_CONN_PARAM_UPDATE:
         case BLE_GAP_EVT_PHY_UPDATE:
         case BLE_GAP_EVT_DATA_LENGTH_UPDATE:
-        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
         {
             // Unused events
             break;
@@ -559,6 +1244,132 @@ void SD_EVT_IRQHandler(void)
         }
         }
     }
+
+    // Keep the SoftDevice queue full, REPL credit and output going out first
+    if (ble_handles.connection != BLE_CONN_HANDLE_INVALID)
+    {
+        ble_send_repl_rx_credit();
+        ble_send_repl_data();
+        ble_send_queued_data();
+    }
+}
+
+bool camera_power_up(void)
+{
+    // Start the camera clock
+    uint8_t command[2] = {0x10, 0x09};
+    monocle_spi_write(FPGA, command, 2, false);
+
+    // Reset sequence taken from Datasheet figure 2-3
+    nrf_gpio_pin_write(CAMERA_RESET_PIN, false);
+    nrf_gpio_pin_write(CAMERA_SLEEP_PIN, true);
+    nrfx_systick_delay_ms(5); // t2
+    nrf_gpio_pin_write(CAMERA_SLEEP_PIN, false);
+    nrfx_systick_delay_ms(1); // t3
+    nrf_gpio_pin_write(CAMERA_RESET_PIN, true);
+    nrfx_systick_delay_ms(20); // t4
+
+    // Read the camera CID (one of them)
+    i2c_response_t resp = monocle_i2c_read(CAMERA_I2C_ADDRESS, 0x300A, 0xFF);
+    if (resp.fail || resp.value != 0x56)
+    {
+        // TODO add entry in health monitor if camera didn't initialise
+        NRFX_LOG("Camera not detected");
+        monocle_set_led(RED_LED, true);
+        nrf_gpio_pin_write(CAMERA_RESET_PIN, false);
+        nrf_gpio_pin_write(CAMERA_SLEEP_PIN, true);
+        return false;
+    }
+
+    // Software reset
+    monocle_i2c_write(CAMERA_I2C_ADDRESS, 0x3008, 0xFF, 0x82);
+    nrfx_systick_delay_ms(5);
+
+    // Send the default configuration
+    bool configured =
+        camera_write_registers(camera_config,
+                               sizeof(camera_config) / sizeof(camera_config_t));
+
+    // Put the camera to sleep
+    nrf_gpio_pin_write(CAMERA_SLEEP_PIN, true);
+
+    return configured;
+}
+
+/**
+ * @brief Configures the GATT side of the SoftDevice and enables it.
+ * @returns NRF_ERROR_NO_MEM if the RAM up to sd_ram_end isn't enough for the
+ *          MTU, notification queue and attribute table asked for.
+ */
+
+static uint32_t ble_enable(uint16_t att_mtu,
+                           uint8_t hvn_tx_queue_size,
+                           uint32_t attr_tab_size)
+{
+    ble_cfg_t cfg;
+    uint32_t status;
+
+    // Set max MTU size
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.conn_cfg.conn_cfg_tag = 1;
+    cfg.conn_cfg.params.gatt_conn_cfg.att_mtu = att_mtu;
+    status = sd_ble_cfg_set(BLE_CONN_CFG_GATT, &cfg, ram_start);
+
+    if (status != NRF_SUCCESS)
+    {
+        return status;
+    }
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.conn_cfg.conn_cfg_tag = 1;
+    cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = hvn_tx_queue_size;
+    status = sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &cfg, ram_start);
+
+    if (status != NRF_SUCCESS)
+    {
+        return status;
+    }
+
+    // Configure number of custom UUIDs
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.common_cfg.vs_uuid_cfg.vs_uuid_count = 2;
+    status = sd_ble_cfg_set(BLE_COMMON_CFG_VS_UUID, &cfg, ram_start);
+
+    if (status != NRF_SUCCESS)
+    {
+        return status;
+    }
+
+    // Configure GATTS attribute table
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.gatts_cfg.attr_tab_size.attr_tab_size = attr_tab_size; // multiples of 4
+    status = sd_ble_cfg_set(BLE_GATTS_CFG_ATTR_TAB_SIZE, &cfg, ram_start);
+
+    if (status != NRF_SUCCESS)
+    {
+        return status;
+    }
+
+    // No service changed attribute needed
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.gatts_cfg.service_changed.service_changed = 0;
+    app_err(sd_ble_cfg_set(BLE_GATTS_CFG_SERVICE_CHANGED, &cfg, ram_start));
+
+    // Start the Softdevice. It returns how much RAM it actually needs
+    uint32_t ram_needed = ram_start;
+    status = sd_ble_enable(&ram_needed);
+
+    NRFX_LOG("Softdevice needs 0x%x bytes of RAM, 0x%x reserved",
+             ram_needed - 0x20000000,
+             ram_start - 0x20000000);
+
+    if (ram_needed != ram_start)
+    {
+        NRFX_LOG("Set sd_ram_end in monocle.ld to 0x%x",
+                 ram_needed - 0x20000000);
+    }
+
+    return status;
 }
 
 int main(void)
@@ -567,54 +1378,20 @@ int main(void)
              "\rMicroPython on Monocle - " BUILD_VERSION
              " (" MICROPY_GIT_HASH ")");
 
+    monocle_boot_trace("main");
+
     // Set up the PMIC and go to sleep if on charge
     monocle_critical_startup();
 
+    monocle_boot_trace("pmic");
+
     // Start the FPGA
     monocle_fpga_reset(true);
 
-    // Setup the camera
-    {
-        // Start the camera clock
-        uint8_t command[2] = {0x10, 0x09};
-        monocle_spi_write(FPGA, command, 2, false);
-
-        // Reset sequence taken from Datasheet figure 2-3
-        nrf_gpio_pin_write(CAMERA_RESET_PIN, false);
-        nrf_gpio_pin_write(CAMERA_SLEEP_PIN, true);
-        nrfx_systick_delay_ms(5); // t2
-        nrf_gpio_pin_write(CAMERA_SLEEP_PIN, false);
-        nrfx_systick_delay_ms(1); // t3
-        nrf_gpio_pin_write(CAMERA_RESET_PIN, true);
-        nrfx_systick_delay_ms(20); // t4
+    // The camera is held in reset and powered down until it's first used
+    nrf_gpio_pin_write(CAMERA_SLEEP_PIN, true);
 
-        // Read the camera CID (one of them)
-        i2c_response_t resp = monocle_i2c_read(CAMERA_I2C_ADDRESS, 0x300A, 0xFF);
-        if (resp.fail || resp.value != 0x56)
-        {
-            // TODO add entry in health monitor if camera didn't initialise
-            NRFX_LOG("Camera not detected");
-            monocle_set_led(RED_LED, true);
-        }
-
-        // Software reset
-        monocle_i2c_write(CAMERA_I2C_ADDRESS, 0x3008, 0xFF, 0x82);
-        nrfx_systick_delay_ms(5);
-
-        // Send the default configuration
-        for (size_t i = 0;
-             i < sizeof(camera_config) / sizeof(camera_config_t);
-             i++)
-        {
-            monocle_i2c_write(CAMERA_I2C_ADDRESS,
-                              camera_config[i].address,
-                              0xFF,
-                              camera_config[i].value);
-        }
-
-        // Put the camera to sleep
-        nrf_gpio_pin_write(CAMERA_SLEEP_PIN, true);
-    }
+    monocle_boot_trace("fpga");
 
     // Enable, and setup the display
     {
@@ -631,6 +1408,8 @@ int main(void)
         }
     }
 
+    monocle_boot_trace("display");
+
     // Setup touch interrupt
     {
         app_err(nrfx_gpiote_init(NRFX_GPIOTE_DEFAULT_CONFIG_IRQ_PRIORITY));
@@ -646,6 +1425,22 @@ int main(void)
                                     true);
     }
 
+    // Setup FPGA interrupt, shared with its reset line
+    {
+        nrfx_gpiote_in_config_t config =
+            NRFX_GPIOTE_CONFIG_IN_SENSE_HITOLO(false);
+
+        // Keep the open drain output that holds the FPGA in reset
+        config.skip_gpio_setup = true;
+
+        app_err(nrfx_gpiote_in_init(FPGA_RESET_INT_PIN,
+                                    &config,
+                                    fpga_interrupt_handler));
+
+        nrfx_gpiote_in_event_enable(FPGA_RESET_INT_PIN,
+                                    true);
+    }
+
     // Setup battery ADC input
     {
         app_err(nrfx_saadc_init(NRFX_SAADC_DEFAULT_CONFIG_IRQ_PRIORITY));
@@ -702,37 +1497,21 @@ int main(void)
         cfg.gap_cfg.role_count_cfg.periph_role_count = 1;
         app_err(sd_ble_cfg_set(BLE_GAP_CFG_ROLE_COUNT, &cfg, ram_start));
 
-        // Set max MTU size
-        memset(&cfg, 0, sizeof(cfg));
-        cfg.conn_cfg.conn_cfg_tag = 1;
-        cfg.conn_cfg.params.gatt_conn_cfg.att_mtu = BLE_PREFERRED_MAX_MTU;
-        app_err(sd_ble_cfg_set(BLE_CONN_CFG_GATT, &cfg, ram_start));
-
-        // Configure two queued transfers
-        memset(&cfg, 0, sizeof(cfg));
-        cfg.conn_cfg.conn_cfg_tag = 1;
-        cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = 2;
-        app_err(sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &cfg, ram_start));
-
-        // Configure number of custom UUIDs
-        memset(&cfg, 0, sizeof(cfg));
-        cfg.common_cfg.vs_uuid_cfg.vs_uuid_count = 2;
-        app_err(sd_ble_cfg_set(BLE_COMMON_CFG_VS_UUID, &cfg, ram_start));
-
-        // Configure GATTS attribute table
-        memset(&cfg, 0, sizeof(cfg));
-        cfg.gatts_cfg.attr_tab_size.attr_tab_size = 365 * 4; // multiples of 4
-        app_err(sd_ble_cfg_set(BLE_GATTS_CFG_ATTR_TAB_SIZE, &cfg, ram_start));
-
-        // No service changed attribute needed
-        memset(&cfg, 0, sizeof(cfg));
-        cfg.gatts_cfg.service_changed.service_changed = 0;
-        app_err(sd_ble_cfg_set(BLE_GATTS_CFG_SERVICE_CHANGED, &cfg, ram_start));
+        // Queue enough notifications to fill a whole connection event. The
+        // RAM reserved for this comes from the host model. Should a device
+        // need more, it boots with the much smaller setup of older firmware
+        uint32_t status = ble_enable(BLE_MAX_MTU, 8, 640 * 4);
 
-        // Start the Softdevice
-        app_err(sd_ble_enable(&ram_start));
+        if (status == NRF_ERROR_NO_MEM)
+        {
+            ble_configured_mtu = BLE_FALLBACK_MTU;
+            ble_preferred_mtu = ble_configured_mtu;
+            status = ble_enable(BLE_FALLBACK_MTU,
+                                BLE_FALLBACK_HVN_TX_QUEUE_SIZE,
+                                BLE_FALLBACK_ATTR_TAB_SIZE);
+        }
 
-        NRFX_LOG("Softdevice using 0x%x bytes of RAM", ram_start - 0x20000000);
+        app_err(status);
 
         // Set security to open // TODO make this paired
         ble_gap_conn_sec_mode_t sec_mode;
@@ -744,10 +1523,12 @@ int main(void)
                                            (const uint8_t *)device_name,
                                            sizeof(device_name) - 1));
 
-        // Set connection parameters
+        // Set connection parameters. These are what the link relaxes to, with
+        // the range of 15ms that Apple's accessory guidelines ask for, and
+        // short enough for typing into the REPL
         ble_gap_conn_params_t gap_conn_params = {0};
-        gap_conn_params.min_conn_interval = (15 * 1000) / 1250;
-        gap_conn_params.max_conn_interval = (15 * 1000) / 1250;
+        gap_conn_params.min_conn_interval = (30 * 1000) / 1250;
+        gap_conn_params.max_conn_interval = (45 * 1000) / 1250;
         gap_conn_params.slave_latency = 0;
         gap_conn_params.conn_sup_timeout = (2000 * 1000) / 10000;
         app_err(sd_ble_gap_ppcp_set(&gap_conn_params));
@@ -794,7 +1575,7 @@ int main(void)
         rx_attr.p_uuid = &rx_uuid;
         rx_attr.p_attr_md = &rx_attr_md;
         rx_attr.init_len = sizeof(uint8_t);
-        rx_attr.max_len = BLE_PREFERRED_MAX_MTU - 3;
+        rx_attr.max_len = ble_configured_mtu - 3;
 
         // Configure both TX characteristics as one because they're identical
         ble_uuid_t tx_uuid = {.uuid = 0x0003};
@@ -813,7 +1594,7 @@ int main(void)
         tx_attr.p_uuid = &tx_uuid;
         tx_attr.p_attr_md = &tx_attr_md;
         tx_attr.init_len = sizeof(uint8_t);
-        tx_attr.max_len = BLE_PREFERRED_MAX_MTU - 3;
+        tx_attr.max_len = ble_configured_mtu - 3;
 
         // Characteristics must be added sequentially after each service
         app_err(sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY,
@@ -830,6 +1611,21 @@ int main(void)
                                                 &tx_attr,
                                                 &ble_handles.repl_tx_notification));
 
+        // The REPL input credit is notified through its own characteristic
+        ble_uuid_t credit_uuid = {.uuid = 0x0004};
+        credit_uuid.type = repl_service_uuid.type;
+
+        ble_gatts_attr_t credit_attr = {0};
+        credit_attr.p_uuid = &credit_uuid;
+        credit_attr.p_attr_md = &tx_attr_md;
+        credit_attr.init_len = sizeof(uint32_t);
+        credit_attr.max_len = sizeof(uint32_t);
+
+        app_err(sd_ble_gatts_characteristic_add(repl_service_handle,
+                                                &tx_char_md,
+                                                &credit_attr,
+                                                &ble_handles.repl_rx_credit_notification));
+
         // The UUID were increased by the SoftDevice
         rx_uuid.type = data_service_uuid.type;
         tx_uuid.type = data_service_uuid.type;
@@ -894,6 +1690,11 @@ int main(void)
         app_err(sd_ble_gap_adv_start(ble_handles.advertising, 1));
     }
 
+    monocle_boot_trace("bluetooth");
+
+    // Only the first pass through is part of the boot
+    bool booted = false;
+
     // Soft resets will always restart micropython,
     while (true)
     {
@@ -908,14 +1709,47 @@ int main(void)
         mp_init();
         readline_init0();
 
+        // Anything left of a compressed upload went with the old heap
+        MP_STATE_PORT(repl_inflate) = NULL;
+
+        // So is a camera stream, which relies on the scheduler to keep going
+        camera_stream_reset();
+
+        // And anything received on the data service, which is waiting for it
+        bluetooth_data_reset();
+
+        // Flash regions are claimed again as storage is mounted
+        storage_reset();
+
+        if (!booted)
+        {
+            monocle_boot_trace("micropython");
+        }
+
         // Mount the filesystem, or format if needed
         pyexec_frozen_module("_mountfs.py", false);
         pyexec_frozen_module("_splashscreen.py", false);
 
+        if (!booted)
+        {
+            monocle_boot_trace("filesystem");
+        }
+
         // If safe mode is not enabled, run the user's main.py file
         monocle_started_in_safe_mode() ? NRFX_LOG("Starting in safe mode")
                                        : pyexec_file_if_exists("main.py");
 
+        if (!booted)
+        {
+            monocle_boot_trace_finish("repl");
+            booted = true;
+
+#if MICROPY_HW_CAMERA_PREFETCH
+            // Runs once the REPL is waiting for input
+            camera_prefetch();
+#endif
+        }
+
         // Stay in the friendly or raw REPL until a reset is called
         for (;;)
         {
@@ -945,19 +1779,18 @@ int main(void)
 
 void mp_event_poll_hook(void)
 {
-    // Keep sending REPL data. Then if no more data is pending
-    if (ble_send_repl_data())
-    {
-        extern void mp_handle_pending(bool);
-        mp_handle_pending(true);
+    // REPL data is sent from the SoftDevice event handler
+    ble_tune_link();
 
-        // Clear exceptions and PendingIRQ from the FPU
-        __set_FPSCR(__get_FPSCR() & ~(0x0000009F));
-        (void)__get_FPSCR();
-        NVIC_ClearPendingIRQ(FPU_IRQn);
+    extern void mp_handle_pending(bool);
+    mp_handle_pending(true);
 
-        app_err(sd_app_evt_wait());
-    }
+    // Clear exceptions and PendingIRQ from the FPU
+    __set_FPSCR(__get_FPSCR() & ~(0x0000009F));
+    (void)__get_FPSCR();
+    NVIC_ClearPendingIRQ(FPU_IRQn);
+
+    app_err(sd_app_evt_wait());
 }
 
 void gc_collect(void)
@@ -965,14 +1798,8 @@ void gc_collect(void)
     // start the GC
     gc_collect_start();
 
-    // Get stack pointer
-    uintptr_t sp;
-    __asm__("mov %0, sp\n"
-            : "=r"(sp));
-
-    // Trace the stack, including the registers
-    // (since they live on the stack in this function)
-    gc_collect_root((void **)sp, ((uint32_t)&_stack_top - sp) / sizeof(uint32_t));
+    // Trace the registers and the stack. Portable so that the host build works
+    gc_helper_collect_regs_and_stack();
 
     // end the GC
     gc_collect_end();
@@ -1,13 +1,55 @@
 import os, device
 
-bdev = device.Storage()
 
+def __geometry(bdev):
+    return {
+        "readsize": bdev.READ_SIZE,
+        "progsize": bdev.PROG_SIZE,
+        "lookahead": bdev.LOOKAHEAD_SIZE,
+    }
+
+
+def __block_count(bdev):
+    # Either block of the superblock pair names littlefs, followed by a tag
+    # and the version, block size and block count
+    block = bytearray(64)
+    for i in range(2):
+        bdev.readblocks(i, block)
+        at = bytes(block).find(b"littlefs")
+        if at >= 0 and at + 24 <= len(block):
+            return int.from_bytes(block[at + 20 : at + 24], "little")
+    return 0
+
+
+def __mount(bdev):
+    blocks = __block_count(bdev)
+
+    if blocks == bdev.ioctl(4, 0):
+        os.mount(os.VfsLfs2(bdev, **__geometry(bdev)), "/")
+        return
+
+    # Filesystems made before the log and blob regions were split off also
+    # predate the tuned geometry. They keep both, as littlefs doesn't record
+    # the program size, and pages programmed 32 bytes at a time can't be
+    # programmed again whole. Any Storage reaching into those regions keeps
+    # the log store and blobs out of them until reset
+    old = device.Storage(length=blocks * 4096, prog_size=32)
+    os.mount(os.VfsLfs2(old), "/")
+
+
+bdev = device.Storage()
+if __block_count(bdev) == 0:
+    os.VfsLfs2.mkfs(bdev, **__geometry(bdev))
 try:
-    os.mount(bdev, "/")
-except OSError:
-    os.VfsLfs2.mkfs(bdev)
-    os.mount(bdev, "/")
+    __mount(bdev)
+except (OSError, ValueError) as e:
+    # An existing filesystem is never erased here, as it may hold the only copy
+    # of the user's files. tools/upload_file.py --migrate can move it over
+    print("Filesystem not mounted:", repr(e))
+del bdev
 
 del os
 del device
-del bdev
+del __geometry
+del __block_count
+del __mount
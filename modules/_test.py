@@ -35,6 +35,8 @@ import time
 import update
 import math
 import random
+import os
+import errno
 
 
 def __test(evaluate, expected):
@@ -62,7 +64,42 @@ def device_module():
     __test("isinstance(device.battery_level(), int)", True)
     __test("device.prevent_sleep(True)", None)
     __test("device.prevent_sleep(False)", None)
-    __test("str(device.Storage())", "Storage(start=0x0006d000, len=602112)")
+    __test("device.boot_trace()[0][0]", "main")
+    __test("(lambda t: t == sorted(t))([t for _, t in device.boot_trace()])", True)
+    __test("[s for s, _ in device.boot_trace()].count('repl')", 1)
+    __test("str(device.Storage())", "Storage(start=0x0006d000, len=471040)")
+    __test("device.Storage.PROG_SIZE", 256)
+    __test("str(device.Storage(verify=True))", "Storage(start=0x0006d000, len=471040, verify=True)")
+    __test("device.Storage().writeblocks(115, bytearray(16))", -5)
+    __test("device.Storage().writeblocks(0, bytearray(16))", -22)
+    __test("str(device.Storage(prog_size=32))", "Storage(start=0x0006d000, len=471040, prog_size=32)")
+    __test("device.Storage(prog_size=48)", ValueError)
+    __test("device.Storage().ioctl(0x102, 0)", 0)
+    __test("device.Storage().ioctl(0x101, 0)", 0)
+    __test("device.Storage().readblocks(0, bytearray(16))", None)
+    __test("device.Storage().readblocks(0, bytearray(16), 16)", None)
+    __test("device.Storage().ioctl(0x100, 0)", 1)
+    __test("device.Storage().ioctl(0x101, 0)", 1)
+    __test("device.Storage().ioctl(0x102, 0)", 0)
+    __test("isinstance(os.listdir('/'), list)", True)
+    __test("isinstance(os.listdir('/'), list)", True)
+    __test("device.Storage().ioctl(0x100, 0) > 0", True)
+    __test("device.Blob('missing')", OSError)
+    __test("device.Blob.create('x' * 25, 16)", ValueError)
+
+    # A filesystem from an older layout may still cover the log store
+    try:
+        device.LogStore()
+        log_claimed = False
+    except OSError as e:
+        log_claimed = e.errno == errno.EPERM
+
+    if log_claimed:
+        __test("device.LogStore().append(b'test')", OSError)
+    else:
+        __test("isinstance(device.LogStore().append(b'test'), int)", True)
+        __test("device.LogStore().append(bytes(4089))", ValueError)
+        __test("device.LogStore().flush()", None)
 
 
 def display_module():
@@ -183,7 +220,40 @@ def display_module():
 
 
 def camera_module():
-    print("TODO camera module")
+    global camera
+    import camera
+
+    __test("camera.capture()", None)
+    __test("type(camera.read())", bytes)
+    __test("len(camera.read(16))", 16)
+    __test("camera.read(0)", ValueError)
+
+    # Reading the rest of the frame leaves nothing for read()
+    global camera_buffer
+    camera_buffer = bytearray(1024)
+    __test("isinstance(camera.read_into(camera_buffer), int)", True)
+    while camera.read_into(camera_buffer) > 0:
+        pass
+    __test("camera.read_into(camera_buffer)", 0)
+    __test("camera.read()", None)
+
+    __test("camera.output(320, 200, camera.RGB)", None)
+    __test("camera.output(640, 400, camera.JPEG, 10)", None)
+    __test("camera.output(641, 400, camera.JPEG)", ValueError)
+    __test("camera.output(640, 0, camera.JPEG)", ValueError)
+    __test("camera.output(640, 400, camera.JPEG, 0)", ValueError)
+    __test("camera.output(640, 400, camera.JPEG, 64)", ValueError)
+    __test("camera.output(640, 400, 'PNG')", ValueError)
+    __test("camera.output(640, 400, camera.JPEG, 4)", None)
+
+    __test("camera.zoom(0.5)", ValueError)
+    __test("camera.zoom(2)", None)
+    __test("camera.zoom(1)", None)
+
+    __test("camera.stream(bluetooth=False)", NotImplementedError)
+    __test("camera.streaming()", False)
+    __test("camera.stop()", None)
+    __test("camera.streaming()", False)
 
 
 def microphone_module():
@@ -228,6 +298,12 @@ def fpga_module():
     # Test read returns correct length
     __test("len(fpga.read(0x0001, 4))", 4)
 
+    # Test bulk reads beyond a single DMA transfer
+    __test("fpga.read_into(0x0001, bytearray(4))", None)
+    __test("fpga.read_into(0x0000, bytearray(1024))", None)
+    __test("fpga.read_into(0x0000, bytearray())", ValueError)
+    __test("fpga.read_into(0x0000, b'1234')", TypeError)
+
     # Test writes
     __test("fpga.write(0x0000, b'')", None)
     __test("fpga.write(0x0000, b'done')", None)
@@ -249,8 +325,27 @@ def bluetooth_module():
     time.sleep(0.1)
     __test(f"bluetooth.send(b'a' * {max_length})", None)
     time.sleep(0.1)
-    __test(f"bluetooth.send(b'a' * ({max_length} + 1))", ValueError)
+    __test(f"bluetooth.send(b'a' * ({max_length} + 1))", None)
+    time.sleep(0.1)
+    __test(f"bluetooth.send(b'a' * ({max_length} * 20))", None)
     __test("callable(bluetooth.receive_callback)", True)
+    __test("bluetooth.read(bytearray(16))", 0)
+    __test("bluetooth.read(b'')", TypeError)
+    __test("isinstance(bluetooth.rx_overflows(), int)", True)
+    # 256 when the larger MTU didn't fit in the RAM reserved for the SoftDevice
+    mtu = bluetooth.mtu()
+    __test("bluetooth.mtu() in (256, 512)", True)
+    __test("bluetooth.max_length() <= bluetooth.mtu() - 3", True)
+    __test("bluetooth.mtu(22)", ValueError)
+    __test(f"bluetooth.mtu({mtu} + 1)", ValueError)
+    __test("bluetooth.mtu(247)", None)
+    __test("bluetooth.mtu()", 247)
+    __test(f"bluetooth.mtu({mtu})", None)
+    __test("bluetooth.link_mode()", bluetooth.AUTO)
+    __test("bluetooth.link_mode(bluetooth.FAST)", None)
+    __test("bluetooth.link_mode()", bluetooth.FAST)
+    __test("bluetooth.link_mode('SLOW')", ValueError)
+    __test("bluetooth.link_mode(bluetooth.AUTO)", None)
 
 
 def time_module():
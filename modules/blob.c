@@ -0,0 +1,417 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+#include "blob.h"
+#include "monocle.h"
+#include "storage.h"
+#include "py/mperrno.h"
+#include "py/objstr.h"
+#include "py/runtime.h"
+
+// "BLOB" in the first word of the region marks the index as formatted
+#define BLOB_MAGIC (0x424F4C42)
+
+#define BLOB_INDEX_SIZE (4096)
+#define BLOB_DATA_START (MICROPY_HW_FLASH_BLOB_START + BLOB_INDEX_SIZE)
+#define BLOB_DATA_SIZE (MICROPY_HW_FLASH_BLOB_SIZE - BLOB_INDEX_SIZE)
+
+// The first slot holds the magic, the rest are entries until an erased one
+#define BLOB_SLOTS (BLOB_INDEX_SIZE / sizeof(blob_entry_t))
+#define BLOB_SLOTS_PER_READ (4)
+
+typedef struct blob_entry_t
+{
+    char name[BLOB_NAME_LENGTH];
+    uint32_t offset;
+    uint32_t length;
+} blob_entry_t;
+
+static bool blob_index_formatted(void)
+{
+    uint32_t magic;
+    monocle_flash_read((uint8_t *)&magic, MICROPY_HW_FLASH_BLOB_START,
+                       sizeof(magic));
+
+    return magic == BLOB_MAGIC;
+}
+
+/**
+ * @brief Raises EPERM while a filesystem spans the region. It may do so
+ *        without having written there yet, or with data that reads like an
+ *        index.
+ */
+static void blob_region_unclaimed(void)
+{
+    if (storage_overlaps(MICROPY_HW_FLASH_BLOB_START,
+                         MICROPY_HW_FLASH_BLOB_SIZE))
+    {
+        mp_raise_OSError(MP_EPERM);
+    }
+}
+
+static bool blob_region_blank(void)
+{
+    uint8_t buffer[128];
+
+    for (size_t i = 0; i < MICROPY_HW_FLASH_BLOB_SIZE; i += sizeof(buffer))
+    {
+        monocle_flash_read(buffer, MICROPY_HW_FLASH_BLOB_START + i,
+                           sizeof(buffer));
+
+        for (size_t j = 0; j < sizeof(buffer); j++)
+        {
+            if (buffer[j] != 0xFF)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Walks the index a few entries per read, calling back for each entry
+ *        up to the first erased slot.
+ * @returns The first erased slot, or BLOB_SLOTS if the index is full.
+ */
+static size_t blob_index_walk(void (*callback)(const blob_entry_t *entry,
+                                               void *context),
+                              void *context)
+{
+    blob_entry_t entries[BLOB_SLOTS_PER_READ];
+
+    for (size_t slot = 1; slot < BLOB_SLOTS; slot += BLOB_SLOTS_PER_READ)
+    {
+        size_t count = MIN(BLOB_SLOTS - slot, BLOB_SLOTS_PER_READ);
+
+        monocle_flash_read((uint8_t *)entries,
+                           MICROPY_HW_FLASH_BLOB_START +
+                               slot * sizeof(blob_entry_t),
+                           count * sizeof(blob_entry_t));
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if ((uint8_t)entries[i].name[0] == 0xFF)
+            {
+                return slot + i;
+            }
+
+            callback(&entries[i], context);
+        }
+    }
+
+    return BLOB_SLOTS;
+}
+
+typedef struct blob_search_t
+{
+    const char *name;
+    size_t name_length;
+    blob_t *blob;
+    bool found;
+} blob_search_t;
+
+static void blob_match(const blob_entry_t *entry, void *context)
+{
+    blob_search_t *search = context;
+
+    if (memcmp(entry->name, search->name, search->name_length) == 0 &&
+        (search->name_length == BLOB_NAME_LENGTH ||
+         entry->name[search->name_length] == '\0'))
+    {
+        // Keep looking, as a blob created again later replaces this one
+        search->blob->address = BLOB_DATA_START + entry->offset;
+        search->blob->length = entry->length;
+        search->found = true;
+    }
+}
+
+bool blob_find(const char *name, size_t name_length, blob_t *blob)
+{
+    if (name_length == 0 || name_length > BLOB_NAME_LENGTH ||
+        !blob_index_formatted())
+    {
+        return false;
+    }
+
+    blob_search_t search = {
+        .name = name,
+        .name_length = name_length,
+        .blob = blob,
+        .found = false,
+    };
+    blob_index_walk(blob_match, &search);
+
+    return search.found;
+}
+
+void blob_read(const blob_t *blob, size_t offset, uint8_t *buffer,
+               size_t length)
+{
+    monocle_flash_read(buffer, blob->address + offset, length);
+}
+
+static void blob_data_end(const blob_entry_t *entry, void *context)
+{
+    uint32_t *end = context;
+    *end = MAX(*end, entry->offset + entry->length);
+}
+
+const struct _mp_obj_type_t device_blob_type;
+
+typedef struct _blob_obj_t
+{
+    mp_obj_base_t base;
+    blob_t blob;
+} blob_obj_t;
+
+STATIC mp_obj_t blob_new(const blob_t *blob)
+{
+    blob_obj_t *self = mp_obj_malloc(blob_obj_t, &device_blob_type);
+    self->blob = *blob;
+    return MP_OBJ_FROM_PTR(self);
+}
+
+STATIC mp_obj_t blob_make_new(const mp_obj_type_t *type, size_t n_args,
+                              size_t n_kw, const mp_obj_t *args)
+{
+    mp_arg_check_num(n_args, n_kw, 1, 1, false);
+
+    blob_region_unclaimed();
+
+    size_t name_length;
+    const char *name = mp_obj_str_get_data(args[0], &name_length);
+
+    blob_t blob;
+    if (!blob_find(name, name_length, &blob))
+    {
+        mp_raise_OSError(MP_ENOENT);
+    }
+
+    return blob_new(&blob);
+}
+
+STATIC void blob_print(const mp_print_t *print, mp_obj_t self_in,
+                       mp_print_kind_t kind)
+{
+    blob_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_printf(print, "Blob(address=0x%08x, length=%u)", self->blob.address,
+              self->blob.length);
+}
+
+STATIC mp_obj_t blob_unary_op(mp_unary_op_t op, mp_obj_t self_in)
+{
+    blob_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    switch (op)
+    {
+    case MP_UNARY_OP_LEN:
+        return MP_OBJ_NEW_SMALL_INT(self->blob.length);
+
+    default:
+        return MP_OBJ_NULL;
+    }
+}
+
+STATIC mp_obj_t blob_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value)
+{
+    blob_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    if (value != MP_OBJ_SENTINEL)
+    {
+        // Blobs are read-only
+        return MP_OBJ_NULL;
+    }
+
+    if (mp_obj_is_type(index, &mp_type_slice))
+    {
+        mp_bound_slice_t slice;
+        if (!mp_seq_get_fast_slice_indexes(self->blob.length, index, &slice))
+        {
+            mp_raise_NotImplementedError(
+                MP_ERROR_TEXT("only slices with step=1 (aka None) are supported"));
+        }
+
+        vstr_t vstr;
+        vstr_init_len(&vstr, MAX(slice.stop, slice.start) - slice.start);
+        blob_read(&self->blob, slice.start, (uint8_t *)vstr.buf, vstr.len);
+        return mp_obj_new_bytes_from_vstr(&vstr);
+    }
+
+    size_t offset = mp_get_index(self->base.type, self->blob.length, index,
+                                 false);
+    uint8_t byte;
+    blob_read(&self->blob, offset, &byte, 1);
+    return MP_OBJ_NEW_SMALL_INT(byte);
+}
+
+STATIC mp_obj_t blob_read_into(mp_obj_t self_in, mp_obj_t offset_in,
+                               mp_obj_t buf)
+{
+    blob_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    mp_buffer_info_t buffer;
+    mp_get_buffer_raise(buf, &buffer, MP_BUFFER_WRITE);
+
+    mp_int_t offset = mp_obj_get_int(offset_in);
+
+    if (offset < 0 || offset + buffer.len > self->blob.length)
+    {
+        mp_raise_ValueError(
+            MP_ERROR_TEXT("offset + buffer length cannot exceed the blob"));
+    }
+
+    blob_read(&self->blob, offset, buffer.buf, buffer.len);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(blob_read_into_obj, blob_read_into);
+
+STATIC mp_obj_t blob_write(mp_obj_t self_in, mp_obj_t offset_in,
+                           mp_obj_t data)
+{
+    blob_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    mp_buffer_info_t buffer;
+    mp_get_buffer_raise(data, &buffer, MP_BUFFER_READ);
+
+    mp_int_t offset = mp_obj_get_int(offset_in);
+
+    if (offset < 0 || offset + buffer.len > self->blob.length)
+    {
+        mp_raise_ValueError(
+            MP_ERROR_TEXT("offset + buffer length cannot exceed the blob"));
+    }
+
+    blob_region_unclaimed();
+
+    // Blobs are programmed once, straight after create()
+    monocle_flash_write(buffer.buf, self->blob.address + offset, buffer.len);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(blob_write_obj, blob_write);
+
+STATIC mp_obj_t blob_create(mp_obj_t name_in, mp_obj_t length_in)
+{
+    size_t name_length;
+    const char *name = mp_obj_str_get_data(name_in, &name_length);
+    mp_int_t length = mp_obj_get_int(length_in);
+
+    if (name_length == 0 || name_length > BLOB_NAME_LENGTH)
+    {
+        mp_raise_ValueError(
+            MP_ERROR_TEXT("name must be between 1 and 24 characters"));
+    }
+
+    if (length < 0)
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT("length cannot be less than zero"));
+    }
+
+    blob_region_unclaimed();
+
+    if (!blob_index_formatted())
+    {
+        // Never take over a region that a filesystem may still be using
+        if (!blob_region_blank())
+        {
+            mp_raise_OSError(MP_EPERM);
+        }
+
+        uint32_t magic = BLOB_MAGIC;
+        monocle_flash_write((const uint8_t *)&magic,
+                            MICROPY_HW_FLASH_BLOB_START, sizeof(magic));
+    }
+
+    uint32_t end = 0;
+    size_t slot = blob_index_walk(blob_data_end, &end);
+
+    // Page aligned, so that each blob starts with a whole page program
+    uint32_t offset = (end + 0xFF) & ~0xFF;
+
+    if (slot == BLOB_SLOTS || offset + length > BLOB_DATA_SIZE)
+    {
+        mp_raise_OSError(MP_ENOSPC);
+    }
+
+    blob_entry_t entry = {
+        .offset = offset,
+        .length = length,
+    };
+    memcpy(entry.name, name, name_length);
+
+    monocle_flash_write((const uint8_t *)&entry,
+                        MICROPY_HW_FLASH_BLOB_START +
+                            slot * sizeof(blob_entry_t),
+                        sizeof(entry));
+
+    blob_t blob = {
+        .address = BLOB_DATA_START + offset,
+        .length = length,
+    };
+    return blob_new(&blob);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(blob_create_fun_obj, blob_create);
+STATIC MP_DEFINE_CONST_STATICMETHOD_OBJ(blob_create_obj,
+                                        MP_ROM_PTR(&blob_create_fun_obj));
+
+STATIC mp_obj_t blob_erase(void)
+{
+    blob_region_unclaimed();
+
+    if (!blob_index_formatted() && !blob_region_blank())
+    {
+        mp_raise_OSError(MP_EPERM);
+    }
+
+    monocle_flash_erase(MICROPY_HW_FLASH_BLOB_START,
+                        MICROPY_HW_FLASH_BLOB_SIZE);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(blob_erase_fun_obj, blob_erase);
+STATIC MP_DEFINE_CONST_STATICMETHOD_OBJ(blob_erase_obj,
+                                        MP_ROM_PTR(&blob_erase_fun_obj));
+
+STATIC const mp_rom_map_elem_t blob_locals_dict_table[] = {
+
+    {MP_ROM_QSTR(MP_QSTR_read_into), MP_ROM_PTR(&blob_read_into_obj)},
+    {MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&blob_write_obj)},
+    {MP_ROM_QSTR(MP_QSTR_create), MP_ROM_PTR(&blob_create_obj)},
+    {MP_ROM_QSTR(MP_QSTR_erase), MP_ROM_PTR(&blob_erase_obj)},
+};
+STATIC MP_DEFINE_CONST_DICT(blob_locals_dict, blob_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    device_blob_type,
+    MP_QSTR_Blob,
+    MP_TYPE_FLAG_NONE,
+    make_new, blob_make_new,
+    print, blob_print,
+    unary_op, blob_unary_op,
+    subscr, blob_subscr,
+    locals_dict, &blob_locals_dict);
@@ -22,21 +22,158 @@
  * PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include "bluetooth.h"
 #include "mphalport.h"
 #include "py/runtime.h"
 #include "py/objarray.h"
+#include <string.h>
 
 static mp_obj_t receive_callback = mp_const_none;
 
+// Filled from the SoftDevice interrupt, emptied by read() or the callback
+static struct data_rx_buffer_t
+{
+    uint8_t buffer[MICROPY_HW_BLE_DATA_RX_BUFFER_SIZE];
+    uint16_t head;
+    uint16_t tail;
+    bool callback_scheduled;
+    bool claimed;
+    uint32_t overflows;
+} data_rx = {
+    .buffer = "",
+    .head = 0,
+    .tail = 0,
+    .callback_scheduled = false,
+    .claimed = false,
+    .overflows = 0,
+};
+
+size_t bluetooth_data_available(void)
+{
+    return (data_rx.head - data_rx.tail + sizeof(data_rx.buffer)) %
+           sizeof(data_rx.buffer);
+}
+
+size_t bluetooth_data_read(uint8_t *bytes, size_t len)
+{
+    size_t available = bluetooth_data_available();
+
+    if (len > available)
+    {
+        len = available;
+    }
+
+    size_t first = sizeof(data_rx.buffer) - data_rx.tail;
+
+    if (first > len)
+    {
+        first = len;
+    }
+
+    memcpy(bytes, &data_rx.buffer[data_rx.tail], first);
+    memcpy(bytes + first, data_rx.buffer, len - first);
+
+    data_rx.tail = (data_rx.tail + len) % sizeof(data_rx.buffer);
+
+    return len;
+}
+
+void bluetooth_data_flush(void)
+{
+    data_rx.tail = data_rx.head;
+}
+
+void bluetooth_data_reset(void)
+{
+    // The scheduled callback, and the callback itself, went with the old heap
+    receive_callback = mp_const_none;
+    data_rx.head = 0;
+    data_rx.tail = 0;
+    data_rx.callback_scheduled = false;
+    data_rx.claimed = false;
+}
+
+void bluetooth_data_claim(bool claim)
+{
+    // While claimed, read() and the receive callback see nothing
+    data_rx.claimed = claim;
+}
+
+STATIC mp_obj_t bluetooth_receive_dispatch(mp_obj_t unused)
+{
+    (void)unused;
+
+    // Writes arriving from here on schedule another call
+    data_rx.callback_scheduled = false;
+
+    size_t len = bluetooth_data_available();
+
+    // Nothing to do if read() already took everything
+    if (len == 0 || receive_callback == mp_const_none || data_rx.claimed)
+    {
+        return mp_const_none;
+    }
+
+    // Read straight into the bytes object, rather than through a copy
+    vstr_t vstr;
+    vstr_init_len(&vstr, len);
+    bluetooth_data_read((uint8_t *)vstr.buf, len);
+
+    mp_call_function_1(receive_callback, mp_obj_new_bytes_from_vstr(&vstr));
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(bluetooth_receive_dispatch_obj,
+                                 bluetooth_receive_dispatch);
+
 void bluetooth_receive_callback_handler(const uint8_t *bytes, size_t len)
 {
-    if (receive_callback != mp_const_none)
+    // Whole writes are dropped, one byte is kept free to tell full from empty
+    if (bluetooth_data_available() + len >= sizeof(data_rx.buffer))
+    {
+        data_rx.overflows++;
+        return;
+    }
+
+    size_t first = sizeof(data_rx.buffer) - data_rx.head;
+
+    if (first > len)
     {
-        mp_obj_t array = mp_obj_new_bytes(bytes, len);
-        mp_sched_schedule(receive_callback, array);
+        first = len;
+    }
+
+    memcpy(&data_rx.buffer[data_rx.head], bytes, first);
+    memcpy(data_rx.buffer, bytes + first, len - first);
+
+    data_rx.head = (data_rx.head + len) % sizeof(data_rx.buffer);
+
+    // One callback delivers everything received until it runs
+    if (receive_callback != mp_const_none &&
+        !data_rx.callback_scheduled &&
+        !data_rx.claimed)
+    {
+        data_rx.callback_scheduled =
+            mp_sched_schedule(MP_OBJ_FROM_PTR(&bluetooth_receive_dispatch_obj),
+                              mp_const_none);
     }
 }
 
+// Called from the SoftDevice interrupt once notifications have gone out
+static void (*data_sent_handler)(void) = NULL;
+
+void bluetooth_data_sent_handler(void)
+{
+    if (data_sent_handler)
+    {
+        data_sent_handler();
+    }
+}
+
+void bluetooth_data_sent_notify(void (*handler)(void))
+{
+    data_sent_handler = handler;
+}
+
 static mp_obj_t bluetooth_send(mp_obj_t buffer_in)
 {
     if (!ble_are_tx_notifications_enabled(DATA_TX))
@@ -49,16 +186,11 @@ static mp_obj_t bluetooth_send(mp_obj_t buffer_in)
     mp_buffer_info_t array;
     mp_get_buffer_raise(buffer_in, &array, MP_BUFFER_READ);
 
-    if (array.len > ble_get_max_payload_size())
-    {
-        mp_raise_msg(&mp_type_ValueError,
-                     MP_ERROR_TEXT("input buffer is too large"));
-    }
-
+    // Larger buffers are queued as several notifications of max_length()
     if (ble_send_raw_data(array.buf, array.len))
     {
         mp_raise_msg(&mp_type_OSError,
-                     MP_ERROR_TEXT("raw data service is busy"));
+                     MP_ERROR_TEXT("disconnected while sending"));
     }
 
     return mp_const_none;
@@ -80,6 +212,16 @@ static mp_obj_t bluetooth_receive_callback(size_t n_args, const mp_obj_t *args)
 
     receive_callback = args[0];
 
+    // Deliver anything which arrived before the callback was set
+    if (receive_callback != mp_const_none &&
+        bluetooth_data_available() > 0 &&
+        !data_rx.callback_scheduled)
+    {
+        data_rx.callback_scheduled =
+            mp_sched_schedule(MP_OBJ_FROM_PTR(&bluetooth_receive_dispatch_obj),
+                              mp_const_none);
+    }
+
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(bluetooth_receive_callback_obj, 0, 1, bluetooth_receive_callback);
@@ -98,11 +240,88 @@ STATIC mp_obj_t bluetooth_max_length(void)
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(bluetooth_max_length_obj, bluetooth_max_length);
 
+STATIC mp_obj_t bluetooth_read(mp_obj_t buffer_in)
+{
+    mp_buffer_info_t array;
+    mp_get_buffer_raise(buffer_in, &array, MP_BUFFER_WRITE);
+
+    if (data_rx.claimed)
+    {
+        return MP_OBJ_NEW_SMALL_INT(0);
+    }
+
+    return mp_obj_new_int(bluetooth_data_read(array.buf, array.len));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(bluetooth_read_obj, bluetooth_read);
+
+STATIC mp_obj_t bluetooth_rx_overflows(void)
+{
+    return mp_obj_new_int_from_uint(data_rx.overflows);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(bluetooth_rx_overflows_obj, bluetooth_rx_overflows);
+
+STATIC mp_obj_t bluetooth_mtu(size_t n_args, const mp_obj_t *args)
+{
+    if (n_args == 0)
+    {
+        return mp_obj_new_int(ble_get_preferred_mtu());
+    }
+
+    if (ble_set_preferred_mtu(mp_obj_get_int(args[0])))
+    {
+        mp_raise_msg_varg(&mp_type_ValueError,
+                          MP_ERROR_TEXT("mtu must be between 23 and %d"),
+                          ble_get_configured_mtu());
+    }
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(bluetooth_mtu_obj, 0, 1, bluetooth_mtu);
+
+STATIC mp_obj_t bluetooth_link_mode(size_t n_args, const mp_obj_t *args)
+{
+    static const qstr modes[] = {
+        [BLE_LINK_AUTO] = MP_QSTR_AUTO,
+        [BLE_LINK_FAST] = MP_QSTR_FAST,
+        [BLE_LINK_RELAXED] = MP_QSTR_RELAXED,
+    };
+
+    if (n_args == 0)
+    {
+        return MP_OBJ_NEW_QSTR(modes[ble_get_link_mode()]);
+    }
+
+    qstr mode = mp_obj_str_get_qstr(args[0]);
+
+    for (size_t i = 0; i < MP_ARRAY_SIZE(modes); i++)
+    {
+        if (mode == modes[i])
+        {
+            ble_set_link_mode(i);
+            return mp_const_none;
+        }
+    }
+
+    mp_raise_ValueError(
+        MP_ERROR_TEXT("must be bluetooth.AUTO, bluetooth.FAST or bluetooth.RELAXED"));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(bluetooth_link_mode_obj, 0, 1, bluetooth_link_mode);
+
+MP_DECLARE_CONST_FUN_OBJ_0(bluetooth_file_server_obj);
+
 STATIC const mp_rom_map_elem_t bluetooth_module_globals_table[] = {
     {MP_ROM_QSTR(MP_QSTR_send), MP_ROM_PTR(&bluetooth_send_obj)},
     {MP_ROM_QSTR(MP_QSTR_receive_callback), MP_ROM_PTR(&bluetooth_receive_callback_obj)},
+    {MP_ROM_QSTR(MP_QSTR_read), MP_ROM_PTR(&bluetooth_read_obj)},
+    {MP_ROM_QSTR(MP_QSTR_rx_overflows), MP_ROM_PTR(&bluetooth_rx_overflows_obj)},
+    {MP_ROM_QSTR(MP_QSTR_file_server), MP_ROM_PTR(&bluetooth_file_server_obj)},
     {MP_ROM_QSTR(MP_QSTR_connected), MP_ROM_PTR(&bluetooth_connected_obj)},
     {MP_ROM_QSTR(MP_QSTR_max_length), MP_ROM_PTR(&bluetooth_max_length_obj)},
+    {MP_ROM_QSTR(MP_QSTR_mtu), MP_ROM_PTR(&bluetooth_mtu_obj)},
+    {MP_ROM_QSTR(MP_QSTR_link_mode), MP_ROM_PTR(&bluetooth_link_mode_obj)},
+    {MP_ROM_QSTR(MP_QSTR_AUTO), MP_ROM_QSTR(MP_QSTR_AUTO)},
+    {MP_ROM_QSTR(MP_QSTR_FAST), MP_ROM_QSTR(MP_QSTR_FAST)},
+    {MP_ROM_QSTR(MP_QSTR_RELAXED), MP_ROM_QSTR(MP_QSTR_RELAXED)},
 };
 STATIC MP_DEFINE_CONST_DICT(bluetooth_module_globals, bluetooth_module_globals_table);
 
@@ -24,7 +24,22 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 void bluetooth_receive_callback_handler(const uint8_t *bytes, size_t len);
+
+size_t bluetooth_data_available(void);
+
+size_t bluetooth_data_read(uint8_t *bytes, size_t len);
+
+void bluetooth_data_flush(void);
+
+void bluetooth_data_reset(void);
+
+void bluetooth_data_claim(bool claim);
+
+void bluetooth_data_sent_handler(void);
+
+void bluetooth_data_sent_notify(void (*handler)(void));
@@ -22,29 +22,812 @@
  * PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <string.h>
+#include "bluetooth.h"
+#include "camera.h"
+#include "monocle.h"
+#include "mphalport.h"
 #include "nrf_gpio.h"
 #include "nrfx_systick.h"
+#include "py/mperrno.h"
 #include "py/runtime.h"
 
+// The FPGA reports this status while a capture is in progress
+#define CAMERA_STATUS_CAPTURING 0x32
+
+// Frames are captured well within this, even at the largest resolution
+#define CAMERA_CAPTURE_TIMEOUT_MS 1000
+
+// The camera is left asleep by camera_power_up()
+static bool camera_awake = false;
+
 STATIC mp_obj_t camera_sleep(void)
 {
     nrf_gpio_pin_write(CAMERA_SLEEP_PIN, true);
+    camera_awake = false;
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(camera_sleep_obj, camera_sleep);
 
+// Bringing the camera up takes over 30ms, so it's left until it's needed
+static bool camera_ready = false;
+
+static bool camera_bring_up(void)
+{
+    if (!camera_ready)
+    {
+        camera_ready = camera_power_up();
+
+        if (camera_ready)
+        {
+            monocle_boot_trace("camera");
+        }
+    }
+
+    return camera_ready;
+}
+
+STATIC mp_obj_t camera_init(void)
+{
+    if (!camera_bring_up())
+    {
+        mp_raise_OSError(MP_ENODEV);
+    }
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(camera_init_obj, camera_init);
+
+STATIC mp_obj_t camera_prefetch_run(mp_obj_t unused)
+{
+    // Errors are left for the first real use to report
+    camera_bring_up();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(camera_prefetch_obj, camera_prefetch_run);
+
+void camera_prefetch(void)
+{
+    if (!camera_ready)
+    {
+        mp_sched_schedule(MP_OBJ_FROM_PTR(&camera_prefetch_obj), mp_const_none);
+    }
+}
+
 STATIC mp_obj_t camera_wake(void)
 {
+    camera_init();
+
     nrf_gpio_pin_write(CAMERA_SLEEP_PIN, false);
     nrfx_systick_delay_ms(100);
+    camera_awake = true;
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(camera_wake_obj, camera_wake);
 
+/**
+ * The last value written to each of the registers which output() and zoom()
+ * change. Every other register is written straight through.
+ */
+static struct camera_register_t
+{
+    uint16_t address;
+    uint8_t value;
+    bool known;
+} camera_registers[] = {
+    {0x3800}, // Timing X start address MSB
+    {0x3801}, // Timing X start address LSB
+    {0x3802}, // Timing Y start address MSB
+    {0x3803}, // Timing Y start address LSB
+    {0x3804}, // Timing X end address MSB
+    {0x3805}, // Timing X end address LSB
+    {0x3806}, // Timing Y end address MSB
+    {0x3807}, // Timing Y end address LSB
+    {0x3808}, // Timing X output size MSB
+    {0x3809}, // Timing X output size LSB
+    {0x380a}, // Timing Y output size MSB
+    {0x380b}, // Timing Y output size LSB
+    {0x3821}, // Timing control with the JPEG enable
+    {0x4300}, // Format control
+    {0x4407}, // JPEG quantization scale
+    {0x4602}, // JPEG output width MSB
+    {0x4603}, // JPEG output width LSB
+    {0x501f}, // ISP format control
+};
+
+static struct camera_register_t *camera_register(uint16_t address)
+{
+    for (size_t i = 0; i < MP_ARRAY_SIZE(camera_registers); i++)
+    {
+        if (camera_registers[i].address == address)
+        {
+            return &camera_registers[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool camera_register_changes(uint16_t address, uint8_t value)
+{
+    struct camera_register_t *reg = camera_register(address);
+    return reg == NULL || !reg->known || reg->value != value;
+}
+
+bool camera_write_registers(const camera_config_t *table, size_t count)
+{
+    for (size_t start = 0; start < count;)
+    {
+        // Group entries with consecutive addresses into one run
+        size_t length = 1;
+
+        while (start + length < count &&
+               length < I2C_MAX_BURST_LENGTH &&
+               table[start + length].address == table[start].address + length)
+        {
+            length++;
+        }
+
+        // Only the part of the run between the first and last change is sent
+        size_t first = start;
+        size_t end = start + length;
+
+        while (first < end &&
+               !camera_register_changes(table[first].address,
+                                        table[first].value))
+        {
+            first++;
+        }
+
+        while (end > first &&
+               !camera_register_changes(table[end - 1].address,
+                                        table[end - 1].value))
+        {
+            end--;
+        }
+
+        if (first < end)
+        {
+            uint8_t values[I2C_MAX_BURST_LENGTH];
+
+            for (size_t i = first; i < end; i++)
+            {
+                values[i - first] = table[i].value;
+            }
+
+            i2c_response_t resp = monocle_i2c_write_burst(CAMERA_I2C_ADDRESS,
+                                                          table[first].address,
+                                                          values,
+                                                          end - first);
+
+            for (size_t i = first; i < end; i++)
+            {
+                struct camera_register_t *reg = camera_register(table[i].address);
+
+                if (reg != NULL)
+                {
+                    reg->value = table[i].value;
+                    reg->known = !resp.fail;
+                }
+            }
+
+            if (resp.fail)
+            {
+                return false;
+            }
+        }
+
+        start += length;
+    }
+
+    return true;
+}
+
+// Frame id, offset, total length and CRC, big endian, ahead of every piece
+#define CAMERA_STREAM_HEADER_SIZE 12
+
+typedef enum camera_buffer_state_t
+{
+    CAMERA_BUFFER_FREE,
+    CAMERA_BUFFER_READING,
+    CAMERA_BUFFER_READY,
+} camera_buffer_state_t;
+
+/**
+ * Streams a frame over the data service without Python in the loop. Reads
+ * from the FPGA into one buffer are queued on the SPI bus while the other
+ * waits for room in the notification queue. Every step is scheduled from the
+ * SPI and SoftDevice interrupts, and runs between Python bytecodes.
+ */
+static struct camera_stream_t
+{
+    volatile bool active;
+    volatile bool scheduled;
+    volatile bool reading;
+    volatile bool aborted;
+    uint16_t frame_id;
+    size_t payload;
+    volatile size_t available;
+    volatile bool exhausted;
+    uint32_t read_offset;
+    uint32_t total;
+    uint16_t crc;
+    struct
+    {
+        volatile camera_buffer_state_t state;
+        uint32_t offset;
+        size_t length;
+        uint8_t data[CAMERA_STREAM_HEADER_SIZE + 512];
+    } buffers[2];
+    size_t fill;
+    size_t send;
+    uint8_t available_cmd[2];
+    uint8_t available_bytes[2];
+    uint8_t data_cmd[2];
+    spi_transaction_t transaction;
+} camera_stream = {
+    .available_cmd = {0x10, 0x06},
+    .data_cmd = {0x10, 0x07},
+};
+
+STATIC mp_obj_t camera_stream_pump(mp_obj_t unused);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(camera_stream_pump_obj, camera_stream_pump);
+
+static void camera_stream_schedule(void)
+{
+    if (camera_stream.active && !camera_stream.scheduled)
+    {
+        camera_stream.scheduled =
+            mp_sched_schedule(MP_OBJ_FROM_PTR(&camera_stream_pump_obj),
+                              mp_const_none);
+
+        // With the queue full, nothing would ever pick the stream up again.
+        // Any read still in flight is waited for before the next stream
+        if (!camera_stream.scheduled)
+        {
+            camera_stream.active = false;
+            camera_stream.aborted = true;
+            bluetooth_data_sent_notify(NULL);
+        }
+    }
+}
+
+// Stops the stream, and waits for a read in flight so that the transaction
+// can be queued again
+static void camera_stream_stop(void)
+{
+    camera_stream.active = false;
+    bluetooth_data_sent_notify(NULL);
+
+    if (camera_stream.reading)
+    {
+        monocle_spi_wait(&camera_stream.transaction);
+        camera_stream.reading = false;
+    }
+}
+
+void camera_stream_reset(void)
+{
+    camera_stream_stop();
+
+    // The scheduler queue is emptied on soft reset
+    camera_stream.scheduled = false;
+    camera_stream.aborted = false;
+}
+
+static void camera_stream_available_read(spi_transaction_t *transaction)
+{
+    size_t available = camera_stream.available_bytes[0] << 8 |
+                       camera_stream.available_bytes[1];
+
+    // Below the 65535 the FPGA saturates at, this is the whole frame
+    if (camera_stream.read_offset == 0 && available < 0xFFFF)
+    {
+        camera_stream.total = available;
+    }
+
+    camera_stream.available = available;
+    camera_stream.exhausted = available == 0;
+    camera_stream.reading = false;
+    camera_stream_schedule();
+}
+
+static void camera_stream_data_read(spi_transaction_t *transaction)
+{
+    camera_stream.buffers[(size_t)transaction->context].state =
+        CAMERA_BUFFER_READY;
+    camera_stream.reading = false;
+    camera_stream_schedule();
+}
+
+static void camera_stream_header(uint8_t *header, uint32_t offset,
+                                 uint16_t crc)
+{
+    header[0] = camera_stream.frame_id >> 8;
+    header[1] = camera_stream.frame_id;
+    header[2] = offset >> 24;
+    header[3] = offset >> 16;
+    header[4] = offset >> 8;
+    header[5] = offset;
+    header[6] = camera_stream.total >> 24;
+    header[7] = camera_stream.total >> 16;
+    header[8] = camera_stream.total >> 8;
+    header[9] = camera_stream.total;
+    header[10] = crc >> 8;
+    header[11] = crc;
+}
+
+static void camera_stream_start_read(void)
+{
+    camera_stream.reading = true;
+
+    if (camera_stream.available == 0)
+    {
+        camera_stream.transaction = (spi_transaction_t){
+            .device = FPGA,
+            .tx_buffer = camera_stream.available_cmd,
+            .tx_length = sizeof(camera_stream.available_cmd),
+            .rx_buffer = camera_stream.available_bytes,
+            .rx_length = sizeof(camera_stream.available_bytes),
+            .callback = camera_stream_available_read,
+        };
+        monocle_spi_queue(&camera_stream.transaction);
+        return;
+    }
+
+    size_t fill = camera_stream.fill;
+    size_t length = MIN(camera_stream.available, camera_stream.payload);
+
+    camera_stream.buffers[fill].state = CAMERA_BUFFER_READING;
+    camera_stream.buffers[fill].offset = camera_stream.read_offset;
+    camera_stream.buffers[fill].length = length;
+    camera_stream.available -= length;
+    camera_stream.read_offset += length;
+    camera_stream.fill = (fill + 1) % MP_ARRAY_SIZE(camera_stream.buffers);
+
+    camera_stream.transaction = (spi_transaction_t){
+        .device = FPGA,
+        .tx_buffer = camera_stream.data_cmd,
+        .tx_length = sizeof(camera_stream.data_cmd),
+        .rx_buffer = camera_stream.buffers[fill].data +
+                     CAMERA_STREAM_HEADER_SIZE,
+        .rx_length = length,
+        .callback = camera_stream_data_read,
+        .context = (void *)fill,
+    };
+    monocle_spi_queue(&camera_stream.transaction);
+}
+
+STATIC mp_obj_t camera_stream_pump(mp_obj_t unused)
+{
+    (void)unused;
+
+    camera_stream.scheduled = false;
+
+    if (!camera_stream.active)
+    {
+        return mp_const_none;
+    }
+
+    // Pieces go out in the order they were read
+    while (camera_stream.buffers[camera_stream.send].state ==
+           CAMERA_BUFFER_READY)
+    {
+        size_t send = camera_stream.send;
+        uint8_t *payload = camera_stream.buffers[send].data +
+                           CAMERA_STREAM_HEADER_SIZE;
+        size_t length = camera_stream.buffers[send].length;
+
+        camera_stream_header(camera_stream.buffers[send].data,
+                             camera_stream.buffers[send].offset,
+                             monocle_crc16(0xFFFF, payload, length));
+
+        if (ble_send_raw_data_now(camera_stream.buffers[send].data,
+                                  CAMERA_STREAM_HEADER_SIZE + length))
+        {
+            break;
+        }
+
+        camera_stream.crc = monocle_crc16(camera_stream.crc, payload, length);
+        camera_stream.buffers[send].state = CAMERA_BUFFER_FREE;
+        camera_stream.send = (send + 1) % MP_ARRAY_SIZE(camera_stream.buffers);
+    }
+
+    if (!ble_are_tx_notifications_enabled(DATA_TX))
+    {
+        camera_stream_stop();
+        camera_sleep();
+        return mp_const_none;
+    }
+
+    if (camera_stream.reading)
+    {
+        return mp_const_none;
+    }
+
+    if (!camera_stream.exhausted)
+    {
+        if (camera_stream.available == 0 ||
+            camera_stream.buffers[camera_stream.fill].state ==
+                CAMERA_BUFFER_FREE)
+        {
+            camera_stream_start_read();
+        }
+
+        return mp_const_none;
+    }
+
+    // Once everything is sent, an empty piece gives the length and the CRC
+    // of the whole frame
+    if (camera_stream.buffers[camera_stream.send].state == CAMERA_BUFFER_FREE)
+    {
+        uint8_t header[CAMERA_STREAM_HEADER_SIZE];
+        camera_stream.total = camera_stream.read_offset;
+        camera_stream_header(header, camera_stream.read_offset,
+                             camera_stream.crc);
+
+        if (!ble_send_raw_data_now(header, sizeof(header)))
+        {
+            camera_stream.active = false;
+            bluetooth_data_sent_notify(NULL);
+            camera_sleep();
+        }
+    }
+
+    return mp_const_none;
+}
+
+STATIC mp_obj_t camera_stream_start(void)
+{
+    if (camera_stream.active)
+    {
+        mp_raise_OSError(MP_EBUSY);
+    }
+
+    if (!ble_are_tx_notifications_enabled(DATA_TX))
+    {
+        mp_raise_msg(&mp_type_OSError,
+                     MP_ERROR_TEXT(
+                         "notifications are not enabled on the data service"));
+    }
+
+    size_t max_length = ble_get_max_payload_size();
+
+    if (max_length <= CAMERA_STREAM_HEADER_SIZE)
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT("bluetooth MTU is too small"));
+    }
+
+    // A stream which was stopped may still have a read in flight
+    camera_stream_stop();
+    camera_stream.aborted = false;
+
+    camera_stream.frame_id++;
+    camera_stream.payload = MIN(max_length - CAMERA_STREAM_HEADER_SIZE,
+                                sizeof(camera_stream.buffers[0].data) -
+                                    CAMERA_STREAM_HEADER_SIZE);
+    camera_stream.available = 0;
+    camera_stream.exhausted = false;
+    camera_stream.reading = false;
+    camera_stream.read_offset = 0;
+    camera_stream.total = 0;
+    camera_stream.crc = 0xFFFF;
+    camera_stream.fill = 0;
+    camera_stream.send = 0;
+    camera_stream.buffers[0].state = CAMERA_BUFFER_FREE;
+    camera_stream.buffers[1].state = CAMERA_BUFFER_FREE;
+    camera_stream.active = true;
+
+    bluetooth_data_sent_notify(camera_stream_schedule);
+    camera_stream_schedule();
+
+    return MP_OBJ_NEW_SMALL_INT(camera_stream.frame_id);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(camera_stream_start_obj, camera_stream_start);
+
+STATIC mp_obj_t camera_streaming(void)
+{
+    // Reported once, for a stream which couldn't be scheduled any more
+    if (camera_stream.aborted)
+    {
+        camera_stream_stop();
+        camera_stream.aborted = false;
+        camera_sleep();
+        mp_raise_OSError(MP_EIO);
+    }
+
+    return mp_obj_new_bool(camera_stream.active);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(camera_streaming_obj, camera_streaming);
+
+STATIC mp_obj_t camera_stream_cancel(void)
+{
+    camera_stream_stop();
+    camera_stream.aborted = false;
+    camera_sleep();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(camera_stream_cancel_obj, camera_stream_cancel);
+
+STATIC mp_obj_t camera_capture(void)
+{
+    if (camera_stream.active)
+    {
+        mp_raise_OSError(MP_EBUSY);
+    }
+
+    // A failed capture leaves the camera as it found it
+    bool was_awake = camera_awake;
+
+    camera_wake();
+
+    uint8_t capture_cmd[] = {0x10, 0x03};
+    monocle_spi_write(FPGA, capture_cmd, sizeof(capture_cmd), false);
+
+    uint32_t start = mp_hal_ticks_ms();
+    uint8_t status;
+
+    // Sleeps in between status reads. The FPGA interrupt, or the next tick,
+    // wakes it to check again
+    while (true)
+    {
+        monocle_fpga_read(0x1000, &status, sizeof(status));
+
+        if (status != CAMERA_STATUS_CAPTURING)
+        {
+            break;
+        }
+
+        if (mp_hal_ticks_ms() - start > CAMERA_CAPTURE_TIMEOUT_MS)
+        {
+            if (!was_awake)
+            {
+                camera_sleep();
+            }
+
+            mp_raise_OSError(MP_ETIMEDOUT);
+        }
+
+        MICROPY_EVENT_POLL_HOOK;
+    }
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(camera_capture_obj, camera_capture);
+
+STATIC mp_obj_t camera_read_into(mp_obj_t buffer_in)
+{
+    if (camera_stream.active)
+    {
+        mp_raise_OSError(MP_EBUSY);
+    }
+
+    mp_buffer_info_t buffer;
+    mp_get_buffer_raise(buffer_in, &buffer, MP_BUFFER_WRITE);
+
+    uint8_t *data = buffer.buf;
+    size_t filled = 0;
+
+    // The FPGA reports at most 65535 bytes available at a time
+    while (filled < buffer.len)
+    {
+        uint8_t available_bytes[2];
+        monocle_fpga_read(0x1006, available_bytes, sizeof(available_bytes));
+        size_t available = available_bytes[0] << 8 | available_bytes[1];
+
+        if (available == 0)
+        {
+            break;
+        }
+
+        size_t length = MIN(available, buffer.len - filled);
+        monocle_fpga_read(0x1007, data + filled, length);
+        filled += length;
+    }
+
+    // Nothing left of the frame, so the camera can sleep until the next one
+    if (filled == 0)
+    {
+        camera_sleep();
+    }
+
+    return MP_OBJ_NEW_SMALL_INT(filled);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(camera_read_into_obj, camera_read_into);
+
+// The sensor window of the default configuration, centered on the lens
+#define CAMERA_WINDOW_X_START 16
+#define CAMERA_WINDOW_X_END 2607
+#define CAMERA_WINDOW_Y_START 14
+#define CAMERA_WINDOW_Y_END 1705
+
+// The sensor skips every other pixel and line of the window, and the ISP
+// crops these offsets from each side before scaling down to the output size
+#define CAMERA_SUBSAMPLING 2
+#define CAMERA_ISP_X_OFFSET 16
+#define CAMERA_ISP_Y_OFFSET 46
+
+// The FPGA buffers at most a frame of this size
+#define CAMERA_MAX_WIDTH 640
+#define CAMERA_MAX_HEIGHT 400
+
+static struct camera_output_t
+{
+    uint16_t width;
+    uint16_t height;
+    bool jpeg;
+    uint8_t quality;
+    float zoom;
+} camera_output = {
+    .width = CAMERA_MAX_WIDTH,
+    .height = CAMERA_MAX_HEIGHT,
+    .jpeg = true,
+    .quality = 0x04,
+    .zoom = 1.0f,
+};
+
+/**
+ * Programs the window, output size, format and quality of the sensor. Only
+ * the registers which differ from what the sensor holds are sent, and it's
+ * only woken up if there's something to send.
+ */
+STATIC void camera_configure(const struct camera_output_t *output)
+{
+    if (camera_stream.active)
+    {
+        mp_raise_OSError(MP_EBUSY);
+    }
+
+    // Kept a multiple of four, so that the subsampled window stays even
+    uint16_t window_width =
+        (uint16_t)((CAMERA_WINDOW_X_END - CAMERA_WINDOW_X_START + 1) /
+                   output->zoom) &
+        ~3;
+    uint16_t window_height =
+        (uint16_t)((CAMERA_WINDOW_Y_END - CAMERA_WINDOW_Y_START + 1) /
+                   output->zoom) &
+        ~3;
+
+    // The ISP only scales down
+    if (window_width / CAMERA_SUBSAMPLING - 2 * CAMERA_ISP_X_OFFSET <
+            output->width ||
+        window_height / CAMERA_SUBSAMPLING - 2 * CAMERA_ISP_Y_OFFSET <
+            output->height)
+    {
+        mp_raise_ValueError(
+            MP_ERROR_TEXT("zoom is too large for the output size"));
+    }
+
+    uint16_t x_start =
+        (CAMERA_WINDOW_X_START + CAMERA_WINDOW_X_END + 1 - window_width) / 2;
+    uint16_t y_start =
+        (CAMERA_WINDOW_Y_START + CAMERA_WINDOW_Y_END + 1 - window_height) / 2;
+    uint16_t x_end = x_start + window_width - 1;
+    uint16_t y_end = y_start + window_height - 1;
+
+    const camera_config_t registers[] = {
+        {0x3800, x_start >> 8},
+        {0x3801, x_start & 0xFF},
+        {0x3802, y_start >> 8},
+        {0x3803, y_start & 0xFF},
+        {0x3804, x_end >> 8},
+        {0x3805, x_end & 0xFF},
+        {0x3806, y_end >> 8},
+        {0x3807, y_end & 0xFF},
+        {0x3808, output->width >> 8},
+        {0x3809, output->width & 0xFF},
+        {0x380a, output->height >> 8},
+        {0x380b, output->height & 0xFF},
+        {0x3821, output->jpeg ? 0x27 : 0x07},
+        {0x4300, output->jpeg ? 0x30 : 0x6F},
+        {0x4407, output->quality},
+        {0x4602, output->width >> 8},
+        {0x4603, output->width & 0xFF},
+        {0x501f, output->jpeg ? 0x00 : 0x01},
+    };
+
+    size_t changes = 0;
+    for (size_t i = 0; i < MP_ARRAY_SIZE(registers); i++)
+    {
+        if (camera_register_changes(registers[i].address, registers[i].value))
+        {
+            changes++;
+        }
+    }
+
+    if (changes == 0)
+    {
+        return;
+    }
+
+    // A camera woken by the user stays awake, and skips the wake up delay
+    bool was_awake = camera_awake;
+
+    if (!was_awake)
+    {
+        camera_wake();
+    }
+
+    bool written = camera_write_registers(registers, MP_ARRAY_SIZE(registers));
+
+    if (!was_awake)
+    {
+        camera_sleep();
+    }
+
+    if (!written)
+    {
+        mp_raise_OSError(MP_EIO);
+    }
+}
+
+STATIC mp_obj_t camera_output_set(size_t n_args, const mp_obj_t *args)
+{
+    struct camera_output_t output = camera_output;
+
+    mp_int_t width = mp_obj_get_int(args[0]);
+    mp_int_t height = mp_obj_get_int(args[1]);
+
+    if (width < 1 || width > CAMERA_MAX_WIDTH ||
+        height < 1 || height > CAMERA_MAX_HEIGHT)
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT("size must be within 640x400"));
+    }
+
+    output.width = width;
+    output.height = height;
+    output.jpeg = mp_obj_is_true(args[2]);
+
+    if (n_args > 3)
+    {
+        mp_int_t quality = mp_obj_get_int(args[3]);
+
+        // A lower quantization scale gives a better, and larger, image
+        if (quality < 1 || quality > 63)
+        {
+            mp_raise_ValueError(MP_ERROR_TEXT("quality must be 1 to 63"));
+        }
+
+        output.quality = quality;
+    }
+
+    camera_configure(&output);
+    camera_output = output;
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(camera_output_obj, 3, 4, camera_output_set);
+
+STATIC mp_obj_t camera_zoom(mp_obj_t factor_in)
+{
+    struct camera_output_t output = camera_output;
+
+    output.zoom = mp_obj_get_float(factor_in);
+
+    if (!(output.zoom >= 1.0f))
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT("zoom must be at least 1"));
+    }
+
+    camera_configure(&output);
+    camera_output = output;
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(camera_zoom_obj, camera_zoom);
+
 STATIC const mp_rom_map_elem_t camera_module_globals_table[] = {
 
+    {MP_ROM_QSTR(MP_QSTR_init), MP_ROM_PTR(&camera_init_obj)},
     {MP_ROM_QSTR(MP_QSTR_sleep), MP_ROM_PTR(&camera_sleep_obj)},
     {MP_ROM_QSTR(MP_QSTR_wake), MP_ROM_PTR(&camera_wake_obj)},
+    {MP_ROM_QSTR(MP_QSTR_capture), MP_ROM_PTR(&camera_capture_obj)},
+    {MP_ROM_QSTR(MP_QSTR_read_into), MP_ROM_PTR(&camera_read_into_obj)},
+    {MP_ROM_QSTR(MP_QSTR_stream), MP_ROM_PTR(&camera_stream_start_obj)},
+    {MP_ROM_QSTR(MP_QSTR_streaming), MP_ROM_PTR(&camera_streaming_obj)},
+    {MP_ROM_QSTR(MP_QSTR_stop), MP_ROM_PTR(&camera_stream_cancel_obj)},
+    {MP_ROM_QSTR(MP_QSTR_output), MP_ROM_PTR(&camera_output_obj)},
+    {MP_ROM_QSTR(MP_QSTR_zoom), MP_ROM_PTR(&camera_zoom_obj)},
 };
 STATIC MP_DEFINE_CONST_DICT(camera_module_globals, camera_module_globals_table);
 
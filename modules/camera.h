@@ -0,0 +1,59 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct camera_config_t
+{
+    uint16_t address;
+    uint8_t value;
+} camera_config_t;
+
+/**
+ * @brief Writes a table of camera sensor registers, sending runs of
+ *        consecutive addresses as burst writes. Writes to the registers which
+ *        control the frame size, format and quality are skipped if the sensor
+ *        already holds the value, so a full table can be written again cheaply.
+ */
+
+bool camera_write_registers(const camera_config_t *table, size_t count);
+
+/**
+ * @brief Schedules the camera to be brought up in the background, from the
+ *        next time that pending callbacks run. Importing camera does the same
+ *        on demand.
+ */
+
+void camera_prefetch(void);
+
+/**
+ * @brief Stops a frame stream in progress. Called on soft reset, which drops
+ *        the scheduled callbacks that keep a stream going.
+ */
+
+void camera_stream_reset(void);
@@ -25,7 +25,6 @@
 import _camera
 import struct
 import fpga
-import time
 
 
 _image = fpga.read(0x0001, 4)
@@ -34,20 +33,19 @@ _status = fpga.read(0x1000, 1)[0] & 0x10
 if _status != 16 or _image != b"Mncl":
     raise (NotImplementedError("camera driver not found on FPGA"))
 
+_camera.init()
+
 RGB = "RGB"
 JPEG = "JPEG"
 
 
 def capture():
-    _camera.wake()
-    fpga.write(0x1003, b"")
-    while fpga.read(0x1000, 1) == b"2":
-        time.sleep_us(10)
+    _camera.capture()
 
 
-def read(bytes=254):
-    if bytes > 254:
-        raise ValueError("at most 254 bytes")
+def read(length=254):
+    if length < 1:
+        raise ValueError("at least 1 byte")
 
     avail = struct.unpack(">H", fpga.read(0x1006, 2))[0]
 
@@ -55,12 +53,41 @@ def read(bytes=254):
         _camera.sleep()
         return None
 
-    return fpga.read(0x1007, min(bytes, avail))
+    # read_into() saves the copy, for callers who don't need bytes
+    data = bytearray(min(length, avail))
+    fpga.read_into(0x1007, data)
+    return bytes(data)
+
+
+def read_into(buffer):
+    return _camera.read_into(buffer)
+
+
+def stream(bluetooth=True):
+    if not bluetooth:
+        raise NotImplementedError("frames can only be streamed over bluetooth")
+
+    capture()
+    return _camera.stream()
+
+
+def streaming():
+    return _camera.streaming()
+
+
+def stop():
+    _camera.stop()
+
 
+def output(x, y, mode, quality=None):
+    if mode not in (RGB, JPEG):
+        raise ValueError("mode must be camera.RGB or camera.JPEG")
 
-def output(x, y, mode):
-    return NotImplemented
+    if quality is None:
+        _camera.output(x, y, mode == JPEG)
+    else:
+        _camera.output(x, y, mode == JPEG, quality)
 
 
 def zoom(factor):
-    return NotImplemented
+    _camera.zoom(factor)
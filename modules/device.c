@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 #include "monocle.h"
 #include "genhdr/mpversion.h"
 #include "py/mphal.h"
@@ -186,7 +187,29 @@ STATIC mp_obj_t device_is_charging(void)
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(device_is_charging_obj, device_is_charging);
 
+STATIC mp_obj_t device_boot_trace(void)
+{
+    const monocle_boot_stage_t *stages;
+    size_t count = monocle_boot_stages(&stages);
+
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        mp_obj_t stage[] = {
+            mp_obj_new_str(stages[i].name, strlen(stages[i].name)),
+            mp_obj_new_int_from_uint(stages[i].us),
+        };
+        mp_obj_list_append(list, mp_obj_new_tuple(2, stage));
+    }
+
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(device_boot_trace_obj, device_boot_trace);
+
 extern const struct _mp_obj_type_t device_storage_type;
+extern const struct _mp_obj_type_t device_blob_type;
+extern const struct _mp_obj_type_t device_logstore_type;
 
 STATIC const mp_rom_map_elem_t device_module_globals_table[] = {
 
@@ -201,7 +224,10 @@ STATIC const mp_rom_map_elem_t device_module_globals_table[] = {
     {MP_ROM_QSTR(MP_QSTR_prevent_sleep), MP_ROM_PTR(&device_prevent_sleep_obj)},
     {MP_ROM_QSTR(MP_QSTR_force_sleep), MP_ROM_PTR(&device_force_sleep_obj)},
     {MP_ROM_QSTR(MP_QSTR_is_charging), MP_ROM_PTR(&device_is_charging_obj)},
+    {MP_ROM_QSTR(MP_QSTR_boot_trace), MP_ROM_PTR(&device_boot_trace_obj)},
     {MP_ROM_QSTR(MP_QSTR_Storage), MP_ROM_PTR(&device_storage_type)},
+    {MP_ROM_QSTR(MP_QSTR_Blob), MP_ROM_PTR(&device_blob_type)},
+    {MP_ROM_QSTR(MP_QSTR_LogStore), MP_ROM_PTR(&device_logstore_type)},
 };
 STATIC MP_DEFINE_CONST_DICT(device_module_globals, device_module_globals_table);
 
@@ -0,0 +1,577 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * @brief Framed file transfer over the data service. Started from the REPL
+ *        with bluetooth.file_server(), which serves requests until the host
+ *        sends an EXIT frame.
+ *
+ *        Every frame is:
+ *
+ *            type (1) | sequence (2) | length (2) | payload | CRC32 (4)
+ *
+ *        with little endian integers, and the CRC32 covering everything
+ *        before it. Frames are numbered from zero for the session, and the
+ *        host may send several before it gets acknowledged. The data service
+ *        is a byte stream, so a frame may span several writes, although
+ *        tools/upload_file.py sizes its frames to fit in one. A frame which
+ *        is lost to a full receive buffer is detected from the gap in
+ *        sequence numbers. A NAK then asks the host to go back and resend
+ *        everything from the expected sequence number.
+ *
+ *        Bytes which can't start a frame with a valid CRC are dropped, and
+ *        the frames after them kept. A frame which stops arriving for
+ *        FRAME_TIMEOUT_MS is dropped too. Either way, a NAK asks for the
+ *        frames from the expected sequence number again.
+ *
+ *        Host requests:
+ *            OPEN_WRITE  path     Creates the file, DATA frames follow
+ *            OPEN_READ   path     Sends the file as DATA frames, then END
+ *            DATA        bytes    Appended to the file being written
+ *            END         size (4) | CRC32 of the file (4), closes the file
+ *            EXIT                 Returns from bluetooth.file_server()
+ *
+ *        Device replies:
+ *            ACK         Every frame up to the sequence number is done
+ *            NAK         Resend from the sequence number on
+ *            ERROR       Message of the exception raised by the request
+ */
+
+#include <string.h>
+#include "bluetooth.h"
+#include "mphalport.h"
+#include "lib/uzlib/uzlib.h"
+#include "py/builtin.h"
+#include "py/runtime.h"
+#include "py/stream.h"
+
+#define FRAME_HEADER_LENGTH 5
+#define FRAME_CRC_LENGTH 4
+#define FRAME_MAX_PAYLOAD 1024
+#define FRAME_MAX_LENGTH (FRAME_HEADER_LENGTH + FRAME_MAX_PAYLOAD + \
+                          FRAME_CRC_LENGTH)
+
+// Written DATA frames are acknowledged in batches, or when the host pauses
+#define FRAMES_PER_ACK 4
+
+// How long a frame which has started may stall before it's given up on
+#define FRAME_TIMEOUT_MS 1000
+
+enum
+{
+    FRAME_OPEN_WRITE = 0x01,
+    FRAME_OPEN_READ = 0x02,
+    FRAME_DATA = 0x03,
+    FRAME_END = 0x04,
+    FRAME_EXIT = 0x05,
+    FRAME_ACK = 0x10,
+    FRAME_NAK = 0x11,
+    FRAME_ERROR = 0x12,
+};
+
+// Lives on the stack of file_server(), where the GC can see the buffers
+typedef struct file_transfer_t
+{
+    uint8_t *frame;
+    size_t received;
+    uint8_t *reply;
+    mp_obj_t file;
+    uint32_t file_size;
+    uint32_t file_crc;
+    uint16_t expected_sequence;
+    uint16_t ignored_sequence;
+    uint8_t unacknowledged;
+    bool nak_sent;
+    bool exit;
+} file_transfer_t;
+
+static uint32_t crc32(const uint8_t *bytes, size_t len, uint32_t crc)
+{
+    // Same as binascii.crc32(), as uzlib leaves the inversions to the caller
+    return uzlib_crc32(bytes, len, crc ^ 0xFFFFFFFF) ^ 0xFFFFFFFF;
+}
+
+static uint16_t get_u16(const uint8_t *bytes)
+{
+    return bytes[0] | bytes[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *bytes)
+{
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static void put_u16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = value & 0xFF;
+    bytes[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *bytes, uint32_t value)
+{
+    put_u16(bytes, value & 0xFFFF);
+    put_u16(bytes + 2, value >> 16);
+}
+
+static void send_frame(file_transfer_t *transfer,
+                       uint8_t type,
+                       uint16_t sequence,
+                       const uint8_t *payload,
+                       size_t len)
+{
+    // Every reply is built in the same buffer, which payloads may already be in
+    uint8_t *frame = transfer->reply;
+
+    frame[0] = type;
+    put_u16(&frame[1], sequence);
+    put_u16(&frame[3], len);
+    if (payload != &frame[FRAME_HEADER_LENGTH])
+    {
+        memcpy(&frame[FRAME_HEADER_LENGTH], payload, len);
+    }
+    put_u32(&frame[FRAME_HEADER_LENGTH + len],
+            crc32(frame, FRAME_HEADER_LENGTH + len, 0));
+
+    if (ble_send_raw_data(frame, FRAME_HEADER_LENGTH + len + FRAME_CRC_LENGTH))
+    {
+        mp_raise_msg(&mp_type_OSError,
+                     MP_ERROR_TEXT("disconnected while sending"));
+    }
+}
+
+/**
+ * @brief Whether the bytes are a frame with a valid CRC, or could be the
+ *        start of one.
+ */
+static bool frame_plausible(const uint8_t *bytes, size_t len)
+{
+    if (len < FRAME_HEADER_LENGTH)
+    {
+        return true;
+    }
+
+    uint16_t payload = get_u16(&bytes[3]);
+
+    if (payload > FRAME_MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    if (len < FRAME_HEADER_LENGTH + payload + FRAME_CRC_LENGTH)
+    {
+        return true;
+    }
+
+    return get_u32(&bytes[FRAME_HEADER_LENGTH + payload]) ==
+           crc32(bytes, FRAME_HEADER_LENGTH + payload, 0);
+}
+
+static size_t frame_length(const uint8_t *bytes, size_t len)
+{
+    if (len < FRAME_HEADER_LENGTH)
+    {
+        return FRAME_HEADER_LENGTH;
+    }
+
+    return FRAME_HEADER_LENGTH + get_u16(&bytes[3]) + FRAME_CRC_LENGTH;
+}
+
+static void drop_received(file_transfer_t *transfer, size_t len)
+{
+    transfer->received -= len;
+    memmove(transfer->frame, &transfer->frame[len], transfer->received);
+}
+
+static void send_nak(file_transfer_t *transfer)
+{
+    send_frame(transfer, FRAME_NAK, transfer->expected_sequence, NULL, 0);
+    transfer->nak_sent = true;
+}
+
+/**
+ * @brief Receives until a frame with a valid CRC starts the frame buffer.
+ *        Waits as long as it takes for a frame to start, but only
+ *        FRAME_TIMEOUT_MS for the rest of one which has.
+ */
+static void receive_frame(file_transfer_t *transfer)
+{
+    uint8_t *frame = transfer->frame;
+    bool dropped = false;
+    mp_uint_t progress = mp_hal_ticks_ms();
+
+    for (;;)
+    {
+        // Drop only what can't be the start of a frame
+        size_t start = 0;
+
+        while (start < transfer->received &&
+               !frame_plausible(&frame[start], transfer->received - start))
+        {
+            start++;
+        }
+
+        if (start > 0)
+        {
+            drop_received(transfer, start);
+
+            // One NAK for however many bytes it takes to find a frame
+            if (!dropped)
+            {
+                send_nak(transfer);
+                dropped = true;
+            }
+        }
+
+        size_t needed = frame_length(frame, transfer->received);
+
+        if (transfer->received >= needed)
+        {
+            return;
+        }
+
+        size_t received = bluetooth_data_read(&frame[transfer->received],
+                                              needed - transfer->received);
+        transfer->received += received;
+
+        if (received > 0)
+        {
+            progress = mp_hal_ticks_ms();
+            continue;
+        }
+
+        if (!ble_are_tx_notifications_enabled(DATA_TX))
+        {
+            mp_raise_msg(&mp_type_OSError,
+                         MP_ERROR_TEXT("disconnected while receiving"));
+        }
+
+        // The length may be corrupted, or the host stopped mid-frame. As
+        // nothing more is coming, the bytes received so far are kept only
+        // from the next whole frame in them
+        if (transfer->received > 0 &&
+            mp_hal_ticks_ms() - progress >= FRAME_TIMEOUT_MS)
+        {
+            start = 1;
+
+            while (start < transfer->received &&
+                   (transfer->received - start <
+                        frame_length(&frame[start],
+                                     transfer->received - start) ||
+                    !frame_plausible(&frame[start],
+                                     transfer->received - start)))
+            {
+                start++;
+            }
+
+            drop_received(transfer, start);
+            send_nak(transfer);
+            dropped = true;
+            progress = mp_hal_ticks_ms();
+            continue;
+        }
+
+        MICROPY_EVENT_POLL_HOOK;
+    }
+}
+
+static void close_file(file_transfer_t *transfer)
+{
+    if (transfer->file != MP_OBJ_NULL)
+    {
+        mp_obj_t file = transfer->file;
+        transfer->file = MP_OBJ_NULL;
+        mp_stream_close(file);
+    }
+}
+
+static void open_file(file_transfer_t *transfer,
+                      const uint8_t *path,
+                      size_t len,
+                      qstr mode)
+{
+    close_file(transfer);
+
+    mp_obj_t args[2] = {
+        mp_obj_new_str((const char *)path, len),
+        MP_OBJ_NEW_QSTR(mode),
+    };
+
+    transfer->file = mp_call_function_n_kw(MP_OBJ_FROM_PTR(&mp_builtin_open_obj),
+                                           2,
+                                           0,
+                                           args);
+    transfer->file_size = 0;
+    transfer->file_crc = 0;
+}
+
+static void send_file(file_transfer_t *transfer,
+                      const uint8_t *path,
+                      size_t len)
+{
+    open_file(transfer, path, len, MP_QSTR_rb);
+
+    // One frame per notification
+    size_t chunk = ble_get_max_payload_size() - FRAME_HEADER_LENGTH -
+                   FRAME_CRC_LENGTH;
+
+    if (chunk > FRAME_MAX_PAYLOAD)
+    {
+        chunk = FRAME_MAX_PAYLOAD;
+    }
+
+    uint8_t *buffer = &transfer->reply[FRAME_HEADER_LENGTH];
+    uint16_t sequence = 0;
+
+    for (;;)
+    {
+        int error;
+        mp_uint_t read = mp_stream_rw(transfer->file,
+                                      buffer,
+                                      chunk,
+                                      &error,
+                                      MP_STREAM_RW_READ | MP_STREAM_RW_ONCE);
+
+        if (read == MP_STREAM_ERROR)
+        {
+            mp_raise_OSError(error);
+        }
+
+        if (read == 0)
+        {
+            break;
+        }
+
+        transfer->file_size += read;
+        transfer->file_crc = crc32(buffer, read, transfer->file_crc);
+        send_frame(transfer, FRAME_DATA, sequence++, buffer, read);
+    }
+
+    uint8_t end[8];
+    put_u32(&end[0], transfer->file_size);
+    put_u32(&end[4], transfer->file_crc);
+    send_frame(transfer, FRAME_END, sequence, end, sizeof(end));
+
+    close_file(transfer);
+}
+
+static void write_file(file_transfer_t *transfer,
+                       const uint8_t *bytes,
+                       size_t len)
+{
+    if (transfer->file == MP_OBJ_NULL)
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT("no file is open for writing"));
+    }
+
+    mp_stream_write(transfer->file, bytes, len, MP_STREAM_RW_WRITE);
+
+    transfer->file_size += len;
+    transfer->file_crc = crc32(bytes, len, transfer->file_crc);
+}
+
+static void end_file(file_transfer_t *transfer,
+                     const uint8_t *bytes,
+                     size_t len)
+{
+    if (transfer->file == MP_OBJ_NULL || len != 8)
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT("no file is open for writing"));
+    }
+
+    close_file(transfer);
+
+    if (get_u32(&bytes[0]) != transfer->file_size ||
+        get_u32(&bytes[4]) != transfer->file_crc)
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT("file size or CRC mismatch"));
+    }
+}
+
+static void handle_frame(file_transfer_t *transfer,
+                         uint8_t type,
+                         const uint8_t *payload,
+                         size_t len)
+{
+    switch (type)
+    {
+    case FRAME_OPEN_WRITE:
+        open_file(transfer, payload, len, MP_QSTR_wb);
+        break;
+
+    case FRAME_OPEN_READ:
+        send_frame(transfer, FRAME_ACK, transfer->expected_sequence - 1,
+                   NULL, 0);
+        send_file(transfer, payload, len);
+        break;
+
+    case FRAME_DATA:
+        write_file(transfer, payload, len);
+        break;
+
+    case FRAME_END:
+        end_file(transfer, payload, len);
+        break;
+
+    case FRAME_EXIT:
+        close_file(transfer);
+        transfer->exit = true;
+        break;
+
+    default:
+        mp_raise_ValueError(MP_ERROR_TEXT("unknown frame type"));
+    }
+}
+
+static void send_error(file_transfer_t *transfer,
+                       uint16_t sequence,
+                       mp_obj_t exception)
+{
+    vstr_t message;
+    mp_print_t print;
+    vstr_init_print(&message, 32, &print);
+    mp_obj_print_helper(&print, exception, PRINT_EXC);
+
+    size_t len = message.len < FRAME_MAX_PAYLOAD ? message.len
+                                                 : FRAME_MAX_PAYLOAD;
+    send_frame(transfer, FRAME_ERROR, sequence, (const uint8_t *)message.buf,
+               len);
+    vstr_clear(&message);
+}
+
+static void serve_received_frame(file_transfer_t *transfer)
+{
+    uint8_t *frame = transfer->frame;
+    uint8_t type = frame[0];
+    uint16_t sequence = get_u16(&frame[1]);
+    uint16_t len = get_u16(&frame[3]);
+
+    // Ignore anything after a lost frame until the host goes back to it. A
+    // sequence number going backwards is the host resending, and if that
+    // resend loses a frame too, it's asked for again
+    if (sequence != transfer->expected_sequence)
+    {
+        if (!transfer->nak_sent ||
+            (int16_t)(sequence - transfer->ignored_sequence) <= 0)
+        {
+            send_nak(transfer);
+        }
+
+        transfer->ignored_sequence = sequence;
+        return;
+    }
+
+    transfer->nak_sent = false;
+    transfer->expected_sequence++;
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0)
+    {
+        handle_frame(transfer, type, &frame[FRAME_HEADER_LENGTH], len);
+        nlr_pop();
+    }
+    else
+    {
+        mp_obj_t exception = MP_OBJ_FROM_PTR(nlr.ret_val);
+
+        // Interrupts and lost connections end the server
+        if (mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(mp_obj_get_type(exception)),
+                                    MP_OBJ_FROM_PTR(&mp_type_KeyboardInterrupt)) ||
+            !ble_are_tx_notifications_enabled(DATA_TX))
+        {
+            nlr_jump(nlr.ret_val);
+        }
+
+        close_file(transfer);
+        send_error(transfer, sequence, exception);
+        transfer->unacknowledged = 0;
+        return;
+    }
+
+    if (type == FRAME_DATA &&
+        ++transfer->unacknowledged < FRAMES_PER_ACK &&
+        bluetooth_data_available() > 0)
+    {
+        return;
+    }
+
+    transfer->unacknowledged = 0;
+
+    if (type != FRAME_OPEN_READ)
+    {
+        send_frame(transfer, FRAME_ACK, sequence, NULL, 0);
+    }
+}
+
+static void serve_frame(file_transfer_t *transfer)
+{
+    receive_frame(transfer);
+    serve_received_frame(transfer);
+    drop_received(transfer, frame_length(transfer->frame, transfer->received));
+}
+
+STATIC mp_obj_t bluetooth_file_server(void)
+{
+    if (!ble_are_tx_notifications_enabled(DATA_TX))
+    {
+        mp_raise_msg(&mp_type_OSError,
+                     MP_ERROR_TEXT(
+                         "notifications are not enabled on the data service"));
+    }
+
+    file_transfer_t transfer_state = {0};
+    file_transfer_t *transfer = &transfer_state;
+
+    transfer->file = MP_OBJ_NULL;
+    transfer->frame = m_malloc(FRAME_MAX_LENGTH);
+    transfer->reply = m_malloc(FRAME_MAX_LENGTH);
+
+    // Frames go to the server rather than read() or the receive callback
+    bluetooth_data_claim(true);
+    bluetooth_data_flush();
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0)
+    {
+        while (!transfer->exit)
+        {
+            serve_frame(transfer);
+        }
+        nlr_pop();
+    }
+    else
+    {
+        close_file(transfer);
+        bluetooth_data_claim(false);
+        m_free(transfer->frame);
+        m_free(transfer->reply);
+        nlr_jump(nlr.ret_val);
+    }
+
+    bluetooth_data_claim(false);
+    m_free(transfer->frame);
+    m_free(transfer->reply);
+
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_0(bluetooth_file_server_obj, bluetooth_file_server);
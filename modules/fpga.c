@@ -37,13 +37,9 @@ STATIC mp_obj_t fpga_read(mp_obj_t addr_16bit, mp_obj_t n)
             MP_ERROR_TEXT("n must be between 1 and 255"));
     }
 
-    uint16_t addr = mp_obj_get_int(addr_16bit);
-    uint8_t addr_bytes[2] = {(uint8_t)(addr >> 8), (uint8_t)addr};
-
     uint8_t *buffer = m_malloc(mp_obj_get_int(n));
 
-    monocle_spi_write(FPGA, addr_bytes, 2, true);
-    monocle_spi_read(FPGA, buffer, mp_obj_get_int(n), false);
+    monocle_fpga_read(mp_obj_get_int(addr_16bit), buffer, mp_obj_get_int(n));
 
     mp_obj_t bytes = mp_obj_new_bytes(buffer, mp_obj_get_int(n));
 
@@ -53,6 +49,22 @@ STATIC mp_obj_t fpga_read(mp_obj_t addr_16bit, mp_obj_t n)
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(fpga_read_obj, fpga_read);
 
+STATIC mp_obj_t fpga_read_into(mp_obj_t addr_16bit, mp_obj_t buf)
+{
+    mp_buffer_info_t buffer;
+    mp_get_buffer_raise(buf, &buffer, MP_BUFFER_WRITE);
+
+    if (buffer.len == 0)
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT("buffer cannot be empty"));
+    }
+
+    monocle_fpga_read(mp_obj_get_int(addr_16bit), buffer.buf, buffer.len);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(fpga_read_into_obj, fpga_read_into);
+
 STATIC mp_obj_t fpga_write(mp_obj_t addr_16bit, mp_obj_t bytes)
 {
     mp_buffer_info_t buffer;
@@ -106,6 +118,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(fpga_run_obj, 0, 1, fpga_run);
 STATIC const mp_rom_map_elem_t fpga_module_globals_table[] = {
 
     {MP_ROM_QSTR(MP_QSTR_read), MP_ROM_PTR(&fpga_read_obj)},
+    {MP_ROM_QSTR(MP_QSTR_read_into), MP_ROM_PTR(&fpga_read_into_obj)},
     {MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&fpga_write_obj)},
     {MP_ROM_QSTR(MP_QSTR_run), MP_ROM_PTR(&fpga_run_obj)},
 };
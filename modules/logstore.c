@@ -0,0 +1,485 @@
+/*
+ * This file is part of the MicroPython for Monocle project:
+ *      https://github.com/brilliantlabsAR/monocle-micropython
+ *
+ * Authored by: Josuah Demangeon (me@josuah.net)
+ *              Raj Nakarja / Brilliant Labs Ltd. (raj@itsbrilliant.co)
+ *
+ * ISC Licence
+ *
+ * Copyright © 2023 Brilliant Labs Ltd.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+#include "monocle.h"
+#include "mphalport.h"
+#include "storage.h"
+#include "py/mperrno.h"
+#include "py/runtime.h"
+
+#if MICROPY_HW_FLASH_LOG_BUFFER_SIZE % 256 != 0
+#error "the log buffer must hold a whole number of flash pages"
+#endif
+
+#define LOG_SECTOR_SIZE (4096)
+#define LOG_SECTORS (MICROPY_HW_FLASH_LOG_SIZE / LOG_SECTOR_SIZE)
+#define LOG_PAGE_SIZE (256)
+#define LOG_PAGES (MICROPY_HW_FLASH_LOG_BUFFER_SIZE / LOG_PAGE_SIZE)
+
+// Records never straddle sectors, so that erasing one only loses whole records
+#define LOG_RECORD_MAX (LOG_SECTOR_SIZE - sizeof(log_header_t))
+
+typedef struct log_header_t
+{
+    uint32_t sequence;
+    uint16_t length;
+    uint16_t crc;
+} log_header_t;
+
+static struct logstore_t
+{
+    bool mounted;
+    uint32_t sequence;
+    size_t write;
+    uint8_t pages[LOG_PAGES][LOG_PAGE_SIZE];
+    size_t page_address[LOG_PAGES];
+    size_t page_head;
+    size_t page_count;
+} logstore;
+
+const struct _mp_obj_type_t device_logstore_type;
+
+typedef struct _logstore_obj_t
+{
+    mp_obj_base_t base;
+} logstore_obj_t;
+
+static uint16_t log_header_crc(const log_header_t *header)
+{
+    return monocle_crc16(0xFFFF, (const uint8_t *)header,
+                         offsetof(log_header_t, crc));
+}
+
+/**
+ * @brief Reads the header of the record at offset into the region, if one
+ *        fits there. Erased flash reads as a record that doesn't fit.
+ */
+static bool log_read_header(size_t offset, log_header_t *header)
+{
+    if (offset % LOG_SECTOR_SIZE + sizeof(log_header_t) > LOG_SECTOR_SIZE)
+    {
+        return false;
+    }
+
+    monocle_flash_read((uint8_t *)header, MICROPY_HW_FLASH_LOG_START + offset,
+                       sizeof(log_header_t));
+
+    return offset % LOG_SECTOR_SIZE + sizeof(log_header_t) + header->length <=
+           LOG_SECTOR_SIZE;
+}
+
+static bool log_record_valid(size_t offset, log_header_t *header)
+{
+    if (!log_read_header(offset, header))
+    {
+        return false;
+    }
+
+    uint16_t crc = log_header_crc(header);
+    uint8_t buffer[64];
+
+    for (size_t i = 0; i < header->length; i += sizeof(buffer))
+    {
+        size_t chunk = MIN(header->length - i, sizeof(buffer));
+        monocle_flash_read(buffer,
+                           MICROPY_HW_FLASH_LOG_START + offset +
+                               sizeof(log_header_t) + i,
+                           chunk);
+        crc = monocle_crc16(crc, buffer, chunk);
+    }
+
+    return crc == header->crc;
+}
+
+static bool log_erased(size_t offset)
+{
+    uint8_t bytes[sizeof(log_header_t)];
+
+    if (offset % LOG_SECTOR_SIZE + sizeof(bytes) > LOG_SECTOR_SIZE)
+    {
+        return false;
+    }
+
+    monocle_flash_read(bytes, MICROPY_HW_FLASH_LOG_START + offset,
+                       sizeof(bytes));
+
+    for (size_t i = 0; i < sizeof(bytes); i++)
+    {
+        if (bytes[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void log_erase_after(size_t sector)
+{
+    monocle_flash_erase(MICROPY_HW_FLASH_LOG_START +
+                            ((sector + 1) % LOG_SECTORS) * LOG_SECTOR_SIZE,
+                        LOG_SECTOR_SIZE);
+}
+
+/**
+ * @brief Moves the write pointer to the start of a sector, and queues an
+ *        erase of the one after so that it's ready before it's needed.
+ */
+static void log_enter_sector(size_t sector)
+{
+    logstore.write = sector * LOG_SECTOR_SIZE;
+    log_erase_after(sector);
+}
+
+static void log_mount(void)
+{
+    // Checked every time, as a filesystem may be mounted over the region
+    // after the log store
+    if (storage_overlaps(MICROPY_HW_FLASH_LOG_START, MICROPY_HW_FLASH_LOG_SIZE))
+    {
+        mp_raise_OSError(MP_EPERM);
+    }
+
+    if (logstore.mounted)
+    {
+        return;
+    }
+
+    // The sector being written starts with the newest record of any sector
+    log_header_t header;
+    size_t head = LOG_SECTORS;
+    uint32_t newest = 0;
+
+    for (size_t sector = 0; sector < LOG_SECTORS; sector++)
+    {
+        if (log_record_valid(sector * LOG_SECTOR_SIZE, &header) &&
+            (head == LOG_SECTORS || (int32_t)(header.sequence - newest) > 0))
+        {
+            head = sector;
+            newest = header.sequence;
+        }
+    }
+
+    logstore.mounted = true;
+
+    if (head == LOG_SECTORS)
+    {
+        logstore.sequence = 0;
+        monocle_flash_erase(MICROPY_HW_FLASH_LOG_START, LOG_SECTOR_SIZE);
+        log_enter_sector(0);
+        return;
+    }
+
+    size_t offset = head * LOG_SECTOR_SIZE;
+    size_t end = offset + LOG_SECTOR_SIZE;
+
+    while (offset < end && log_record_valid(offset, &header))
+    {
+        logstore.sequence = header.sequence + 1;
+        offset += sizeof(log_header_t) + header.length;
+    }
+
+    // Carry on after the last record if what follows is erased. Otherwise a
+    // write was torn, and the rest of the sector is left alone
+    if (offset < end && log_erased(offset))
+    {
+        logstore.write = offset;
+        log_erase_after(head);
+        return;
+    }
+
+    size_t next = (head + 1) % LOG_SECTORS;
+    monocle_flash_erase(MICROPY_HW_FLASH_LOG_START + next * LOG_SECTOR_SIZE,
+                        LOG_SECTOR_SIZE);
+    log_enter_sector(next);
+}
+
+static void log_program_page(void)
+{
+    monocle_flash_write(logstore.pages[logstore.page_head],
+                        MICROPY_HW_FLASH_LOG_START +
+                            logstore.page_address[logstore.page_head],
+                        LOG_PAGE_SIZE);
+
+    logstore.page_head = (logstore.page_head + 1) % LOG_PAGES;
+    logstore.page_count--;
+}
+
+/**
+ * @brief Programs staged pages. Without waiting, only pages that are full
+ *        are programmed, and only while the flash is idle, so that appends
+ *        never wait on an erase or program in progress.
+ */
+static void log_drain(bool wait)
+{
+    while (logstore.page_count > 0)
+    {
+        size_t last = (logstore.page_head + logstore.page_count - 1) %
+                      LOG_PAGES;
+
+        if (!wait &&
+            (monocle_flash_busy() ||
+             (logstore.page_count == 1 &&
+              logstore.page_address[last] ==
+                  logstore.write - logstore.write % LOG_PAGE_SIZE)))
+        {
+            return;
+        }
+
+        log_program_page();
+    }
+
+    if (wait)
+    {
+        monocle_flash_sync();
+    }
+}
+
+static uint8_t *log_page(void)
+{
+    size_t address = logstore.write - logstore.write % LOG_PAGE_SIZE;
+
+    if (logstore.page_count > 0)
+    {
+        size_t last = (logstore.page_head + logstore.page_count - 1) %
+                      LOG_PAGES;
+
+        if (logstore.page_address[last] == address)
+        {
+            return logstore.pages[last];
+        }
+    }
+
+    // Only waits on the flash once the staged pages are all used up
+    if (logstore.page_count == LOG_PAGES)
+    {
+        log_program_page();
+    }
+
+    size_t slot = (logstore.page_head + logstore.page_count) % LOG_PAGES;
+
+    // Programming erased bytes again leaves them as they are, so a page
+    // flushed early can be staged and programmed a second time
+    memset(logstore.pages[slot], 0xFF, LOG_PAGE_SIZE);
+    logstore.page_address[slot] = address;
+    logstore.page_count++;
+
+    return logstore.pages[slot];
+}
+
+static void log_copy_in(const uint8_t *bytes, size_t length)
+{
+    while (length > 0)
+    {
+        size_t offset = logstore.write % LOG_PAGE_SIZE;
+        size_t chunk = MIN(length, LOG_PAGE_SIZE - offset);
+
+        memcpy(log_page() + offset, bytes, chunk);
+
+        logstore.write = (logstore.write + chunk) % MICROPY_HW_FLASH_LOG_SIZE;
+        bytes += chunk;
+        length -= chunk;
+    }
+}
+
+STATIC mp_obj_t logstore_append(mp_obj_t self_in, mp_obj_t data)
+{
+    mp_buffer_info_t buffer;
+    mp_get_buffer_raise(data, &buffer, MP_BUFFER_READ);
+
+    if (buffer.len > LOG_RECORD_MAX)
+    {
+        mp_raise_ValueError(
+            MP_ERROR_TEXT("records cannot be larger than 4088 bytes"));
+    }
+
+    log_mount();
+
+    if (logstore.write % LOG_SECTOR_SIZE + sizeof(log_header_t) + buffer.len >
+        LOG_SECTOR_SIZE)
+    {
+        log_enter_sector((logstore.write / LOG_SECTOR_SIZE + 1) % LOG_SECTORS);
+    }
+
+    log_header_t header = {
+        .sequence = logstore.sequence,
+        .length = buffer.len,
+    };
+    header.crc = monocle_crc16(log_header_crc(&header), buffer.buf, buffer.len);
+
+    log_copy_in((const uint8_t *)&header, sizeof(header));
+    log_copy_in(buffer.buf, buffer.len);
+
+    if (logstore.write % LOG_SECTOR_SIZE == 0)
+    {
+        log_enter_sector(logstore.write / LOG_SECTOR_SIZE);
+    }
+
+    logstore.sequence++;
+
+    log_drain(false);
+
+    return mp_obj_new_int_from_uint(header.sequence);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(logstore_append_obj, logstore_append);
+
+STATIC mp_obj_t logstore_flush(mp_obj_t self_in)
+{
+    log_mount();
+    log_drain(true);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(logstore_flush_obj, logstore_flush);
+
+/**
+ * @brief Sends records as they are stored, headers included, so that the
+ *        receiving end can check the sequence numbers and CRCs.
+ */
+static void log_send(size_t offset, size_t length)
+{
+    uint8_t buffer[256];
+
+    while (length > 0)
+    {
+        size_t chunk = MIN(length, sizeof(buffer));
+        monocle_flash_read(buffer, MICROPY_HW_FLASH_LOG_START + offset, chunk);
+
+        if (ble_send_raw_data(buffer, chunk))
+        {
+            mp_raise_msg(&mp_type_OSError,
+                         MP_ERROR_TEXT("disconnected while sending"));
+        }
+
+        offset += chunk;
+        length -= chunk;
+    }
+}
+
+STATIC mp_obj_t logstore_export(size_t n_args, const mp_obj_t *args)
+{
+    if (!ble_are_tx_notifications_enabled(DATA_TX))
+    {
+        mp_raise_msg(&mp_type_OSError,
+                     MP_ERROR_TEXT(
+                         "notifications are not enabled on the data service"));
+    }
+
+    bool everything = n_args < 2 || args[1] == mp_const_none;
+    uint32_t after = everything ? 0 : mp_obj_get_int_truncated(args[1]);
+
+    log_mount();
+    log_drain(true);
+
+    // Oldest first, starting after the sector being written
+    size_t head = logstore.write / LOG_SECTOR_SIZE;
+    bool sent = false;
+    uint32_t last = 0;
+
+    for (size_t i = 1; i <= LOG_SECTORS; i++)
+    {
+        size_t offset = ((head + i) % LOG_SECTORS) * LOG_SECTOR_SIZE;
+        size_t end = offset + LOG_SECTOR_SIZE;
+        size_t start = end;
+        log_header_t header;
+
+        // Records within a sector are in order, so send them in one run. As
+        // when mounting, a torn record ends the sector
+        while (offset < end && log_record_valid(offset, &header))
+        {
+            if (start == end &&
+                (everything || (int32_t)(header.sequence - after) > 0))
+            {
+                start = offset;
+            }
+
+            if (start != end)
+            {
+                last = header.sequence;
+            }
+
+            offset += sizeof(log_header_t) + header.length;
+        }
+
+        if (start != end)
+        {
+            log_send(start, offset - start);
+            sent = true;
+        }
+    }
+
+    return sent ? mp_obj_new_int_from_uint(last) : mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(logstore_export_obj, 1, 2, logstore_export);
+
+STATIC mp_obj_t logstore_erase(mp_obj_t self_in)
+{
+    log_mount();
+
+    // Sequence numbers carry on, so that exports stay in order
+    logstore.page_head = 0;
+    logstore.page_count = 0;
+    monocle_flash_erase(MICROPY_HW_FLASH_LOG_START, MICROPY_HW_FLASH_LOG_SIZE);
+    logstore.write = 0;
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(logstore_erase_obj, logstore_erase);
+
+STATIC const mp_rom_map_elem_t logstore_locals_dict_table[] = {
+
+    {MP_ROM_QSTR(MP_QSTR_append), MP_ROM_PTR(&logstore_append_obj)},
+    {MP_ROM_QSTR(MP_QSTR_flush), MP_ROM_PTR(&logstore_flush_obj)},
+    {MP_ROM_QSTR(MP_QSTR_export), MP_ROM_PTR(&logstore_export_obj)},
+    {MP_ROM_QSTR(MP_QSTR_erase), MP_ROM_PTR(&logstore_erase_obj)},
+};
+STATIC MP_DEFINE_CONST_DICT(logstore_locals_dict, logstore_locals_dict_table);
+
+STATIC void logstore_print(const mp_print_t *print, mp_obj_t self_in,
+                           mp_print_kind_t kind)
+{
+    mp_printf(print, "LogStore(start=0x%08x, len=%u, sequence=%u)",
+              MICROPY_HW_FLASH_LOG_START, MICROPY_HW_FLASH_LOG_SIZE,
+              logstore.sequence);
+}
+
+STATIC mp_obj_t logstore_make_new(const mp_obj_type_t *type, size_t n_args,
+                                  size_t n_kw, const mp_obj_t *args)
+{
+    mp_arg_check_num(n_args, n_kw, 0, 0, false);
+
+    log_mount();
+
+    logstore_obj_t *self = mp_obj_malloc(logstore_obj_t, &device_logstore_type);
+    return MP_OBJ_FROM_PTR(self);
+}
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    device_logstore_type,
+    MP_QSTR_LogStore,
+    MP_TYPE_FLAG_NONE,
+    make_new, logstore_make_new,
+    print, logstore_print,
+    locals_dict, &logstore_locals_dict);
@@ -30,19 +30,22 @@ static uint8_t microphone_bit_depth = 16;
 
 static inline void microphone_fpga_read(uint16_t address, uint8_t *buffer, size_t length)
 {
-    uint8_t address_bytes[2] = {(uint8_t)(address >> 8), (uint8_t)address};
-
-    monocle_spi_write(FPGA, address_bytes, 2, true);
-
     // Dump the data into a dummy buffer if a buffer isn't provided
     if (buffer == NULL)
     {
         uint8_t dummy_buffer[254];
-        monocle_spi_read(FPGA, dummy_buffer, length, false);
+
+        while (length > 0)
+        {
+            size_t chunk = MIN(length, sizeof(dummy_buffer));
+            monocle_fpga_read(address, dummy_buffer, chunk);
+            length -= chunk;
+        }
+
         return;
     }
 
-    monocle_spi_read(FPGA, buffer, length, false);
+    monocle_fpga_read(address, buffer, length);
 }
 
 static inline void microphone_fpga_write(uint16_t address, uint8_t *buffer, size_t length)
@@ -63,15 +66,7 @@ static size_t microphone_bytes_available(void)
 {
     uint8_t available_bytes[2] = {0, 0};
     microphone_fpga_read(0x5801, available_bytes, sizeof(available_bytes));
-    size_t available = (available_bytes[0] << 8 | available_bytes[1]) * 2;
-
-    // Cap to 254 due to SPI DMA limit
-    if (available > 254)
-    {
-        available = 254;
-    }
-
-    return available;
+    return (available_bytes[0] << 8 | available_bytes[1]) * 2;
 }
 
 STATIC mp_obj_t microphone_init(void)
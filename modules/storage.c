@@ -25,6 +25,7 @@
 #include <string.h>
 #include <math.h>
 #include "monocle.h"
+#include "storage.h"
 #include "extmod/vfs.h"
 #include "py/mperrno.h"
 #include "py/mphal.h"
@@ -32,13 +33,207 @@
 
 const struct _mp_obj_type_t device_storage_type;
 
+#if MICROPY_HW_STORAGE_CACHE_LINE_SIZE != 256 && \
+    MICROPY_HW_STORAGE_CACHE_LINE_SIZE != 4096
+#error "storage cache lines must be either 256 or 4096 bytes"
+#endif
+
+#if MICROPY_HW_STORAGE_CACHE_SIZE < MICROPY_HW_STORAGE_CACHE_LINE_SIZE || \
+    MICROPY_HW_STORAGE_CACHE_SIZE % MICROPY_HW_STORAGE_CACHE_LINE_SIZE != 0
+#error "the storage cache must hold a whole number of lines"
+#endif
+
+#define STORAGE_CACHE_LINE_SIZE MICROPY_HW_STORAGE_CACHE_LINE_SIZE
+#define STORAGE_CACHE_LINES (MICROPY_HW_STORAGE_CACHE_SIZE / \
+                             STORAGE_CACHE_LINE_SIZE)
+
+// What VfsLfs2 makes of the geometry below. littlefs reads at most this much
+// through its own cache, and anything longer is file data read in bulk
+#define STORAGE_LFS_CACHE_SIZE (1024)
+
+// Extra ioctl operations for tuning the cache. Resetting also empties it
+#define STORAGE_IOCTL_CACHE_HITS (0x100)
+#define STORAGE_IOCTL_CACHE_MISSES (0x101)
+#define STORAGE_IOCTL_CACHE_RESET (0x102)
+
+// Least recently used lines of flash. littlefs re-reads its superblock and
+// directories constantly, and writes and erases invalidate what they touch
+static struct storage_cache_t
+{
+    uint8_t data[STORAGE_CACHE_LINES][STORAGE_CACHE_LINE_SIZE];
+    uint32_t address[STORAGE_CACHE_LINES];
+    uint32_t last_used[STORAGE_CACHE_LINES];
+    bool valid[STORAGE_CACHE_LINES];
+    uint32_t clock;
+    uint32_t hits;
+    uint32_t misses;
+} storage_cache;
+
+static size_t storage_cache_line(uint32_t address)
+{
+    size_t victim = 0;
+
+    for (size_t i = 0; i < STORAGE_CACHE_LINES; i++)
+    {
+        if (storage_cache.valid[i] && storage_cache.address[i] == address)
+        {
+            storage_cache.hits++;
+            storage_cache.last_used[i] = ++storage_cache.clock;
+            return i;
+        }
+
+        if (!storage_cache.valid[victim])
+        {
+            continue;
+        }
+
+        if (!storage_cache.valid[i] ||
+            storage_cache.last_used[i] < storage_cache.last_used[victim])
+        {
+            victim = i;
+        }
+    }
+
+    storage_cache.misses++;
+
+    monocle_flash_read(storage_cache.data[victim],
+                       address,
+                       STORAGE_CACHE_LINE_SIZE);
+
+    storage_cache.address[victim] = address;
+    storage_cache.last_used[victim] = ++storage_cache.clock;
+    storage_cache.valid[victim] = true;
+
+    return victim;
+}
+
+static void storage_cache_read(uint8_t *buffer, uint32_t address, size_t length)
+{
+    // Bulk reads would only flush out metadata, so they go straight to flash
+    if (length > STORAGE_LFS_CACHE_SIZE)
+    {
+        monocle_flash_read(buffer, address, length);
+        return;
+    }
+
+    while (length > 0)
+    {
+        uint32_t line_address = address & ~(STORAGE_CACHE_LINE_SIZE - 1);
+        size_t offset = address - line_address;
+        size_t chunk = MIN(length, STORAGE_CACHE_LINE_SIZE - offset);
+
+        size_t line = storage_cache_line(line_address);
+        memcpy(buffer, storage_cache.data[line] + offset, chunk);
+
+        buffer += chunk;
+        address += chunk;
+        length -= chunk;
+    }
+}
+
+static void storage_cache_invalidate(uint32_t address, size_t length)
+{
+    for (size_t i = 0; i < STORAGE_CACHE_LINES; i++)
+    {
+        if (storage_cache.valid[i] &&
+            storage_cache.address[i] < address + length &&
+            storage_cache.address[i] + STORAGE_CACHE_LINE_SIZE > address)
+        {
+            storage_cache.valid[i] = false;
+        }
+    }
+}
+
+// Spans every Storage made since the last soft reset, which other users of
+// the flash stay clear of. Filesystems from older layouts reach further than
+// the default
+static struct storage_claimed_t
+{
+    size_t start;
+    size_t end;
+} storage_claimed = {
+    .start = SIZE_MAX,
+    .end = 0,
+};
+
+bool storage_overlaps(size_t address, size_t length)
+{
+    return address < storage_claimed.end &&
+           address + length > storage_claimed.start;
+}
+
+void storage_reset(void)
+{
+    // Filesystems are mounted again after a soft reset, claiming what they use
+    storage_claimed.start = SIZE_MAX;
+    storage_claimed.end = 0;
+}
+
 typedef struct _storage_obj_t
 {
     mp_obj_base_t base;
     uint32_t start;
     uint32_t len;
+    uint32_t prog_size;
+    bool verify;
 } storage_obj_t;
 
+// One flash page. Writes must be whole multiples of the program size
+#define STORAGE_PROG_SIZE (256)
+
+// Same value as LFS_ERR_CORRUPT, which makes littlefs relocate to a new block
+#define STORAGE_ERR_CORRUPT (-84)
+
+#define STORAGE_VERIFY_CHUNK (64)
+
+/**
+ * @brief Checks that programming data at address only clears bits, which is
+ *        all a page program can do without an erase first. Only done along
+ *        with verify, as it reads the whole range back first.
+ */
+static bool storage_programmable(const uint8_t *data, uint32_t address,
+                                 size_t length)
+{
+    uint8_t flash[STORAGE_VERIFY_CHUNK];
+
+    for (size_t i = 0; i < length; i += STORAGE_VERIFY_CHUNK)
+    {
+        size_t chunk = MIN(length - i, STORAGE_VERIFY_CHUNK);
+        monocle_flash_read(flash, address + i, chunk);
+
+        for (size_t j = 0; j < chunk; j++)
+        {
+            if ((flash[j] & data[i + j]) != data[i + j])
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Reads back a program straight from flash, bypassing the cache.
+ */
+static bool storage_verify(const uint8_t *data, uint32_t address, size_t length)
+{
+    uint8_t flash[STORAGE_VERIFY_CHUNK];
+
+    for (size_t i = 0; i < length; i += STORAGE_VERIFY_CHUNK)
+    {
+        size_t chunk = MIN(length - i, STORAGE_VERIFY_CHUNK);
+        monocle_flash_read(flash, address + i, chunk);
+
+        if (memcmp(flash, data + i, chunk) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 mp_obj_t storage_readblocks(size_t n_args, const mp_obj_t *args)
 {
     storage_obj_t *self = MP_OBJ_TO_PTR(args[0]);
@@ -56,7 +251,7 @@ mp_obj_t storage_readblocks(size_t n_args, const mp_obj_t *args)
         address += offset;
     }
 
-    monocle_flash_read(bufinfo.buf, address, bufinfo.len);
+    storage_cache_read(bufinfo.buf, address, bufinfo.len);
 
     return mp_const_none;
 }
@@ -69,22 +264,43 @@ mp_obj_t storage_writeblocks(size_t n_args, const mp_obj_t *args)
     mp_obj_t buffer = args[2];
 
     mp_buffer_info_t bufinfo;
-    mp_get_buffer_raise(buffer, &bufinfo, MP_BUFFER_WRITE);
-
-    mp_int_t address = self->start + (block_num * 4096);
+    mp_get_buffer_raise(buffer, &bufinfo, MP_BUFFER_READ);
 
+    uint32_t offset = 0;
     if (n_args == 4)
     {
-        uint32_t offset = mp_obj_get_int(args[3]);
-        address += offset;
+        offset = mp_obj_get_int(args[3]);
     }
-    else
+
+    // Programs only, erases are left to MP_BLOCKDEV_IOCTL_BLOCK_ERASE
+    if (block_num * 4096 + offset + bufinfo.len > self->len)
     {
-        monocle_flash_page_erase(address);
+        return MP_OBJ_NEW_SMALL_INT(-MP_EIO);
+    }
+
+    // Whole program units only, so that no page is programmed in pieces
+    // which the filesystem doesn't know about
+    if (offset % self->prog_size || bufinfo.len % self->prog_size)
+    {
+        return MP_OBJ_NEW_SMALL_INT(-MP_EINVAL);
     }
 
+    mp_int_t address = self->start + (block_num * 4096) + offset;
+
+    if (self->verify &&
+        !storage_programmable(bufinfo.buf, address, bufinfo.len))
+    {
+        return MP_OBJ_NEW_SMALL_INT(STORAGE_ERR_CORRUPT);
+    }
+
+    storage_cache_invalidate(address, bufinfo.len);
     monocle_flash_write(bufinfo.buf, address, bufinfo.len);
 
+    if (self->verify && !storage_verify(bufinfo.buf, address, bufinfo.len))
+    {
+        return MP_OBJ_NEW_SMALL_INT(STORAGE_ERR_CORRUPT);
+    }
+
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(storage_writeblocks_obj, 3, 4, storage_writeblocks);
@@ -108,6 +324,7 @@ mp_obj_t storage_ioctl(mp_obj_t self_in, mp_obj_t op_in, mp_obj_t arg_in)
 
     case MP_BLOCKDEV_IOCTL_SYNC:
     {
+        monocle_flash_sync();
         return MP_OBJ_NEW_SMALL_INT(0);
     }
 
@@ -126,15 +343,33 @@ mp_obj_t storage_ioctl(mp_obj_t self_in, mp_obj_t op_in, mp_obj_t arg_in)
         mp_int_t block_num = mp_obj_get_int(arg_in);
         mp_int_t address = self->start + (block_num * 4096);
 
-        if ((address & 0x3) || (address % 4096 != 0))
+        if ((address & 0x3) || (address % 4096 != 0) ||
+            block_num * 4096 >= self->len)
         {
             return MP_OBJ_NEW_SMALL_INT(-MP_EIO);
         }
 
+        storage_cache_invalidate(address, 4096);
         monocle_flash_page_erase(address);
         return MP_OBJ_NEW_SMALL_INT(0);
     }
 
+    case STORAGE_IOCTL_CACHE_HITS:
+    {
+        return mp_obj_new_int_from_uint(storage_cache.hits);
+    }
+
+    case STORAGE_IOCTL_CACHE_MISSES:
+    {
+        return mp_obj_new_int_from_uint(storage_cache.misses);
+    }
+
+    case STORAGE_IOCTL_CACHE_RESET:
+    {
+        memset(&storage_cache, 0, sizeof(storage_cache));
+        return MP_OBJ_NEW_SMALL_INT(0);
+    }
+
     default:
         return mp_const_none;
     }
@@ -146,20 +381,36 @@ STATIC const mp_rom_map_elem_t storage_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_readblocks), MP_ROM_PTR(&storage_readblocks_obj)},
     {MP_ROM_QSTR(MP_QSTR_writeblocks), MP_ROM_PTR(&storage_writeblocks_obj)},
     {MP_ROM_QSTR(MP_QSTR_ioctl), MP_ROM_PTR(&storage_ioctl_obj)},
+
+    // Geometry hints for littlefs. Programs are a whole flash page, caches
+    // are what VfsLfs2 derives from these, and the lookahead covers 1MB
+    {MP_ROM_QSTR(MP_QSTR_READ_SIZE), MP_ROM_INT(64)},
+    {MP_ROM_QSTR(MP_QSTR_PROG_SIZE), MP_ROM_INT(STORAGE_PROG_SIZE)},
+    {MP_ROM_QSTR(MP_QSTR_CACHE_SIZE), MP_ROM_INT(STORAGE_LFS_CACHE_SIZE)},
+    {MP_ROM_QSTR(MP_QSTR_LOOKAHEAD_SIZE), MP_ROM_INT(32)},
 };
 STATIC MP_DEFINE_CONST_DICT(storage_locals_dict, storage_locals_dict_table);
 
 STATIC void storage_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
 {
     storage_obj_t *self = MP_OBJ_TO_PTR(self_in);
-    mp_printf(print, "Storage(start=0x%08x, len=%u)", self->start, self->len);
+    mp_printf(print, "Storage(start=0x%08x, len=%u", self->start, self->len);
+
+    if (self->prog_size != STORAGE_PROG_SIZE)
+    {
+        mp_printf(print, ", prog_size=%u", self->prog_size);
+    }
+
+    mp_printf(print, "%s)", self->verify ? ", verify=True" : "");
 }
 
 STATIC mp_obj_t storage_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args)
 {
     static const mp_arg_t allowed_args[] = {
         {MP_QSTR_start, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0x6D000}},
-        {MP_QSTR_length, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0x93000}},
+        {MP_QSTR_length, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = MICROPY_HW_FLASH_LOG_START - 0x6D000}},
+        {MP_QSTR_verify, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false}},
+        {MP_QSTR_prog_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = STORAGE_PROG_SIZE}},
     };
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
@@ -178,6 +429,14 @@ STATIC mp_obj_t storage_make_new(const mp_obj_type_t *type, size_t n_args, size_
         mp_raise_ValueError(MP_ERROR_TEXT("length cannot be less than zero"));
     }
 
+    mp_int_t prog_size = args[3].u_int;
+
+    if (prog_size < 1 || prog_size > STORAGE_PROG_SIZE ||
+        STORAGE_PROG_SIZE % prog_size)
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT("prog_size must divide 256"));
+    }
+
     if (length + start > 0x100000)
     {
         mp_raise_ValueError(MP_ERROR_TEXT("start + length must be less than 0x100000"));
@@ -186,6 +445,11 @@ STATIC mp_obj_t storage_make_new(const mp_obj_type_t *type, size_t n_args, size_
     storage_obj_t *self = mp_obj_malloc(storage_obj_t, &device_storage_type);
     self->start = start;
     self->len = length;
+    self->verify = args[2].u_bool;
+    self->prog_size = prog_size;
+
+    storage_claimed.start = MIN(storage_claimed.start, (size_t)start);
+    storage_claimed.end = MAX(storage_claimed.end, (size_t)(start + length));
     return MP_OBJ_FROM_PTR(self);
 }
 
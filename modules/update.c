@@ -72,7 +72,7 @@ STATIC mp_obj_t update_fpga_app_write(mp_obj_t bytes)
             MP_ERROR_TEXT("data will overflow the space reserved for the app"));
     }
 
-    monocle_flash_write((uint8_t *)data, fpga_app_programmed_bytes, length);
+    monocle_flash_write((const uint8_t *)data, fpga_app_programmed_bytes, length);
 
     fpga_app_programmed_bytes += length;
 
@@ -82,10 +82,8 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(update_write_fpga_app_obj, update_fpga_app_writ
 
 STATIC mp_obj_t update_fpga_app_delete(void)
 {
-    for (size_t i = 0; i < 0x6D; i++)
-    {
-        monocle_flash_page_erase(i * 0x1000);
-    }
+    // Block erases cover most of the slot, rather than 109 sector erases
+    monocle_flash_erase(0, 0x6D000);
 
     fpga_app_programmed_bytes = 0;
 
@@ -152,19 +152,26 @@ void monocle_critical_startup(void)
     // Enable systick timer functions
     nrfx_systick_init();
 
-    // Set up the I2C buses
+    // Set up the I2C buses. Fast mode needs the pull-ups to meet its 300ns
+    // rise time, which hasn't been checked on the board yet
     {
+#if MONOCLE_I2C_400K
+        const nrf_twim_frequency_t i2c_frequency = NRF_TWIM_FREQ_400K;
+#else
+        const nrf_twim_frequency_t i2c_frequency = NRF_TWIM_FREQ_100K;
+#endif
+
         nrfx_twim_config_t bus_0_config = NRFX_TWIM_DEFAULT_CONFIG(
             PMIC_TOUCH_I2C_SCL_PIN,
             PMIC_TOUCH_I2C_SDA_PIN);
 
-        bus_0_config.frequency = NRF_TWIM_FREQ_100K;
+        bus_0_config.frequency = i2c_frequency;
 
         nrfx_twim_config_t bus_1_config = NRFX_TWIM_DEFAULT_CONFIG(
             CAMERA_I2C_SCL_PIN,
             CAMERA_I2C_SDA_PIN);
 
-        bus_1_config.frequency = NRF_TWIM_FREQ_100K;
+        bus_1_config.frequency = i2c_frequency;
 
         app_err(nrfx_twim_init(&i2c_bus_0, &bus_0_config, NULL, NULL));
         app_err(nrfx_twim_init(&i2c_bus_1, &bus_1_config, NULL, NULL));
@@ -188,50 +195,32 @@ void monocle_critical_startup(void)
         // Turn off the FPGA, flash, display and camera rails
         power_all_rails(false);
 
-        // Set the SBB drive strength
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x2F, 0x03, 0x01).fail);
-
-        // Adjust SBB2 to 1.2V
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x2D, 0xFF, 0x08).fail);
-
-        // Adjust SBB1 (1.8V main rail) current limit to 500mA
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x2C, 0x30, 0x20).fail);
-
-        // Adjust SBB0 to 2.8V
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x29, 0xFF, 0x28).fail);
-
-        // Configure LEDs on GPIO0 and GPIO1 as open drain outputs. Set to hi-z
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x11, 0x2D, 0x08).fail);
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x12, 0x2D, 0x08).fail);
-
-        // Set LDO1 to 3.3V and turn on (for LEDs)
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x3A, 0xFF, 0x64).fail);
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x3B, 0x1F, 0x0F).fail);
-
-        // Vhot & Vwarm = 45 degrees. Vcool = 15 degrees. Vcold = 0 degrees
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x20, 0xFF, 0x2E).fail);
-
-        // Set CHGIN limit to 475mA
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x21, 0x1C, 0x10).fail);
-
-        // Charge termination current = 5%
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x22, 0x18, 0x00).fail);
-
-        // Set junction regulation temperature to 70 degrees TODO increase this?
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x23, 0xE0, 0x20).fail);
-
-        // Set the fast charge current value to 120mA
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x24, 0xFC, 0x3C).fail);
-
-        // Set the Vcool & Vwarm current to 75mA, and enable the thermistor
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x25, 0xFE, 0x26).fail);
-
-        // Set constant voltage to 4.3V for both fast charge and JEITA
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x26, 0xFC, 0x70).fail);
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x27, 0xFC, 0x70).fail);
-
-        // Connect AMUX to battery voltage
-        app_err(monocle_i2c_write(PMIC_I2C_ADDRESS, 0x28, 0x0F, 0x03).fail);
+        // Consecutive registers below are written together, so keep the
+        // charger settings in address order
+        static const i2c_register_t pmic_config[] = {
+            {0x2F, 0x03, 0x01}, // Set the SBB drive strength
+            {0x2D, 0xFF, 0x08}, // Adjust SBB2 to 1.2V
+            {0x2C, 0x30, 0x20}, // Adjust SBB1 (1.8V main rail) current limit to 500mA
+            {0x29, 0xFF, 0x28}, // Adjust SBB0 to 2.8V
+            {0x11, 0x2D, 0x08}, // Configure LEDs on GPIO0 and GPIO1 as open drain outputs. Set to hi-z
+            {0x12, 0x2D, 0x08},
+            {0x3A, 0xFF, 0x64}, // Set LDO1 to 3.3V and turn on (for LEDs)
+            {0x3B, 0x1F, 0x0F},
+            {0x20, 0xFF, 0x2E}, // Vhot & Vwarm = 45 degrees. Vcool = 15 degrees. Vcold = 0 degrees
+            {0x21, 0x1C, 0x10}, // Set CHGIN limit to 475mA
+            {0x22, 0x18, 0x00}, // Charge termination current = 5%
+            {0x23, 0xE0, 0x20}, // Set junction regulation temperature to 70 degrees TODO increase this?
+            {0x24, 0xFC, 0x3C}, // Set the fast charge current value to 120mA
+            {0x25, 0xFE, 0x26}, // Set the Vcool & Vwarm current to 75mA, and enable the thermistor
+            {0x26, 0xFC, 0x70}, // Set constant voltage to 4.3V for both fast charge and JEITA
+            {0x27, 0xFC, 0x70},
+            {0x28, 0x0F, 0x03}, // Connect AMUX to battery voltage
+        };
+
+        app_err(monocle_i2c_write_table(PMIC_I2C_ADDRESS,
+                                        pmic_config,
+                                        sizeof(pmic_config) / sizeof(i2c_register_t))
+                    .fail);
     }
 
     // Configure the touch IC
@@ -310,7 +299,7 @@ void monocle_critical_startup(void)
                      NRF_GPIO_PIN_S0D1,
                      NRF_GPIO_PIN_NOSENSE);
 
-        // TODO Add interrupt functionality to the FPGA_RESET_INT pin
+        // Its interrupt is set up along with the touch one, in main.c
 
         // Keep camera, display and FPGA in reset
         nrf_gpio_pin_write(CAMERA_RESET_PIN, false);
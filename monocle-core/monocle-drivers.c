@@ -22,11 +22,13 @@
  * PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <string.h>
 #include "monocle.h"
 #include "py/mphal.h"
 #include "py/runtime.h"
 #include "nrf_gpio.h"
 #include "nrfx_spim.h"
+#include "nrfx_timer.h"
 #include "nrfx_twim.h"
 #include "nrfx_systick.h"
 
@@ -62,76 +64,149 @@ static const nrfx_spim_t spi_bus_2 = NRFX_SPIM_INSTANCE(2);
 
 bool not_real_hardware_flag = false;
 
-i2c_response_t monocle_i2c_read(uint8_t device_address_7bit,
-                                uint16_t register_address,
-                                uint8_t register_mask)
+// The camera takes 16-bit register addresses, and everything else 8-bit
+static nrfx_twim_t i2c_bus_for(uint8_t device_address_7bit,
+                               uint16_t register_address,
+                               uint8_t *address_bytes,
+                               size_t *address_length)
 {
-    if (not_real_hardware_flag)
+    if (device_address_7bit == CAMERA_I2C_ADDRESS)
     {
-        return (i2c_response_t){.fail = false, .value = 0x00};
+        address_bytes[0] = (uint8_t)(register_address >> 8);
+        address_bytes[1] = (uint8_t)register_address;
+        *address_length = 2;
+        return i2c_bus_1;
     }
 
-    // Populate the default response in case of failure
-    i2c_response_t i2c_response = {
-        .fail = true,
-        .value = 0x00,
-    };
+    address_bytes[0] = (uint8_t)register_address;
+    *address_length = 1;
+    return i2c_bus_0;
+}
 
-    // Create the tx payload, bus handle and transfer descriptors
-    uint8_t tx_payload[2] = {(uint8_t)(register_address), 0};
+// A busy bus is retried on reads, but is fatal for writes as it always was
+static bool i2c_xfer_failed(nrfx_err_t err, bool busy_is_fatal)
+{
+    if ((err == NRFX_ERROR_BUSY && busy_is_fatal) ||
+        err == NRFX_ERROR_NOT_SUPPORTED ||
+        err == NRFX_ERROR_INTERNAL ||
+        err == NRFX_ERROR_INVALID_ADDR ||
+        err == NRFX_ERROR_DRV_TWI_ERR_OVERRUN)
+    {
+        app_err(err);
+    }
 
-    nrfx_twim_t i2c_handle = i2c_bus_0;
+    return err != NRFX_SUCCESS;
+}
 
-    nrfx_twim_xfer_desc_t i2c_tx = NRFX_TWIM_XFER_DESC_TX(device_address_7bit,
-                                                          tx_payload,
-                                                          1);
+i2c_response_t monocle_i2c_read_burst(uint8_t device_address_7bit,
+                                      uint16_t register_address,
+                                      uint8_t *values,
+                                      size_t length)
+{
+    i2c_response_t resp = {.fail = false, .value = 0x00};
 
-    // Switch bus and use 16-bit addressing if the camera is requested
-    if (device_address_7bit == CAMERA_I2C_ADDRESS)
+    if (not_real_hardware_flag)
+    {
+        memset(values, 0x00, length);
+        return resp;
+    }
+
+    if (length == 0 || length > I2C_MAX_BURST_LENGTH)
     {
-        i2c_handle = i2c_bus_1;
-        tx_payload[0] = (uint8_t)(register_address >> 8);
-        tx_payload[1] = (uint8_t)register_address;
-        i2c_tx.primary_length = 2;
+        app_err(NRFX_ERROR_INVALID_LENGTH);
     }
 
+    uint8_t tx_payload[2];
+    size_t address_length;
+    nrfx_twim_t i2c_handle = i2c_bus_for(device_address_7bit,
+                                         register_address,
+                                         tx_payload,
+                                         &address_length);
+
+    nrfx_twim_xfer_desc_t i2c_tx = NRFX_TWIM_XFER_DESC_TX(device_address_7bit,
+                                                          tx_payload,
+                                                          address_length);
+
     nrfx_twim_xfer_desc_t i2c_rx = NRFX_TWIM_XFER_DESC_RX(device_address_7bit,
-                                                          &i2c_response.value,
-                                                          1);
+                                                          values,
+                                                          length);
 
     // Try several times
     for (uint8_t i = 0; i < 3; i++)
     {
-        nrfx_err_t tx_err = nrfx_twim_xfer(&i2c_handle, &i2c_tx, 0);
+        bool tx_failed = i2c_xfer_failed(nrfx_twim_xfer(&i2c_handle, &i2c_tx, 0),
+                                         false);
+        bool rx_failed = i2c_xfer_failed(nrfx_twim_xfer(&i2c_handle, &i2c_rx, 0),
+                                         false);
 
-        if (tx_err == NRFX_ERROR_NOT_SUPPORTED ||
-            tx_err == NRFX_ERROR_INTERNAL ||
-            tx_err == NRFX_ERROR_INVALID_ADDR ||
-            tx_err == NRFX_ERROR_DRV_TWI_ERR_OVERRUN)
+        if (!tx_failed && !rx_failed)
         {
-            app_err(tx_err);
+            return resp;
         }
+    }
 
-        nrfx_err_t rx_err = nrfx_twim_xfer(&i2c_handle, &i2c_rx, 0);
+    resp.fail = true;
+    return resp;
+}
 
-        if (rx_err == NRFX_ERROR_NOT_SUPPORTED ||
-            rx_err == NRFX_ERROR_INTERNAL ||
-            rx_err == NRFX_ERROR_INVALID_ADDR ||
-            rx_err == NRFX_ERROR_DRV_TWI_ERR_OVERRUN)
-        {
-            app_err(rx_err);
-        }
+i2c_response_t monocle_i2c_write_burst(uint8_t device_address_7bit,
+                                       uint16_t register_address,
+                                       const uint8_t *values,
+                                       size_t length)
+{
+    i2c_response_t resp = {.fail = false, .value = 0x00};
 
-        if (tx_err == NRFX_SUCCESS && rx_err == NRFX_SUCCESS)
+    if (not_real_hardware_flag)
+    {
+        return resp;
+    }
+
+    if (length == 0 || length > I2C_MAX_BURST_LENGTH)
+    {
+        app_err(NRFX_ERROR_INVALID_LENGTH);
+    }
+
+    // The register address followed by the values, in a single transfer
+    uint8_t tx_payload[2 + I2C_MAX_BURST_LENGTH];
+    size_t address_length;
+    nrfx_twim_t i2c_handle = i2c_bus_for(device_address_7bit,
+                                         register_address,
+                                         tx_payload,
+                                         &address_length);
+
+    memcpy(tx_payload + address_length, values, length);
+
+    nrfx_twim_xfer_desc_t i2c_tx = NRFX_TWIM_XFER_DESC_TX(device_address_7bit,
+                                                          tx_payload,
+                                                          address_length + length);
+
+    // Try several times
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        if (!i2c_xfer_failed(nrfx_twim_xfer(&i2c_handle, &i2c_tx, 0), true))
         {
-            i2c_response.fail = false;
-            break;
+            return resp;
         }
     }
 
-    i2c_response.value &= register_mask;
+    resp.fail = true;
+    return resp;
+}
+
+i2c_response_t monocle_i2c_read(uint8_t device_address_7bit,
+                                uint16_t register_address,
+                                uint8_t register_mask)
+{
+    uint8_t value = 0x00;
+
+    i2c_response_t resp = monocle_i2c_read_burst(device_address_7bit,
+                                                 register_address,
+                                                 &value,
+                                                 1);
 
-    return i2c_response;
+    resp.value = value & register_mask;
+
+    return resp;
 }
 
 i2c_response_t monocle_i2c_write(uint8_t device_address_7bit,
@@ -141,11 +216,7 @@ i2c_response_t monocle_i2c_write(uint8_t device_address_7bit,
 {
     i2c_response_t resp = {.fail = false, .value = 0x00};
 
-    if (not_real_hardware_flag)
-    {
-        return resp;
-    }
-
+    // Only a partial write needs the existing value
     if (register_mask != 0xFF)
     {
         resp = monocle_i2c_read(device_address_7bit, register_address, 0xFF);
@@ -160,53 +231,298 @@ i2c_response_t monocle_i2c_write(uint8_t device_address_7bit,
     uint8_t updated_value = (resp.value & ~register_mask) |
                             (set_value & register_mask);
 
-    // Create the tx payload, bus handle and transfer descriptor
-    uint8_t tx_payload[3] = {(uint8_t)register_address, updated_value, 0};
+    return monocle_i2c_write_burst(device_address_7bit,
+                                   register_address,
+                                   &updated_value,
+                                   1);
+}
 
-    nrfx_twim_t i2c_handle = i2c_bus_0;
+i2c_response_t monocle_i2c_write_table(uint8_t device_address_7bit,
+                                       const i2c_register_t *table,
+                                       size_t count)
+{
+    i2c_response_t resp = {.fail = false, .value = 0x00};
 
-    nrfx_twim_xfer_desc_t i2c_tx = NRFX_TWIM_XFER_DESC_TX(device_address_7bit,
-                                                          tx_payload,
-                                                          2);
+    for (size_t start = 0; start < count;)
+    {
+        // Group entries with consecutive addresses into one run
+        size_t length = 1;
+        bool masked = table[start].mask != 0xFF;
 
-    // Switch bus and use 16-bit addressing if the camera is requested
-    if (device_address_7bit == CAMERA_I2C_ADDRESS)
+        while (start + length < count &&
+               length < I2C_MAX_BURST_LENGTH &&
+               table[start + length].address == table[start].address + length)
+        {
+            masked |= table[start + length].mask != 0xFF;
+            length++;
+        }
+
+        // Partial writes read the whole run first, in one go
+        uint8_t values[I2C_MAX_BURST_LENGTH];
+
+        if (masked)
+        {
+            resp = monocle_i2c_read_burst(device_address_7bit,
+                                          table[start].address,
+                                          values,
+                                          length);
+
+            if (resp.fail)
+            {
+                return resp;
+            }
+        }
+
+        for (size_t i = 0; i < length; i++)
+        {
+            const i2c_register_t *reg = &table[start + i];
+            uint8_t existing = masked ? values[i] : 0x00;
+            values[i] = (existing & ~reg->mask) | (reg->value & reg->mask);
+        }
+
+        resp = monocle_i2c_write_burst(device_address_7bit,
+                                       table[start].address,
+                                       values,
+                                       length);
+
+        if (resp.fail)
+        {
+            return resp;
+        }
+
+        start += length;
+    }
+
+    return resp;
+}
+
+static const uint8_t spi_cs_pins[] = {
+    [DISPLAY] = DISPLAY_CS_PIN,
+    [FPGA] = FPGA_CS_MODE_PIN,
+    [FLASH] = FLASH_CS_PIN,
+};
+
+// Flash is clocked faster once it's known to support it
+static nrf_spim_frequency_t spi_frequencies[] = {
+    [DISPLAY] = NRF_SPIM_FREQ_4M,
+    [FPGA] = NRF_SPIM_FREQ_4M,
+    [FLASH] = NRF_SPIM_FREQ_4M,
+};
+
+static nrf_spim_frequency_t spi_frequency;
+
+static struct spi_queue_t
+{
+    spi_transaction_t *active;
+    spi_transaction_t *head;
+    spi_transaction_t *tail;
+    bool held;
+    spi_device_t held_device;
+} spi_queue;
+
+// Staging area for flash data and constants, as EasyDMA only reads from RAM
+static uint8_t spi_tx_staging[255];
+
+#define R2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n) R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n) R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+
+static const uint8_t bit_reverse_table[256] = {R6(0), R6(2), R6(1), R6(3)};
+
+void monocle_bit_reverse(uint8_t *destination, const uint8_t *source,
+                         size_t length)
+{
+    size_t i = 0;
+
+#if defined(__ARM_ARCH_7EM__)
+    // RBIT flips the whole word, and REV puts the bytes back in order
+    for (; i + 4 <= length; i += 4)
     {
-        i2c_handle = i2c_bus_1;
-        tx_payload[0] = (uint8_t)(register_address >> 8);
-        tx_payload[1] = (uint8_t)register_address;
-        tx_payload[2] = updated_value;
-        i2c_tx.primary_length = 3;
+        uint32_t word;
+        memcpy(&word, source + i, sizeof(word));
+        word = __REV(__RBIT(word));
+        memcpy(destination + i, &word, sizeof(word));
     }
+#endif
 
-    // Try several times
-    for (uint8_t i = 0; i < 3; i++)
+    for (; i < length; i++)
+    {
+        destination[i] = bit_reverse_table[source[i]];
+    }
+}
+
+uint16_t monocle_crc16(uint16_t crc, const uint8_t *bytes, size_t length)
+{
+    // A nibble at a time, so that the table only takes 32 bytes
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+
+    for (size_t i = 0; i < length; i++)
     {
-        nrfx_err_t err = nrfx_twim_xfer(&i2c_handle, &i2c_tx, 0);
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (bytes[i] >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (bytes[i] & 0x0F)];
+    }
+
+    return crc;
+}
+
+static void spi_start_chunk(spi_transaction_t *transaction)
+{
+    // EasyDMA can only move 255 bytes at a time, so longer phases are chained
+    nrfx_spim_xfer_desc_t xfer;
 
-        if (err == NRFX_ERROR_BUSY ||
-            err == NRFX_ERROR_NOT_SUPPORTED ||
-            err == NRFX_ERROR_INTERNAL ||
-            err == NRFX_ERROR_INVALID_ADDR ||
-            err == NRFX_ERROR_DRV_TWI_ERR_OVERRUN)
+    if (transaction->position < transaction->tx_length)
+    {
+        size_t offset = transaction->position;
+        size_t length = MIN(transaction->tx_length - offset, 255);
+        const uint8_t *data = transaction->tx_buffer + offset;
+
+        // Flash is LSB first, so the bytes are flipped on their way out
+        if (transaction->device == FLASH)
+        {
+            monocle_bit_reverse(spi_tx_staging, data, length);
+            data = spi_tx_staging;
+        }
+        else if (!nrfx_is_in_ram(data))
         {
-            app_err(err);
+            memcpy(spi_tx_staging, data, length);
+            data = spi_tx_staging;
         }
 
-        if (err == NRFX_SUCCESS)
+        xfer = (nrfx_spim_xfer_desc_t)NRFX_SPIM_XFER_TX(data, length);
+    }
+    else
+    {
+        size_t offset = transaction->position - transaction->tx_length;
+        size_t length = MIN(transaction->rx_length - offset, 255);
+        xfer = (nrfx_spim_xfer_desc_t)NRFX_SPIM_XFER_RX(
+            transaction->rx_buffer + offset, length);
+    }
+
+    app_err(nrfx_spim_xfer(&spi_bus_2, &xfer, 0));
+}
+
+static spi_transaction_t *spi_take_next(void)
+{
+    // Called with interrupts masked. While a device holds CS down, only the
+    // next leg of its sequence may go, so that nothing cuts into it. Not even
+    // a status poll queued for the same device from an interrupt
+    if (spi_queue.active != NULL)
+    {
+        return NULL;
+    }
+
+    spi_transaction_t *previous = NULL;
+
+    for (spi_transaction_t *next = spi_queue.head;
+         next != NULL;
+         previous = next, next = next->next)
+    {
+        if (spi_queue.held && (!next->continues_hold ||
+                               next->device != spi_queue.held_device))
         {
-            break;
+            continue;
         }
 
-        // If the last try failed. Don't continue
-        if (i == 2)
+        if (previous == NULL)
         {
-            resp.fail = true;
-            return resp;
+            spi_queue.head = next->next;
+        }
+        else
+        {
+            previous->next = next->next;
         }
+
+        if (spi_queue.tail == next)
+        {
+            spi_queue.tail = previous;
+        }
+
+        spi_queue.active = next;
+        return next;
     }
 
-    return resp;
+    return NULL;
+}
+
+static void spi_start(spi_transaction_t *transaction);
+
+static void spi_finish(spi_transaction_t *transaction)
+{
+    if (!transaction->hold_down_cs)
+    {
+        nrf_gpio_pin_set(spi_cs_pins[transaction->device]);
+    }
+
+    void (*callback)(spi_transaction_t *) = transaction->callback;
+    spi_transaction_t *next;
+
+    NRFX_CRITICAL_SECTION_ENTER();
+    spi_queue.held = transaction->hold_down_cs;
+    spi_queue.held_device = transaction->device;
+    spi_queue.active = NULL;
+    next = spi_take_next();
+    NRFX_CRITICAL_SECTION_EXIT();
+
+    transaction->done = true;
+
+    // Keep the bus busy before handing over, callbacks may queue more
+    if (next != NULL)
+    {
+        spi_start(next);
+    }
+
+    if (callback != NULL)
+    {
+        callback(transaction);
+    }
+}
+
+static void spi_start(spi_transaction_t *transaction)
+{
+    if (spi_frequencies[transaction->device] != spi_frequency)
+    {
+        spi_frequency = spi_frequencies[transaction->device];
+        nrf_spim_frequency_set(spi_bus_2.p_reg, spi_frequency);
+    }
+
+    nrf_gpio_pin_clear(spi_cs_pins[transaction->device]);
+
+    if (transaction->tx_length + transaction->rx_length == 0)
+    {
+        spi_finish(transaction);
+        return;
+    }
+
+    spi_start_chunk(transaction);
+}
+
+static void spi_event_handler(nrfx_spim_evt_t const *p_event, void *p_context)
+{
+    (void)p_context;
+
+    spi_transaction_t *transaction = spi_queue.active;
+
+    // Flash is LSB first, so each chunk is flipped as soon as it's in
+    if (transaction->device == FLASH && p_event->xfer_desc.rx_length > 0)
+    {
+        monocle_bit_reverse(p_event->xfer_desc.p_rx_buffer,
+                            p_event->xfer_desc.p_rx_buffer,
+                            p_event->xfer_desc.rx_length);
+    }
+
+    transaction->position += p_event->xfer_desc.tx_length +
+                             p_event->xfer_desc.rx_length;
+
+    if (transaction->position <
+        transaction->tx_length + transaction->rx_length)
+    {
+        spi_start_chunk(transaction);
+        return;
+    }
+
+    spi_finish(transaction);
 }
 
 void monocle_spi_enable(bool enable)
@@ -227,118 +543,362 @@ void monocle_spi_enable(bool enable)
     config.mode = NRF_SPIM_MODE_3;
     config.bit_order = NRF_SPIM_BIT_ORDER_LSB_FIRST;
 
-    app_err(nrfx_spim_init(&spi_bus_2, &config, NULL, NULL));
+    spi_queue.active = NULL;
+    spi_queue.head = NULL;
+    spi_queue.tail = NULL;
+    spi_queue.held = false;
+    spi_frequency = config.frequency;
+
+    app_err(nrfx_spim_init(&spi_bus_2, &config, spi_event_handler, NULL));
+}
+
+void monocle_spi_queue(spi_transaction_t *transaction)
+{
+    transaction->position = 0;
+    transaction->done = false;
+    transaction->next = NULL;
+
+    spi_transaction_t *next;
+
+    NRFX_CRITICAL_SECTION_ENTER();
+    if (spi_queue.head == NULL)
+    {
+        spi_queue.head = transaction;
+    }
+    else
+    {
+        spi_queue.tail->next = transaction;
+    }
+    spi_queue.tail = transaction;
+    next = spi_take_next();
+    NRFX_CRITICAL_SECTION_EXIT();
+
+    if (next != NULL)
+    {
+        spi_start(next);
+    }
 }
 
-static uint8_t bit_reverse(uint8_t byte)
+void monocle_spi_wait(spi_transaction_t *transaction)
 {
-    byte = (byte & 0xF0) >> 4 | (byte & 0x0F) << 4;
-    byte = (byte & 0xCC) >> 2 | (byte & 0x33) << 2;
-    byte = (byte & 0xAA) >> 1 | (byte & 0x55) << 1;
-    return byte;
+    // Sleep rather than spin. Other interrupts, including BLE, carry on
+    while (!transaction->done)
+    {
+        __WFE();
+    }
 }
 
+// Sequences which hold CS down are only made of these, called one after the
+// other from thread context. Whichever one comes next is the hold's owner
+
 void monocle_spi_read(spi_device_t spi_device, uint8_t *data, size_t length,
                       bool hold_down_cs)
 {
-    uint8_t cs_pin;
+    spi_transaction_t transaction = {
+        .device = spi_device,
+        .rx_buffer = data,
+        .rx_length = length,
+        .hold_down_cs = hold_down_cs,
+        .continues_hold = true,
+    };
+
+    monocle_spi_queue(&transaction);
+    monocle_spi_wait(&transaction);
+}
+
+void monocle_spi_write(spi_device_t spi_device, const uint8_t *data,
+                       size_t length, bool hold_down_cs)
+{
+    spi_transaction_t transaction = {
+        .device = spi_device,
+        .tx_buffer = data,
+        .tx_length = length,
+        .hold_down_cs = hold_down_cs,
+        .continues_hold = true,
+    };
+
+    monocle_spi_queue(&transaction);
+    monocle_spi_wait(&transaction);
+}
 
-    switch (spi_device)
+void monocle_fpga_read(uint16_t address, uint8_t *buffer, size_t length)
+{
+    uint8_t address_bytes[2] = {(uint8_t)(address >> 8), (uint8_t)address};
+
+    spi_transaction_t transaction = {
+        .device = FPGA,
+        .tx_buffer = address_bytes,
+        .tx_length = sizeof(address_bytes),
+        .rx_buffer = buffer,
+        .rx_length = length,
+    };
+
+    monocle_spi_queue(&transaction);
+    monocle_spi_wait(&transaction);
+}
+
+/**
+ * Flash chips that are known to work, identified by their JEDEC ID. Anything
+ * else falls back to normal reads at 4MHz and 4K sector erases, which every
+ * SPI NOR flash supports.
+ */
+
+typedef struct flash_chip_t
+{
+    uint8_t jedec_id[3];
+    bool fast_read;
+    bool block_erase_32k;
+    bool block_erase_64k;
+} flash_chip_t;
+
+static const flash_chip_t flash_chips[] = {
+    {{0xC8, 0x40, 0x14}, true, true, true}, // GigaDevice GD25Q80C
+    {{0xC8, 0x60, 0x14}, true, true, true}, // GigaDevice GD25LQ80C
+    {{0xEF, 0x40, 0x14}, true, true, true}, // Winbond W25Q80DV
+    {{0xC2, 0x28, 0x14}, true, true, true}, // Macronix MX25R8035F
+};
+
+static const flash_chip_t flash_chip_unknown = {{0}, false, false, false};
+
+static const flash_chip_t *flash_chip = &flash_chip_unknown;
+
+/**
+ * Erases and page programs run in the background. Once a command is sent, a
+ * timer polls the status register through the SPI queue until the chip is
+ * done, and then starts the next queued erase. Everything else waits for the
+ * flash to go idle first.
+ */
+
+// Page programs take under a millisecond, and sector erases tens of them
+#define FLASH_PROGRAM_POLL_US 50
+#define FLASH_ERASE_POLL_US 1000
+
+static const nrfx_timer_t flash_timer = NRFX_TIMER_INSTANCE(3);
+
+static struct flash_jobs_t
+{
+    bool timer_initialised;
+    bool checked;
+    volatile bool busy;
+    bool polling;
+    struct
     {
-    case DISPLAY:
-        cs_pin = DISPLAY_CS_PIN;
-        break;
-    case FPGA:
-        cs_pin = FPGA_CS_MODE_PIN;
-        break;
-    case FLASH:
-        cs_pin = FLASH_CS_PIN;
-        break;
-    }
+        size_t address;
+        size_t length;
+    } erases[8];
+    size_t erase_head;
+    volatile size_t erase_count;
+    uint8_t write_enable_cmd[1];
+    uint8_t erase_cmd[4];
+    uint8_t status_cmd[1];
+    uint8_t status;
+    spi_transaction_t write_enable;
+    spi_transaction_t erase;
+    spi_transaction_t status_read;
+} flash_jobs = {
+    .write_enable_cmd = {0x06},
+    .status_cmd = {0x05},
+};
 
-    nrf_gpio_pin_clear(cs_pin);
+static bool flash_is_busy(void)
+{
+    uint8_t status_cmd[] = {0x05};
+    uint8_t status;
+
+    spi_transaction_t transaction = {
+        .device = FLASH,
+        .tx_buffer = status_cmd,
+        .tx_length = sizeof(status_cmd),
+        .rx_buffer = &status,
+        .rx_length = sizeof(status),
+    };
 
-    // TODO prevent blocking here
-    nrfx_spim_xfer_desc_t xfer = NRFX_SPIM_XFER_RX(data, length);
-    app_err(nrfx_spim_xfer(&spi_bus_2, &xfer, 0));
+    monocle_spi_queue(&transaction);
+    monocle_spi_wait(&transaction);
 
-    if (!hold_down_cs)
+    return status & 0x01;
+}
+
+static void flash_start_erase(void)
+{
+    // Erase as much of the first range as possible in one go
+    size_t address = flash_jobs.erases[flash_jobs.erase_head].address;
+    size_t length = flash_jobs.erases[flash_jobs.erase_head].length;
+    uint8_t opcode = 0x20;
+    size_t size = 0x1000;
+
+    if (flash_chip->block_erase_64k &&
+        address % 0x10000 == 0 && length >= 0x10000)
     {
-        nrf_gpio_pin_set(cs_pin);
+        opcode = 0xD8;
+        size = 0x10000;
     }
+    else if (flash_chip->block_erase_32k &&
+             address % 0x8000 == 0 && length >= 0x8000)
+    {
+        opcode = 0x52;
+        size = 0x8000;
+    }
+
+    flash_jobs.erases[flash_jobs.erase_head].address += size;
+    flash_jobs.erases[flash_jobs.erase_head].length -= size;
 
-    // Flash is LSB first, so we need to flip all the bytes before returning
-    if (spi_device == FLASH)
+    if (flash_jobs.erases[flash_jobs.erase_head].length == 0)
     {
-        for (size_t i = 0; i < length; i++)
-        {
-            data[i] = bit_reverse(data[i]);
-        }
+        flash_jobs.erase_head = (flash_jobs.erase_head + 1) %
+                                MP_ARRAY_SIZE(flash_jobs.erases);
+        flash_jobs.erase_count--;
     }
+
+    flash_jobs.erase_cmd[0] = opcode;
+    flash_jobs.erase_cmd[1] = address >> 16;
+    flash_jobs.erase_cmd[2] = address >> 8;
+    flash_jobs.erase_cmd[3] = address;
+
+    flash_jobs.write_enable = (spi_transaction_t){
+        .device = FLASH,
+        .tx_buffer = flash_jobs.write_enable_cmd,
+        .tx_length = sizeof(flash_jobs.write_enable_cmd),
+    };
+
+    flash_jobs.erase = (spi_transaction_t){
+        .device = FLASH,
+        .tx_buffer = flash_jobs.erase_cmd,
+        .tx_length = sizeof(flash_jobs.erase_cmd),
+    };
+
+    monocle_spi_queue(&flash_jobs.write_enable);
+    monocle_spi_queue(&flash_jobs.erase);
+}
+
+static void flash_poll(uint32_t interval_us)
+{
+    nrfx_timer_extended_compare(&flash_timer, NRF_TIMER_CC_CHANNEL0,
+                                interval_us,
+                                NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK, true);
+
+    nrfx_timer_enable(&flash_timer);
 }
 
-void monocle_spi_write(spi_device_t spi_device, uint8_t *data, size_t length,
-                       bool hold_down_cs)
+static void flash_status_read(spi_transaction_t *transaction)
 {
-    uint8_t cs_pin;
+    (void)transaction;
+
+    flash_jobs.polling = false;
 
-    switch (spi_device)
+    if (flash_jobs.status & 0x01)
     {
-    case DISPLAY:
-        cs_pin = DISPLAY_CS_PIN;
-        break;
-    case FPGA:
-        cs_pin = FPGA_CS_MODE_PIN;
-        break;
-    case FLASH:
-        cs_pin = FLASH_CS_PIN;
-        break;
+        return;
     }
 
-    nrf_gpio_pin_clear(cs_pin);
+    nrfx_timer_disable(&flash_timer);
 
-    // Flash is LSB first, so we need to flip all the bytes before sending
-    if (spi_device == FLASH)
+    // Move on to the next erase, or go idle if there's nothing left
+    if (flash_jobs.erase_count > 0)
     {
-        for (size_t i = 0; i < length; i++)
-        {
-            data[i] = bit_reverse(data[i]);
-        }
+        flash_start_erase();
+        flash_poll(FLASH_ERASE_POLL_US);
+        return;
     }
 
-    // TODO prevent blocking here
-    if (!nrfx_is_in_ram(data))
+    flash_jobs.busy = false;
+}
+
+static void flash_timer_handler(nrf_timer_event_t event_type, void *p_context)
+{
+    (void)event_type;
+    (void)p_context;
+
+    if (flash_jobs.polling)
     {
-        uint8_t *m_data = m_malloc(length);
-        memcpy(m_data, data, length);
-        nrfx_spim_xfer_desc_t xfer = NRFX_SPIM_XFER_TX(m_data, length);
-        app_err(nrfx_spim_xfer(&spi_bus_2, &xfer, 0));
-        m_free(m_data);
+        return;
     }
-    else
+
+    flash_jobs.polling = true;
+
+    flash_jobs.status_read = (spi_transaction_t){
+        .device = FLASH,
+        .tx_buffer = flash_jobs.status_cmd,
+        .tx_length = sizeof(flash_jobs.status_cmd),
+        .rx_buffer = &flash_jobs.status,
+        .rx_length = sizeof(flash_jobs.status),
+        .callback = flash_status_read,
+    };
+
+    monocle_spi_queue(&flash_jobs.status_read);
+}
+
+static void flash_init_jobs(void)
+{
+    if (flash_jobs.timer_initialised)
     {
-        nrfx_spim_xfer_desc_t xfer = NRFX_SPIM_XFER_TX(data, length);
-        app_err(nrfx_spim_xfer(&spi_bus_2, &xfer, 0));
+        return;
     }
 
-    if (!hold_down_cs)
+    nrfx_timer_config_t timer_config = NRFX_TIMER_DEFAULT_CONFIG;
+    timer_config.frequency = NRF_TIMER_FREQ_1MHz;
+    timer_config.bit_width = NRF_TIMER_BIT_WIDTH_16;
+    app_err(nrfx_timer_init(&flash_timer, &timer_config, flash_timer_handler));
+
+    flash_jobs.timer_initialised = true;
+}
+
+static void flash_detect(void)
+{
+    uint8_t jedec_id_cmd[] = {0x9F};
+    uint8_t jedec_id[3];
+
+    spi_transaction_t transaction = {
+        .device = FLASH,
+        .tx_buffer = jedec_id_cmd,
+        .tx_length = sizeof(jedec_id_cmd),
+        .rx_buffer = jedec_id,
+        .rx_length = sizeof(jedec_id),
+    };
+
+    monocle_spi_queue(&transaction);
+    monocle_spi_wait(&transaction);
+
+    flash_chip = &flash_chip_unknown;
+
+    for (size_t i = 0; i < MP_ARRAY_SIZE(flash_chips); i++)
     {
-        nrf_gpio_pin_set(cs_pin);
+        if (memcmp(flash_chips[i].jedec_id, jedec_id, sizeof(jedec_id)) == 0)
+        {
+            flash_chip = &flash_chips[i];
+            break;
+        }
     }
+
+    // Fast read is specified well beyond the 8MHz that SPIM2 can manage
+    spi_frequencies[FLASH] = flash_chip->fast_read ? NRF_SPIM_FREQ_8M
+                                                   : NRF_SPIM_FREQ_4M;
 }
 
-static bool flash_is_busy(void)
+void monocle_flash_sync(void)
 {
-    uint8_t status_cmd[] = {0x05};
-    monocle_spi_write(FLASH, status_cmd, sizeof(status_cmd), true);
-    monocle_spi_read(FLASH, status_cmd, sizeof(status_cmd), false);
+    // Whatever was going on before the first operation has to be polled for
+    if (!flash_jobs.checked)
+    {
+        while (flash_is_busy())
+        {
+            MICROPY_EVENT_POLL_HOOK;
+        }
+
+        flash_detect();
+        flash_jobs.checked = true;
+    }
 
-    if ((status_cmd[0] & 0x01) == 0)
+    while (flash_jobs.busy)
     {
-        return false;
+        MICROPY_EVENT_POLL_HOOK;
     }
+}
 
-    return true;
+bool monocle_flash_busy(void)
+{
+    // Until the first sync, whatever was going on before is unknown
+    return !flash_jobs.checked || flash_jobs.busy;
 }
 
 void monocle_flash_read(uint8_t *buffer, size_t address, size_t length)
@@ -349,33 +909,29 @@ void monocle_flash_read(uint8_t *buffer, size_t address, size_t length)
             MP_ERROR_TEXT("address + length cannot exceed 1048576 bytes"));
     }
 
-    while (flash_is_busy())
-    {
-        MICROPY_EVENT_POLL_HOOK;
-    }
+    monocle_flash_sync();
 
-    uint8_t read_cmd[] = {0x03,
+    // Fast read takes a dummy byte after the address
+    uint8_t read_cmd[] = {flash_chip->fast_read ? 0x0B : 0x03,
                           address >> 16,
                           address >> 8,
-                          address};
-    monocle_spi_write(FLASH, read_cmd, sizeof(read_cmd), true);
-
-    size_t bytes_read = 0;
-    while (bytes_read < length)
-    {
-        // nRF DMA can only handle 255 bytes at a time
-        size_t max_readable_length = MIN(length - bytes_read, 255);
-
-        // If we're going to need another transfer, keep cs held
-        bool hold = length - bytes_read > 255;
-
-        monocle_spi_read(FLASH, buffer + bytes_read, max_readable_length, hold);
+                          address,
+                          0x00};
+
+    // One transaction, chained over as many DMA transfers as needed
+    spi_transaction_t transaction = {
+        .device = FLASH,
+        .tx_buffer = read_cmd,
+        .tx_length = flash_chip->fast_read ? 5 : 4,
+        .rx_buffer = buffer,
+        .rx_length = length,
+    };
 
-        bytes_read += max_readable_length;
-    }
+    monocle_spi_queue(&transaction);
+    monocle_spi_wait(&transaction);
 }
 
-void monocle_flash_write(uint8_t *buffer, size_t address, size_t length)
+void monocle_flash_write(const uint8_t *buffer, size_t address, size_t length)
 {
     if (address + length > 0x100000)
     {
@@ -394,32 +950,108 @@ void monocle_flash_write(uint8_t *buffer, size_t address, size_t length)
         size_t max_writable_length = MIN(bytes_left_in_page,
                                          bytes_left_to_write);
 
-        // nRF DMA can only handle 255 bytes at a time
-        max_writable_length = MIN(max_writable_length, 255);
-
-        while (flash_is_busy())
-        {
-            MICROPY_EVENT_POLL_HOOK;
-        }
+        monocle_flash_sync();
 
         uint8_t write_enable_cmd[] = {0x06};
         monocle_spi_write(FLASH, write_enable_cmd, sizeof(write_enable_cmd), false);
 
+        // Whole pages go straight from the caller's buffer. The SPI driver
+        // bit reverses, and stages constants, one DMA chunk at a time
         uint8_t page_program_cmd[] = {0x02,
                                       address_offset >> 16,
                                       address_offset >> 8,
                                       address_offset};
-        uint8_t *m_buffer = m_malloc(length);
-        memcpy(m_buffer, buffer, length);
-        app_err(m_buffer == NULL);
         monocle_spi_write(FLASH, page_program_cmd, sizeof(page_program_cmd), true);
-        monocle_spi_write(FLASH, m_buffer + bytes_written, max_writable_length, false);
-        m_free(m_buffer);
+        monocle_spi_write(FLASH, buffer + bytes_written, max_writable_length, false);
+
+        // The last page finishes programming in the background
+        flash_init_jobs();
+        flash_jobs.busy = true;
+        flash_poll(FLASH_PROGRAM_POLL_US);
 
         bytes_written += max_writable_length;
     }
 }
 
+void monocle_flash_erase(size_t address, size_t length)
+{
+    if (address % 0x1000 || length % 0x1000)
+    {
+        mp_raise_ValueError(MP_ERROR_TEXT(
+            "address and length must be aligned to 4096 bytes"));
+    }
+
+    if (address + length > 0x100000)
+    {
+        mp_raise_ValueError(
+            MP_ERROR_TEXT("address + length cannot exceed 1048576 bytes"));
+    }
+
+    if (length == 0)
+    {
+        return;
+    }
+
+    flash_init_jobs();
+
+    if (!flash_jobs.checked)
+    {
+        monocle_flash_sync();
+    }
+
+    bool start = false;
+
+    while (true)
+    {
+        bool queued = false;
+        size_t size = MP_ARRAY_SIZE(flash_jobs.erases);
+
+        NRFX_CRITICAL_SECTION_ENTER();
+        size_t tail = (flash_jobs.erase_head + flash_jobs.erase_count +
+                       size - 1) %
+                      size;
+
+        // Ranges that carry on from the last one are merged, so that
+        // consecutive sector erases can become block erases
+        if (flash_jobs.erase_count > 0 &&
+            flash_jobs.erases[tail].address +
+                    flash_jobs.erases[tail].length ==
+                address)
+        {
+            flash_jobs.erases[tail].length += length;
+            queued = true;
+        }
+        else if (flash_jobs.erase_count < size)
+        {
+            tail = (tail + 1) % size;
+            flash_jobs.erases[tail].address = address;
+            flash_jobs.erases[tail].length = length;
+            flash_jobs.erase_count++;
+            queued = true;
+        }
+
+        if (queued && !flash_jobs.busy)
+        {
+            flash_jobs.busy = true;
+            start = true;
+        }
+        NRFX_CRITICAL_SECTION_EXIT();
+
+        if (queued)
+        {
+            break;
+        }
+
+        MICROPY_EVENT_POLL_HOOK;
+    }
+
+    if (start)
+    {
+        flash_start_erase();
+        flash_poll(FLASH_ERASE_POLL_US);
+    }
+}
+
 void monocle_flash_page_erase(size_t address)
 {
     if (address % 0x1000)
@@ -428,17 +1060,73 @@ void monocle_flash_page_erase(size_t address)
             "address must be aligned to a page size of 4096 bytes"));
     }
 
-    while (flash_is_busy())
+    monocle_flash_erase(address, 0x1000);
+}
+
+static const nrfx_timer_t boot_timer = NRFX_TIMER_INSTANCE(1);
+
+static struct boot_trace_t
+{
+    bool started;
+    bool finished;
+    size_t count;
+    monocle_boot_stage_t stages[MONOCLE_BOOT_TRACE_LENGTH];
+} boot_trace;
+
+static void boot_timer_handler(nrf_timer_event_t event_type, void *p_context)
+{
+    // Free running, without any compare events
+    (void)event_type;
+    (void)p_context;
+}
+
+void monocle_boot_trace(const char *stage)
+{
+    if (boot_trace.finished)
     {
-        MICROPY_EVENT_POLL_HOOK;
+        return;
+    }
+
+    // The first stage starts the clock
+    if (!boot_trace.started)
+    {
+        nrfx_timer_config_t timer_config = NRFX_TIMER_DEFAULT_CONFIG;
+        timer_config.frequency = NRF_TIMER_FREQ_1MHz;
+        timer_config.bit_width = NRF_TIMER_BIT_WIDTH_32;
+        app_err(nrfx_timer_init(&boot_timer, &timer_config, boot_timer_handler));
+        nrfx_timer_enable(&boot_timer);
+
+        boot_trace.started = true;
     }
 
-    uint8_t write_enable_cmd[] = {0x06};
-    monocle_spi_write(FLASH, write_enable_cmd, sizeof(write_enable_cmd), false);
+    if (boot_trace.count == MONOCLE_BOOT_TRACE_LENGTH)
+    {
+        return;
+    }
 
-    uint8_t sector_erase[] = {0x20,
-                              address >> 16,
-                              address >> 8,
-                              address};
-    monocle_spi_write(FLASH, sector_erase, sizeof(sector_erase), false);
+    uint32_t us = nrfx_timer_capture(&boot_timer, NRF_TIMER_CC_CHANNEL1);
+
+    boot_trace.stages[boot_trace.count++] = (monocle_boot_stage_t){
+        .name = stage,
+        .us = us,
+    };
+}
+
+void monocle_boot_trace_finish(const char *stage)
+{
+    monocle_boot_trace(stage);
+
+    // A running timer holds the high frequency clock on, so it's released
+    if (boot_trace.started && !boot_trace.finished)
+    {
+        nrfx_timer_disable(&boot_timer);
+        nrfx_timer_uninit(&boot_timer);
+        boot_trace.finished = true;
+    }
+}
+
+size_t monocle_boot_stages(const monocle_boot_stage_t **stages)
+{
+    *stages = boot_trace.stages;
+    return boot_trace.count;
 }
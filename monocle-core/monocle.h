@@ -134,8 +134,45 @@ i2c_response_t monocle_i2c_write(uint8_t device_address_7bit,
                                  uint8_t register_mask,
                                  uint8_t set_value);
 
+// Bounded by the 8-bit EasyDMA length, less the register address
+#define I2C_MAX_BURST_LENGTH 253
+
+/**
+ * @brief Burst accesses cover consecutive registers in a single transfer,
+ *        relying on the device to increment its register pointer.
+ */
+
+i2c_response_t monocle_i2c_read_burst(uint8_t device_address_7bit,
+                                      uint16_t register_address,
+                                      uint8_t *values,
+                                      size_t length);
+
+i2c_response_t monocle_i2c_write_burst(uint8_t device_address_7bit,
+                                       uint16_t register_address,
+                                       const uint8_t *values,
+                                       size_t length);
+
 /**
- * @brief Low level SPI driver for accessing FPGA, display and flash.
+ * @brief Writes a table of registers, grouping runs of consecutive addresses
+ *        into burst writes. A run is only read back first if one of its
+ *        entries has a mask other than 0xFF.
+ */
+
+typedef struct i2c_register_t
+{
+    uint16_t address;
+    uint8_t mask;
+    uint8_t value;
+} i2c_register_t;
+
+i2c_response_t monocle_i2c_write_table(uint8_t device_address_7bit,
+                                       const i2c_register_t *table,
+                                       size_t count);
+
+/**
+ * @brief Low level SPI driver for accessing FPGA, display and flash. Reads and
+ *        writes sleep until the SPIM interrupt completes them, so they can't
+ *        be used from other interrupts.
  */
 
 typedef enum spi_device_t
@@ -150,19 +187,102 @@ void monocle_spi_enable(bool enable);
 void monocle_spi_read(spi_device_t spi_device, uint8_t *data, size_t length,
                       bool hold_down_cs);
 
-void monocle_spi_write(spi_device_t spi_device, uint8_t *data, size_t length,
-                       bool hold_down_cs);
+void monocle_spi_write(spi_device_t spi_device, const uint8_t *data,
+                       size_t length, bool hold_down_cs);
+
+/**
+ * @brief Queued SPI transactions. Each one selects its device, clocks out
+ *        tx_buffer followed by rx_length bytes into rx_buffer using EasyDMA,
+ *        and then calls back from the SPIM interrupt. Lengths aren't limited
+ *        to the 255 byte DMA maximum. The buffers must stay valid until done
+ *        is set, but tx_buffer is never modified and may be a constant. A
+ *        transaction holding CS down keeps the bus, and only one marked as
+ *        continuing the hold, for the same device, may go until CS is
+ *        released. Everything else waits, whichever device it's for.
+ */
+
+typedef struct spi_transaction_t
+{
+    spi_device_t device;
+    const uint8_t *tx_buffer;
+    size_t tx_length;
+    uint8_t *rx_buffer;
+    size_t rx_length;
+    bool hold_down_cs;
+    bool continues_hold;
+    void (*callback)(struct spi_transaction_t *transaction);
+    void *context;
+    volatile bool done;
+
+    // Used by the driver while the transaction is queued
+    size_t position;
+    struct spi_transaction_t *next;
+} spi_transaction_t;
+
+void monocle_spi_queue(spi_transaction_t *transaction);
+
+void monocle_spi_wait(spi_transaction_t *transaction);
+
+/**
+ * @brief Reverses the bit order of each byte. Flash is LSB first on the bus.
+ */
+
+void monocle_bit_reverse(uint8_t *destination, const uint8_t *source,
+                         size_t length);
+
+/**
+ * @brief CRC-16/CCITT, continued from crc. Start from 0xFFFF.
+ */
+
+uint16_t monocle_crc16(uint16_t crc, const uint8_t *bytes, size_t length);
 
 /**
- * @brief High level SPI driver for accessing flash.
+ * @brief High level SPI driver for reading FPGA registers. Any length is read
+ *        under a single chip select.
+ */
+
+void monocle_fpga_read(uint16_t address, uint8_t *buffer, size_t length);
+
+/**
+ * @brief High level SPI driver for accessing flash. Erases are queued, and
+ *        erases and page programs complete in the background. Reads and
+ *        writes wait for them, as does sync, and busy tells if they would.
+ *        The chip is identified by its JEDEC ID to use fast reads and 32K or
+ *        64K block erases.
  */
 
 void monocle_flash_read(uint8_t *buffer, size_t address, size_t length);
 
-void monocle_flash_write(uint8_t *buffer, size_t address, size_t length);
+void monocle_flash_write(const uint8_t *buffer, size_t address,
+                         size_t length);
+
+void monocle_flash_erase(size_t address, size_t length);
 
 void monocle_flash_page_erase(size_t address);
 
+void monocle_flash_sync(void);
+
+bool monocle_flash_busy(void);
+
+/**
+ * @brief Boot timing trace. Each stage is stamped with the microseconds since
+ *        the first one, which starts the clock. The final stage stops it.
+ */
+
+#define MONOCLE_BOOT_TRACE_LENGTH 16
+
+typedef struct monocle_boot_stage_t
+{
+    const char *name;
+    uint32_t us;
+} monocle_boot_stage_t;
+
+void monocle_boot_trace(const char *stage);
+
+void monocle_boot_trace_finish(const char *stage);
+
+size_t monocle_boot_stages(const monocle_boot_stage_t **stages);
+
 /**
  * @brief Error handling macro.
  */
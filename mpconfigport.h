@@ -130,3 +130,37 @@
 
 void mp_event_poll_hook(void);
 #define MICROPY_EVENT_POLL_HOOK mp_event_poll_hook();
+
+// Size of the ring receiving REPL input over Bluetooth, at most 65535 bytes.
+// Hosts are granted credit for this much input at a time
+#define MICROPY_HW_BLE_REPL_RX_BUFFER_SIZE (2048)
+
+// Rings for the data service, at most 65535 bytes. Every static buffer comes
+// out of the MicroPython heap, so these hold just four notifications of the
+// largest MTU: 509 byte payloads, each behind a two byte length on the tx
+// side, plus the byte kept free to tell full from empty
+#define MICROPY_HW_BLE_DATA_TX_BUFFER_SIZE (4 * (512 - 3 + 2) + 1)
+#define MICROPY_HW_BLE_DATA_RX_BUFFER_SIZE (4 * (512 - 3 + 2) + 1)
+
+// Read cache for device.Storage, kept outside the GC heap. Lines of 256 bytes
+// match flash pages, and 4096 byte lines match littlefs blocks. littlefs
+// fills its own cache 1K at a time, so this holds four of those
+#define MICROPY_HW_STORAGE_CACHE_LINE_SIZE (256)
+#define MICROPY_HW_STORAGE_CACHE_SIZE (4096)
+
+// External flash for device.LogStore, a ring of sectors outside the
+// filesystem. device.Storage ends here. Records are staged in RAM a page at a
+// time, enough to ride out the sector erases kept ahead of the writes
+#define MICROPY_HW_FLASH_LOG_START (0xE0000)
+#define MICROPY_HW_FLASH_LOG_SIZE (0x10000)
+#define MICROPY_HW_FLASH_LOG_BUFFER_SIZE (1024)
+
+// External flash kept for read-only blobs such as images and tables, found by
+// name in an index occupying the first sector
+#define MICROPY_HW_FLASH_BLOB_START (0xF0000)
+#define MICROPY_HW_FLASH_BLOB_SIZE (0x10000)
+
+// The camera is brought up when first imported. With prefetch, it's brought up
+// as soon as the REPL is idle after boot instead, which costs power on every
+// boot and holds off the first REPL input for the length of the bring up
+#define MICROPY_HW_CAMERA_PREFETCH (0)
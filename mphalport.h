@@ -43,14 +43,38 @@ int mp_hal_generate_random_seed(void);
 
 touch_button_t touch_get_state(void);
 
+bool camera_power_up(void);
+
 typedef enum ble_tx_channel_t
 {
     REPL_TX,
     DATA_TX,
+    REPL_RX_CREDIT,
 } ble_tx_channel_t;
 
 bool ble_are_tx_notifications_enabled(ble_tx_channel_t channel);
 
 size_t ble_get_max_payload_size(void);
 
-bool ble_send_raw_data(const uint8_t *bytes, size_t len);
\ No newline at end of file
+uint16_t ble_get_configured_mtu(void);
+
+uint16_t ble_get_preferred_mtu(void);
+
+bool ble_set_preferred_mtu(uint16_t mtu);
+
+bool ble_send_raw_data(const uint8_t *bytes, size_t len);
+
+bool ble_send_raw_data_now(const uint8_t *bytes, size_t len);
+
+typedef enum ble_link_mode_t
+{
+    BLE_LINK_AUTO,
+    BLE_LINK_FAST,
+    BLE_LINK_RELAXED,
+} ble_link_mode_t;
+
+ble_link_mode_t ble_get_link_mode(void);
+
+void ble_set_link_mode(ble_link_mode_t mode);
+
+void ble_tune_link(void);
\ No newline at end of file
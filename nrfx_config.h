@@ -54,6 +54,8 @@
 
 #define NRFX_TIMER_ENABLED 1
 #define NRFX_TIMER0_ENABLED 1 // Used by the SoftDevice
+#define NRFX_TIMER1_ENABLED 1 // Used for the boot timing trace
+#define NRFX_TIMER3_ENABLED 1 // Used for polling flash status
 #define NRFX_TIMER4_ENABLED 1 // Used for checking battery state
 #define NRFX_TIMER_DEFAULT_CONFIG_IRQ_PRIORITY 7
 
@@ -25,6 +25,7 @@ from bleak.uuids import register_uuids
 UART_SERVICE_UUID = "6e400001-b5a3-f393-e0a9-e50e24dcca9e"
 UART_TX_CHAR_UUID = "6e400002-b5a3-f393-e0a9-e50e24dcca9e"
 UART_RX_CHAR_UUID = "6e400003-b5a3-f393-e0a9-e50e24dcca9e"
+UART_CREDIT_CHAR_UUID = "6e400004-b5a3-f393-e0a9-e50e24dcca9e"
 
 DATA_SERVICE_UUID = "e5700001-7bac-429a-b4ce-57ff900f479d"
 DATA_TX_CHAR_UUID = "e5700002-7bac-429a-b4ce-57ff900f479d"
@@ -74,6 +75,29 @@ async def repl_terminal():
         sys.stderr.write(f'RX: {hex} {data}\r\n')
         sys.stderr.flush()
 
+    # Bytes the Monocle can take since the connection started. Older firmware
+    # has no credit, and takes what fits in a write
+    credit = None
+    sent = 0
+
+    def handle_repl_credit(_: BleakGATTCharacteristic, data: bytearray):
+        nonlocal credit
+        credit = int.from_bytes(data, "little")
+
+    async def write_repl(client, char, data):
+        nonlocal sent
+        while data:
+            n = len(data)
+            if credit is not None:
+                left = (credit - sent) & 0xFFFFFFFF
+                n = min(n, left if left < 0x80000000 else 0)
+                if n == 0:
+                    await asyncio.sleep(0.01)
+                    continue
+            await client.write_gatt_char(char, data[:n])
+            sent += n
+            data = data[n:]
+
     def prompt():
         global saved_term
         if sys.stdin.isatty():
@@ -106,6 +130,11 @@ async def repl_terminal():
         repl_tx_char = repl.get_characteristic(UART_TX_CHAR_UUID)
         data_tx_char = data.get_characteristic(DATA_TX_CHAR_UUID)
 
+        # Nothing is written until the first credit, sent on subscribing
+        if repl.get_characteristic(UART_CREDIT_CHAR_UUID):
+            credit = 0
+            await client.start_notify(UART_CREDIT_CHAR_UUID, handle_repl_credit)
+
         # set the terminal to raw I/O: no buffering
         if sys.stdin.isatty():
             tty.setraw(0)
@@ -121,7 +150,7 @@ async def repl_terminal():
                 line = await loop.run_in_executor(None, prompt)
                 await client.write_gatt_char(data_tx_char, line.rstrip())
             else:
-                await client.write_gatt_char(repl_tx_char, ch)
+                await write_repl(client, repl_tx_char, ch)
 
 
 if __name__ == "__main__":
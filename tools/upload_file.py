@@ -1,11 +1,20 @@
 #!/usr/bin/env python3
 """
 An example showing how to connect to the Monocle and store a file.
+
+    upload_file.py FILE...              type the files through the REPL
+    upload_file.py --fast FILE...       upload with bluetooth.file_server()
+    upload_file.py --download FILE...   download with bluetooth.file_server()
+    upload_file.py --migrate DIR        move a filesystem made by older firmware
+                                        to the current layout, keeping a copy
+                                        of every file in DIR
 """
 
 import asyncio
+import struct
 import sys
 import os
+import zlib
 
 from bleak import BleakClient, BleakScanner
 from bleak.backends.characteristic import BleakGATTCharacteristic
@@ -18,6 +27,7 @@ class MonocleScript:
     UART_SERVICE_UUID = "6e400001-b5a3-f393-e0a9-e50e24dcca9e"
     UART_RX_CHAR_UUID = "6e400002-b5a3-f393-e0a9-e50e24dcca9e"
     UART_TX_CHAR_UUID = "6e400003-b5a3-f393-e0a9-e50e24dcca9e"
+    UART_CREDIT_CHAR_UUID = "6e400004-b5a3-f393-e0a9-e50e24dcca9e"
 
     DATA_SERVICE_UUID = "e5700001-7bac-429a-b4ce-57ff900f479d"
     DATA_RX_CHAR_UUID = "e5700002-7bac-429a-b4ce-57ff900f479d"
@@ -29,6 +39,7 @@ class MonocleScript:
             self.DATA_TX_CHAR_UUID: "Monocle Data RX",
             self.DATA_RX_CHAR_UUID: "Monocle Data TX",
         })
+        self.compression = None
 
 
     @classmethod
@@ -46,7 +57,7 @@ class MonocleScript:
             await self.init_data_service()
             await self.set_monocle_raw_mode()
             await self.script(*args)
-            await self.client.write_gatt_char(self.uart_rx_char, b"\x02")
+            await self.write_uart(b"\x02")
 
     def log(self, msg):
         if "DEBUG" in os.environ:
@@ -69,6 +80,24 @@ class MonocleScript:
         # Here, handle data sent by the Monocle with `bluetooth.send()`
         self.data_rx_buf.extend(data)
 
+    def handle_uart_credit(self, _:BleakGATTCharacteristic, data:bytearray):
+        # Bytes the Monocle can take since the connection started
+        self.uart_credit = int.from_bytes(data, "little")
+
+    async def write_uart(self, data):
+        # Older firmware has no credit, and needs writes to be kept small
+        while data:
+            n = min(len(data), self.client.mtu_size - 3)
+            if self.uart_credit is not None:
+                left = (self.uart_credit - self.uart_sent) & 0xFFFFFFFF
+                n = min(n, left if left < 0x80000000 else 0)
+                if n == 0:
+                    await asyncio.sleep(0.01)
+                    continue
+            await self.client.write_gatt_char(self.uart_rx_char, data[:n])
+            self.uart_sent += n
+            data = data[n:]
+
     async def getchar_uart(self):
         while len(self.uart_rx_buf) == 0:
             await asyncio.sleep(0.01)
@@ -96,18 +125,79 @@ class MonocleScript:
         return buf
 
     async def send_command(self, cmd):
-        await self.client.write_gatt_char(self.uart_rx_char, cmd.encode("ascii") + b"\x04")
+        await self.write_uart(cmd.encode("ascii") + b"\x04")
         while True:
             resp = await self.getline_uart(delim=b"\r\n\x04")
             if resp != b"" and resp != b">":
                 break
         assert resp == b">OK"
 
+    async def send_compressed(self, cmd):
+        if self.compression is False:
+            return await self.send_command(cmd)
+
+        # Ask for a compressed upload, older firmware replies "R\x00"
+        await self.write_uart(b"\x05Z\x01")
+        while (c := await self.getchar_uart()) not in b"RZ":
+            pass
+        if await self.getchar_uart() != 0x01:
+            self.compression = False
+            return await self.send_command(cmd)
+        self.compression = True
+        window = await self.getchar_uart() | await self.getchar_uart() << 8
+
+        # The firmware keeps no more of the output than the window, so it's
+        # kept small. The bytes which the REPL service intercepts are escaped
+        source = cmd.encode()
+        compressor = zlib.compressobj(9, zlib.DEFLATED, 10)
+        compressed = compressor.compress(source) + compressor.flush()
+        wire = bytearray(struct.pack("<II", len(compressed), len(source)))
+        for byte in compressed:
+            if byte in (0x03, 0x10, 0x1C):
+                wire += bytes([0x10, byte ^ 0x40])
+            else:
+                wire.append(byte)
+
+        # Same flow control as raw paste mode, one window at a time
+        credit = window
+        chunk = self.client.mtu_size - 3
+        while wire:
+            while credit == 0:
+                c = await self.getchar_uart()
+                if c == 0x01:
+                    credit += window
+                elif c == 0x15:
+                    # Rejected before the end, so the rest is cancelled
+                    await self.write_uart(b"\x03")
+                    reason = await self.getline_uart(delim=b"\x04")
+                    raise RuntimeError(f"the upload was rejected: {reason}")
+            n = min(chunk, credit, len(wire))
+            await self.write_uart(wire[:n])
+            del wire[:n]
+            credit -= n
+
+        await self.write_uart(b"\x04")
+        while (c := await self.getchar_uart()) == 0x01:
+            pass
+        if c == 0x15:
+            reason = await self.getline_uart(delim=b"\x04")
+            raise RuntimeError(f"the upload was rejected: {reason}")
+        assert c == 0x04, "the upload could not be inflated"
+        while (resp := await self.getline_uart(delim=b"\r\n\x04")) in (b"", b">"):
+            pass
+        assert resp == b"OK"
+
     async def init_uart_service(self):
         await self.client.start_notify(self.UART_TX_CHAR_UUID, self.handle_uart_rx)
         uart_service = self.client.services.get_service(self.UART_SERVICE_UUID)
         self.uart_rx_char = uart_service.get_characteristic(self.UART_RX_CHAR_UUID)
         self.uart_rx_buf = bytearray()
+        self.uart_credit = None
+        self.uart_sent = 0
+        if uart_service.get_characteristic(self.UART_CREDIT_CHAR_UUID):
+            # Nothing is written until the first credit, sent on subscribing
+            self.uart_credit = 0
+            await self.client.start_notify(self.UART_CREDIT_CHAR_UUID, self.handle_uart_credit)
 
     async def init_data_service(self):
         await self.client.start_notify(self.DATA_TX_CHAR_UUID, self.handle_data_rx)
@@ -116,7 +206,7 @@ class MonocleScript:
         self.data_rx_last = None
 
     async def set_monocle_raw_mode(self):
-        await self.client.write_gatt_char(self.uart_rx_char, b"\x01 \x04")
+        await self.write_uart(b"\x01 \x04")
         while await self.getline_uart(delim=b"\r\n\x04") != b">OK":
             pass
 
@@ -127,15 +217,235 @@ class UploadFileScript(MonocleScript):
     """
     async def script(self, file):
         print(f"uploading {file} ", end="")
-        await self.send_command(f"f = open('{file}', 'wb')")
+        await self.send_compressed(f"f = open('{file}', 'wb')")
+
+        # Without compression or credit, writes have to stay small
+        size = 4096 if self.compression or self.uart_credit is not None else 100
         with open(file, "rb") as f:
-            while data := f.read(100):
+            while data := f.read(size):
                 print(end=".", flush=True)
-                await self.send_command(f"f.write({bytes(data).__repr__()})")
+                command = f"f.write({bytes(data).__repr__()})"
+                if self.compression:
+                    await self.send_compressed(command)
+                else:
+                    await self.send_command(command)
         await self.send_command("f.close()")
         print(" done")
 
+class FileTransferScript(MonocleScript):
+    """
+    Example application: upload or download files using the framed protocol
+    of `bluetooth.file_server()` on the data service. Frames are:
+
+        type (1) | sequence (2) | length (2) | payload | CRC32 (4)
+    """
+    OPEN_WRITE = 0x01
+    OPEN_READ = 0x02
+    DATA = 0x03
+    END = 0x04
+    EXIT = 0x05
+    ACK = 0x10
+    NAK = 0x11
+    ERROR = 0x12
+
+    # MICROPY_HW_BLE_DATA_RX_BUFFER_SIZE on the device, which keeps one byte
+    # free and drops writes that don't fit whole. The window stays within it,
+    # leaving room for a two byte length per frame
+    DEVICE_RX_BUFFER_SIZE = 4 * (512 - 3 + 2) + 1
+    IN_FLIGHT_BYTES = DEVICE_RX_BUFFER_SIZE - 1 - 4 * 2
+
+    def frame(self, type, payload=b""):
+        head = struct.pack("<BHH", type, self.sequence & 0xFFFF, len(payload))
+        self.sequence += 1
+        return head + payload + struct.pack("<I", zlib.crc32(head + payload))
+
+    async def get_frame(self):
+        while True:
+            buf = self.data_rx_buf
+            if len(buf) >= 5:
+                type, sequence, length = struct.unpack_from("<BHH", buf)
+                if len(buf) >= 5 + length + 4:
+                    frame = bytes(buf[:5 + length + 4])
+                    del buf[:5 + length + 4]
+                    crc, = struct.unpack_from("<I", frame, 5 + length)
+                    if crc != zlib.crc32(frame[:5 + length]):
+                        raise IOError("corrupted frame from the device")
+                    payload = frame[5:5 + length]
+                    if type == self.ERROR:
+                        raise IOError(payload.decode())
+                    return type, sequence, payload
+            await asyncio.sleep(0.01)
+
+    async def send_frames(self, frames):
+        # Go-back-N: keep a window of frames unacknowledged, and resend from
+        # the sequence number given by a NAK
+        first = self.sequence - len(frames)
+        window = max(1, self.IN_FLIGHT_BYTES // max(len(f) for f in frames))
+        base = next = 0
+
+        while base < len(frames):
+            while next < len(frames) and next - base < window:
+                await self.client.write_gatt_char(
+                    self.data_rx_char, frames[next], response=False
+                )
+                next += 1
+
+            type, sequence, _ = await asyncio.wait_for(self.get_frame(), 10)
+            index = (sequence - first) & 0xFFFF
+
+            if type == self.ACK:
+                base = max(base, index + 1)
+            elif type == self.NAK:
+                self.log(f"resending from frame {index}")
+                base = next = index
+
+    def chunk_size(self):
+        # One frame per write, within the 1024 byte payload of the device
+        return min(self.client.mtu_size - 3 - 5 - 4, 1024)
+
+    async def send_file(self, path, data):
+        chunk = self.chunk_size()
+        frames = [self.frame(self.OPEN_WRITE, path.encode())]
+        for i in range(0, len(data), chunk):
+            frames.append(self.frame(self.DATA, data[i:i + chunk]))
+        frames.append(
+            self.frame(self.END, struct.pack("<II", len(data), zlib.crc32(data)))
+        )
+
+        await self.send_frames(frames)
+
+    async def receive_file(self, path):
+        await self.send_frames([self.frame(self.OPEN_READ, path.encode())])
+
+        data = bytearray()
+        while True:
+            type, _, payload = await asyncio.wait_for(self.get_frame(), 10)
+            if type == self.DATA:
+                data.extend(payload)
+            elif type == self.END:
+                break
+
+        size, crc = struct.unpack("<II", payload)
+        if size != len(data) or crc != zlib.crc32(data):
+            raise IOError(f"{path}: size or CRC mismatch")
+
+        return bytes(data)
+
+    async def upload(self, file):
+        with open(file, "rb") as f:
+            await self.send_file(file, f.read())
+
+    async def download(self, file):
+        data = await self.receive_file(file)
+        with open(file, "wb") as f:
+            f.write(data)
+
+    async def run_command(self, cmd):
+        # Like send_command(), but returns what the command printed
+        await self.write_uart(cmd.encode() + b"\x04")
+        reply = bytearray()
+        while not reply.endswith(b"OK"):
+            reply.append(await self.getchar_uart())
+        output = await self.getline_uart(delim=b"\x04")
+        error = await self.getline_uart(delim=b"\x04")
+        if error:
+            raise RuntimeError(error.decode())
+        return output.decode()
+
+    async def serve_files(self, mode, files):
+        self.sequence = 0
+        await self.send_command("import bluetooth\nbluetooth.file_server()")
+
+        for file in files:
+            print(f"{mode}ing {file} ", end="", flush=True)
+            await getattr(self, mode)(file)
+            print("done")
+
+        await self.send_frames([self.frame(self.EXIT)])
+
+    async def migrate(self, backup):
+        # Filesystems from older firmware reach over the log store and blobs,
+        # and are mounted at their old size
+        blocks, partition = map(int, (await self.run_command(
+            "import os, device\n"
+            "print(os.statvfs('/')[2], device.Storage().ioctl(4, 0))"
+        )).split())
+        if blocks == partition:
+            print("the filesystem already has the current layout")
+            return
+
+        listing = await self.run_command(
+            "import os\n"
+            "def walk(d):\n"
+            "    for e in os.ilistdir(d):\n"
+            "        p = d.rstrip('/') + '/' + e[0]\n"
+            "        print(('D ' if e[1] == 0x4000 else 'F ') + p)\n"
+            "        if e[1] == 0x4000:\n"
+            "            walk(p)\n"
+            "walk('/')"
+        )
+        entries = [line.split(" ", 1) for line in listing.split("\r\n") if line]
+        dirs = [path for kind, path in entries if kind == "D"]
+        files = [path for kind, path in entries if kind == "F"]
+
+        # Every file is saved here before anything on the device is erased
+        contents = {}
+        self.sequence = 0
+        await self.send_command("import bluetooth\nbluetooth.file_server()")
+        for path in files:
+            print(f"saving {path}")
+            contents[path] = await self.receive_file(path)
+            local = os.path.join(backup, path.lstrip("/"))
+            os.makedirs(os.path.dirname(local), exist_ok=True)
+            with open(local, "wb") as f:
+                f.write(contents[path])
+        await self.send_frames([self.frame(self.EXIT)])
+
+        print("formatting the filesystem with the current layout")
+        await self.run_command(
+            "import os, device\n"
+            "os.umount('/')\n"
+            "b = device.Storage()\n"
+            "g = {'readsize': b.READ_SIZE, 'progsize': b.PROG_SIZE, "
+            "'lookahead': b.LOOKAHEAD_SIZE}\n"
+            "os.VfsLfs2.mkfs(b, **g)\n"
+            "os.mount(os.VfsLfs2(b, **g), '/')\n"
+            + "".join(f"os.mkdir({path!r})\n" for path in dirs)
+        )
+
+        self.sequence = 0
+        await self.send_command("import bluetooth\nbluetooth.file_server()")
+        for path in files:
+            print(f"restoring {path}")
+            await self.send_file(path, contents[path])
+        await self.send_frames([self.frame(self.EXIT)])
+
+        # The old filesystem keeps the regions claimed until then
+        print(f"done, files saved in {backup}. Reset the device to use the "
+              "log store and blobs")
+
+    async def script(self, mode, args):
+        if mode == "migrate":
+            await self.migrate(args[0])
+        else:
+            await self.serve_files(mode, args)
+
 if __name__ == "__main__":
+    if len(sys.argv) > 2 and sys.argv[1] == "--migrate":
+        try:
+            asyncio.run(FileTransferScript.run("migrate", sys.argv[2:3]))
+        except asyncio.exceptions.CancelledError:
+            pass
+        sys.exit(0)
+
+    if len(sys.argv) > 1 and sys.argv[1] in ("--fast", "--download"):
+        mode = "upload" if sys.argv[1] == "--fast" else "download"
+        try:
+            asyncio.run(FileTransferScript.run(mode, sys.argv[2:]))
+        except asyncio.exceptions.CancelledError:
+            pass
+        sys.exit(0)
+
     for file in sys.argv[1:]:
         try:
             asyncio.run(UploadFileScript.run(file))